@@ -1,10 +1,10 @@
 #include "note.h"
 
-#include <sstream>
 #include <charconv>
 #include <utility>
 
 #include "utautils.h"
+#include "private/usthelper_p.h"
 
 namespace Utau {
 
@@ -58,35 +58,40 @@ namespace Utau {
         Returns a comma separated string as the representation of the vibrato.
     */
     std::string Vibrato::toString() const {
-        std::stringstream ss;
-        ss << length << COMMA;
-        ss << period << COMMA;
-        ss << amplitude << COMMA;
-        ss << attack << COMMA;
-        ss << release << COMMA;
-        ss << phase << COMMA;
-        ss << offset << COMMA;
-        ss << intensity;
-        return ss.str();
+        std::string res;
+        for (double num : {length, period, amplitude, attack, release, phase, offset}) {
+            res += to_string(num);
+            res += COMMA;
+        }
+        res += to_string(intensity);
+        return res;
     }
 
     /*!
         Returns a vibrato parsed from the string.
     */
     Vibrato Vibrato::fromString(const std::string_view &s) {
-        auto nums = split(s, {&COMMA, 1});
-        if (nums.size() < 7)
+        // Same tokens as split(), read in place without a temporary list
+        TokenReader tokens(s, COMMA);
+        auto count = tokens.count();
+        if (count < 7)
             return {};
 
+        double nums[8] = {};
+        std::string_view token;
+        for (std::size_t i = 0; i < 8 && tokens.next(token); ++i) {
+            nums[i] = stod2(token);
+        }
+
         Vibrato vbr;
-        vbr.length = stod2(nums[0]);
-        vbr.period = stod2(nums[1]);
-        vbr.amplitude = stod2(nums[2]);
-        vbr.attack = stod2(nums[3]);
-        vbr.release = stod2(nums[4]);
-        vbr.phase = stod2(nums[5]);
-        vbr.offset = stod2(nums[6]);
-        vbr.intensity = nums.size() >= 8 ? stod2(nums[7]) : 0;
+        vbr.length = nums[0];
+        vbr.period = nums[1];
+        vbr.amplitude = nums[2];
+        vbr.attack = nums[3];
+        vbr.release = nums[4];
+        vbr.phase = nums[5];
+        vbr.offset = nums[6];
+        vbr.intensity = nums[7];
         return vbr;
     }
 
@@ -133,31 +138,38 @@ namespace Utau {
         Returns an envelope parsed from the string.
     */
     Envelope Envelope::fromString(const std::string_view &s) {
-        auto strList = split(s, {&COMMA, 1});
-        std::vector<double> nums;
-
-        if (strList.size() >= 8) {
-            strList.erase(strList.begin() + 7); // Remove %
-        } else if (strList.size() < 7) {
-            return {};                          // Invalid
+        // Same tokens as split(), read in place without a temporary list
+        TokenReader tokens(s, COMMA);
+        auto count = tokens.count();
+        if (count < 7) {
+            return {}; // Invalid
         }
 
-        for (const auto &item : std::as_const(strList)) {
-            nums.push_back(stod2(item));
+        bool hasPercent = count >= 8; // The 8th token is %
+        auto size = hasPercent ? count - 1 : count;
+        if (size % 2 != 0) {
+            size++; // Padded with 0
         }
-        if (nums.size() % 2 != 0) {
-            nums.push_back(0);
+
+        double nums[10] = {}; // Only the first 10 numbers are used
+        std::string_view token;
+        std::size_t index = 0;
+        for (std::size_t i = 0; tokens.next(token) && index < 10; ++i) {
+            if (hasPercent && i == 7) {
+                continue;
+            }
+            nums[index++] = stod2(token);
         }
 
         Envelope env;
-        int index = 0;
-        env.anchors[index++] = {nums.at(0), nums.at(3)};
-        env.anchors[index++] = {nums.at(1), nums.at(4)};
-        if (nums.size() == 10) {
-            env.anchors[index++] = {nums.at(8), nums.at(9)};
+        int anchor = 0;
+        env.anchors[anchor++] = {nums[0], nums[3]};
+        env.anchors[anchor++] = {nums[1], nums[4]};
+        if (size == 10) {
+            env.anchors[anchor++] = {nums[8], nums[9]};
         }
-        env.anchors[index++] = {nums.at(2), nums.at(5)};
-        env.anchors[index++] = {nums.at(7), nums.at(6)};
+        env.anchors[anchor++] = {nums[2], nums[5]};
+        env.anchors[anchor++] = {nums[7], nums[6]};
         return env;
     }
 
@@ -247,53 +259,7 @@ namespace Utau {
         Converts the pitch bend strings to a point vector.
     */
     std::vector<Point> PBStrings::toPoints() const {
-        if (PBS.empty() || PBW.empty()) {
-            return {};
-        }
-
-        Point p;
-        auto PBSXY = split(PBS, ";");
-        if (!PBSXY.empty()) {
-            p.x = stod2(PBSXY.front(), p.x);
-            if (PBSXY.size() >= 2) {
-                p.y = stod2(PBSXY.at(1), p.y);
-            }
-        }
-
-        std::vector<Point> res;
-        res.push_back(p);
-
-        auto PBWs = split(PBW, ",");
-        auto PBYs = split(PBY, ",");
-        auto PBMs = split(PBM, ",");
-
-        for (int i = 0; i < std::max(PBWs.size(), PBYs.size()); i++) {
-            p = {};
-            if (PBWs.size() > i) {
-                p.x = stod2(PBWs.at(i), p.x);
-            }
-            if (PBYs.size() > i) {
-                if (!PBYs.at(i).empty())
-                    p.y = stod2(PBYs.at(i), p.y);
-            }
-            if (PBMs.size() > i) {
-                p.type = Point::stringToType(PBMs.at(i));
-            }
-            p.x += res.back().x;
-            res.push_back(p);
-        }
-
-        // Fix Negative Correction
-        for (int i = 1; i < res.size(); ++i) {
-            auto &curPoint = res[i];
-            auto &prevPoint = res[i - 1];
-
-            if (curPoint.x < prevPoint.x) {
-                curPoint.x = prevPoint.x;
-            }
-        }
-
-        return res;
+        return pointsFromPBStrings(PBS, PBW, PBY, PBM);
     }
 
 
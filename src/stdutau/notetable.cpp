@@ -0,0 +1,294 @@
+#include "notetable.h"
+
+#include <algorithm>
+
+namespace Utau {
+
+    /*!
+        \class NoteTable
+        \brief Column storage of a note sequence.
+
+        Every numeric field of the notes is a contiguous array indexed by row, the strings, pitch
+        points and Mode1 pitches of all rows share one pool per field, and the envelopes,
+        vibratos and user data are only stored for the notes that have them. A pass over one
+        field of a large project reads a single array instead of following every note across the
+        heap.
+
+        The lyrics, flags, pitch types and labels are interned in a StringPool, which may be
+        shared by several tables, so a repeated value is stored once and two values are equal if
+        their ids are equal.
+
+        All columns and the string pool allocate from the memory resource of the table, so a
+        table in a \c std::pmr::monotonic_buffer_resource holds a whole project in one arena,
+        which is released at once instead of one allocation at a time. The notes converted from
+        the table use the default allocator.
+
+        The table is filled by appending, and the notes are rebuilt on demand with note() or
+        toNotes(), the conversion keeps every field of the notes.
+
+        A table can't be copied, to copy the rows into a table of another resource, append the
+        notes of toNotes() to it.
+    */
+
+    /*!
+        Constructs an empty table with a new string pool.
+    */
+    NoteTable::NoteTable() : NoteTable(std::pmr::get_default_resource()) {
+    }
+
+    /*!
+        Constructs an empty table with a new string pool, the table and the pool allocate from
+        \a resource.
+    */
+    NoteTable::NoteTable(std::pmr::memory_resource *resource)
+        : NoteTable(std::allocate_shared<StringPool>(
+              std::pmr::polymorphic_allocator<StringPool>(resource), resource)) {
+    }
+
+    /*!
+        Constructs an empty table that interns its strings in the given pool, the table
+        allocates from the resource of the pool.
+    */
+    NoteTable::NoteTable(std::shared_ptr<StringPool> strings)
+        : noteNum(strings->resource()), length(strings->resource()),
+          intensity(strings->resource()), modulation(strings->resource()),
+          velocity(strings->resource()), preUttr(strings->resource()),
+          overlap(strings->resource()), stp(strings->resource()), tempo(strings->resource()),
+          pbstart(strings->resource()), lyric(strings), flags(strings), pbtype(strings),
+          label(strings), direct(strings->resource()), patch(strings->resource()),
+          region(strings->resource()), regionEnd(strings->resource()),
+          portamento(strings->resource()), pitches(strings->resource()),
+          envelopeIndex(strings->resource()), envelopes(strings->resource()),
+          vibratoIndex(strings->resource()), vibratos(strings->resource()),
+          userData(strings->resource()), m_strings(std::move(strings)) {
+    }
+
+    /*!
+        Constructs a table of the notes.
+    */
+    NoteTable::NoteTable(const Note *notes, int count) : NoteTable() {
+        append(notes, count);
+    }
+
+    /*!
+        \fn const std::shared_ptr<StringPool> &NoteTable::strings() const
+
+        Returns the pool of the interned columns.
+    */
+
+    /*!
+        \fn std::pmr::memory_resource *NoteTable::resource() const
+
+        Returns the memory resource of the table.
+    */
+
+    /*!
+        Removes all rows, the strings stay in the pool.
+    */
+    void NoteTable::clear() {
+        noteNum.clear();
+        length.clear();
+        intensity.clear();
+        modulation.clear();
+        velocity.clear();
+        preUttr.clear();
+        overlap.clear();
+        stp.clear();
+        tempo.clear();
+        pbstart.clear();
+
+        lyric.clear();
+        flags.clear();
+        pbtype.clear();
+        label.clear();
+        direct.clear();
+        patch.clear();
+        region.clear();
+        regionEnd.clear();
+
+        portamento.clear();
+        pitches.clear();
+
+        envelopeIndex.clear();
+        envelopes.clear();
+        vibratoIndex.clear();
+        vibratos.clear();
+
+        userData.clear();
+    }
+
+    /*!
+        Reserves the fixed size columns for \a count rows.
+    */
+    void NoteTable::reserve(int count) {
+        auto n = static_cast<std::size_t>(std::max(0, count));
+        for (auto column : {&noteNum, &length, &envelopeIndex, &vibratoIndex, &lyric.ids,
+                            &flags.ids, &pbtype.ids, &label.ids}) {
+            column->reserve(n);
+        }
+        for (auto column : {&intensity, &modulation, &velocity, &preUttr, &overlap, &stp, &tempo,
+                            &pbstart}) {
+            column->reserve(n);
+        }
+        for (auto column : {&direct, &patch, &region, &regionEnd}) {
+            column->offsets.reserve(n + 1);
+        }
+        portamento.offsets.reserve(n + 1);
+        pitches.offsets.reserve(n + 1);
+    }
+
+    /*!
+        Releases the unused capacity of all columns.
+    */
+    void NoteTable::squeeze() {
+        for (auto column : {&noteNum, &length, &envelopeIndex, &vibratoIndex, &lyric.ids,
+                            &flags.ids, &pbtype.ids, &label.ids}) {
+            column->shrink_to_fit();
+        }
+        for (auto column : {&intensity, &modulation, &velocity, &preUttr, &overlap, &stp, &tempo,
+                            &pbstart}) {
+            column->shrink_to_fit();
+        }
+        for (auto column : {&direct, &patch, &region, &regionEnd}) {
+            column->squeeze();
+        }
+        portamento.squeeze();
+        pitches.squeeze();
+        envelopes.shrink_to_fit();
+        vibratos.shrink_to_fit();
+        userData.shrink_to_fit();
+    }
+
+    /*!
+        Appends a note as the last row.
+    */
+    void NoteTable::append(const Note &note) {
+        int row = size();
+
+        noteNum.push_back(note.noteNum);
+        length.push_back(note.length);
+        intensity.push_back(note.intensity);
+        modulation.push_back(note.modulation);
+        velocity.push_back(note.velocity);
+        preUttr.push_back(note.preUttr);
+        overlap.push_back(note.overlap);
+        stp.push_back(note.stp);
+        tempo.push_back(note.tempo);
+        pbstart.push_back(note.pbstart);
+
+        lyric.append(note.lyric);
+        flags.append(note.flags);
+        pbtype.append(note.pbtype);
+        label.append(note.label);
+        direct.append(note.direct);
+        patch.append(note.patch);
+        region.append(note.region);
+        regionEnd.append(note.regionEnd);
+
+        portamento.append(note.portamento.begin(), note.portamento.end());
+        pitches.append(note.pitches.begin(), note.pitches.end());
+
+        if (note.envelope) {
+            envelopeIndex.push_back(static_cast<int>(envelopes.size()));
+            envelopes.push_back(note.envelope.value());
+        } else {
+            envelopeIndex.push_back(-1);
+        }
+        if (note.vibrato) {
+            vibratoIndex.push_back(static_cast<int>(vibratos.size()));
+            vibratos.push_back(note.vibrato.value());
+        } else {
+            vibratoIndex.push_back(-1);
+        }
+
+        if (!note.userData.empty()) {
+            userData.emplace_back();
+            auto &item = userData.back();
+            item.first = row;
+            for (const auto &pair : note.userData) {
+                item.second.emplace(std::string_view(pair.first), std::string_view(pair.second));
+            }
+        }
+    }
+
+    /*!
+        \overload
+    */
+    void NoteTable::append(const Note *notes, int count) {
+        reserve(size() + count);
+        for (int i = 0; i < count; ++i) {
+            append(notes[i]);
+        }
+    }
+
+    /*!
+        Returns the note of the row.
+    */
+    Note NoteTable::note(int row) const {
+        Note res;
+        toNote(row, res);
+        return res;
+    }
+
+    /*!
+        Writes the note of the row to \a out, whose string and vector capacities are reused.
+    */
+    void NoteTable::toNote(int row, Note &out) const {
+        out.noteNum = noteNum[row];
+        out.length = length[row];
+        out.intensity = intensity[row];
+        out.modulation = modulation[row];
+        out.velocity = velocity[row];
+        out.preUttr = preUttr[row];
+        out.overlap = overlap[row];
+        out.stp = stp[row];
+        out.tempo = tempo[row];
+        out.pbstart = pbstart[row];
+
+        out.lyric = lyric.at(row);
+        out.flags = flags.at(row);
+        out.pbtype = pbtype.at(row);
+        out.label = label.at(row);
+        out.direct = direct.at(row);
+        out.patch = patch.at(row);
+        out.region = region.at(row);
+        out.regionEnd = regionEnd.at(row);
+
+        out.portamento.assign(portamento.data(row), portamento.data(row) + portamento.count(row));
+        out.pitches.assign(pitches.data(row), pitches.data(row) + pitches.count(row));
+
+        if (envelopeIndex[row] >= 0) {
+            out.envelope = envelopes[envelopeIndex[row]];
+        } else {
+            out.envelope.reset();
+        }
+        if (vibratoIndex[row] >= 0) {
+            out.vibrato = vibratos[vibratoIndex[row]];
+        } else {
+            out.vibrato.reset();
+        }
+
+        out.userData.clear();
+        auto it = std::lower_bound(userData.begin(), userData.end(), row,
+                                   [](const std::pair<int, UserData> &item, int row) -> bool {
+                                       return item.first < row;
+                                   });
+        if (it != userData.end() && it->first == row) {
+            for (const auto &pair : it->second) {
+                out.userData.emplace(std::string_view(pair.first), std::string_view(pair.second));
+            }
+        }
+    }
+
+    /*!
+        Returns the notes of all rows.
+    */
+    std::vector<Note> NoteTable::toNotes() const {
+        std::vector<Note> res(size());
+        for (int i = 0; i < size(); ++i) {
+            toNote(i, res[i]);
+        }
+        return res;
+    }
+
+}
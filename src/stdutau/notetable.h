@@ -0,0 +1,244 @@
+#ifndef NOTETABLE_H
+#define NOTETABLE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <stdutau/note.h>
+#include <stdutau/stringpool.h>
+
+namespace Utau {
+
+    // Variable length values of all rows in one pool, row i spans offsets[i] to offsets[i + 1]
+    template <class Pool>
+    class PooledColumn {
+    public:
+        using value_type = typename Pool::value_type;
+
+        inline explicit PooledColumn(
+            std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+        inline std::size_t size() const;
+        inline std::size_t count(std::size_t row) const;
+        inline const value_type *data(std::size_t row) const;
+
+        template <class InputIt>
+        inline void append(InputIt first, InputIt last);
+
+        inline void clear();
+        inline void reserve(std::size_t rows, std::size_t values);
+        inline void squeeze();
+
+    public:
+        Pool pool;
+        std::pmr::vector<std::uint32_t> offsets;
+    };
+
+    template <class Pool>
+    inline PooledColumn<Pool>::PooledColumn(std::pmr::memory_resource *resource)
+        : pool(resource), offsets(1, 0, resource) {
+    }
+
+    template <class Pool>
+    inline std::size_t PooledColumn<Pool>::size() const {
+        return offsets.size() - 1;
+    }
+
+    template <class Pool>
+    inline std::size_t PooledColumn<Pool>::count(std::size_t row) const {
+        return offsets[row + 1] - offsets[row];
+    }
+
+    template <class Pool>
+    inline const typename PooledColumn<Pool>::value_type *
+        PooledColumn<Pool>::data(std::size_t row) const {
+        return pool.data() + offsets[row];
+    }
+
+    template <class Pool>
+    template <class InputIt>
+    inline void PooledColumn<Pool>::append(InputIt first, InputIt last) {
+        pool.insert(pool.end(), first, last);
+        offsets.push_back(static_cast<std::uint32_t>(pool.size()));
+    }
+
+    template <class Pool>
+    inline void PooledColumn<Pool>::clear() {
+        pool.clear();
+        offsets.assign(1, 0);
+    }
+
+    template <class Pool>
+    inline void PooledColumn<Pool>::reserve(std::size_t rows, std::size_t values) {
+        offsets.reserve(rows + 1);
+        pool.reserve(values);
+    }
+
+    template <class Pool>
+    inline void PooledColumn<Pool>::squeeze() {
+        pool.shrink_to_fit();
+        offsets.shrink_to_fit();
+    }
+
+    class StringColumn : public PooledColumn<std::pmr::string> {
+    public:
+        using PooledColumn::PooledColumn;
+
+        inline std::string_view at(std::size_t row) const;
+        inline void append(const std::string_view &s);
+    };
+
+    inline std::string_view StringColumn::at(std::size_t row) const {
+        return {data(row), count(row)};
+    }
+
+    inline void StringColumn::append(const std::string_view &s) {
+        PooledColumn::append(s.begin(), s.end());
+    }
+
+    // Strings of all rows as ids of a shared pool, equal strings have equal ids
+    class InternedColumn {
+    public:
+        inline explicit InternedColumn(std::shared_ptr<StringPool> pool);
+
+        inline std::size_t size() const;
+        inline StringPool::Id id(std::size_t row) const;
+        inline std::string_view at(std::size_t row) const;
+        inline const StringPool &pool() const;
+
+        inline void append(const std::string_view &s);
+        inline void clear();
+
+    public:
+        std::pmr::vector<StringPool::Id> ids;
+
+    protected:
+        std::shared_ptr<StringPool> m_pool;
+    };
+
+    inline InternedColumn::InternedColumn(std::shared_ptr<StringPool> pool)
+        : ids(pool->resource()), m_pool(std::move(pool)) {
+    }
+
+    inline std::size_t InternedColumn::size() const {
+        return ids.size();
+    }
+
+    inline StringPool::Id InternedColumn::id(std::size_t row) const {
+        return ids[row];
+    }
+
+    inline std::string_view InternedColumn::at(std::size_t row) const {
+        return m_pool->at(ids[row]);
+    }
+
+    inline const StringPool &InternedColumn::pool() const {
+        return *m_pool;
+    }
+
+    inline void InternedColumn::append(const std::string_view &s) {
+        ids.push_back(m_pool->intern(s));
+    }
+
+    inline void InternedColumn::clear() {
+        ids.clear();
+    }
+
+    class STDUTAU_EXPORT NoteTable {
+    public:
+        NoteTable();
+        explicit NoteTable(std::pmr::memory_resource *resource);
+        explicit NoteTable(std::shared_ptr<StringPool> strings);
+        NoteTable(const Note *notes, int count);
+        inline explicit NoteTable(const std::vector<Note> &notes);
+
+        // A copy would share the string pool and put its columns in the default resource
+        NoteTable(const NoteTable &) = delete;
+        NoteTable &operator=(const NoteTable &) = delete;
+        NoteTable(NoteTable &&) = default;
+        NoteTable &operator=(NoteTable &&) = default;
+
+        inline const std::shared_ptr<StringPool> &strings() const;
+        inline std::pmr::memory_resource *resource() const;
+
+        inline int size() const;
+        inline bool empty() const;
+        void clear();
+        void reserve(int count);
+        void squeeze();
+
+        void append(const Note &note);
+        void append(const Note *notes, int count);
+        inline void append(const std::vector<Note> &notes);
+
+        Note note(int row) const;
+        void toNote(int row, Note &out) const;
+        std::vector<Note> toNotes() const;
+
+    public:
+        std::pmr::vector<int> noteNum;
+        std::pmr::vector<int> length;
+
+        std::pmr::vector<double> intensity, modulation, velocity;
+        std::pmr::vector<double> preUttr, overlap, stp;
+        std::pmr::vector<double> tempo;
+        std::pmr::vector<double> pbstart;
+
+        // A small vocabulary repeats across the project
+        InternedColumn lyric, flags;
+        InternedColumn pbtype;
+        InternedColumn label;
+
+        StringColumn direct, patch;
+        StringColumn region, regionEnd;
+
+        PooledColumn<std::pmr::vector<Point>> portamento;
+        PooledColumn<std::pmr::vector<double>> pitches;
+
+        // Index into the value list, -1 if the note has none
+        std::pmr::vector<int> envelopeIndex;
+        std::pmr::vector<Envelope> envelopes;
+        std::pmr::vector<int> vibratoIndex;
+        std::pmr::vector<Vibrato> vibratos;
+
+        // Sparse, sorted by row
+        using UserData = std::pmr::map<std::pmr::string, std::pmr::string>;
+        std::pmr::vector<std::pair<int, UserData>> userData;
+
+    protected:
+        std::shared_ptr<StringPool> m_strings;
+    };
+
+    inline const std::shared_ptr<StringPool> &NoteTable::strings() const {
+        return m_strings;
+    }
+
+    inline std::pmr::memory_resource *NoteTable::resource() const {
+        return m_strings->resource();
+    }
+
+    inline NoteTable::NoteTable(const std::vector<Note> &notes)
+        : NoteTable(notes.data(), static_cast<int>(notes.size())) {
+    }
+
+    inline int NoteTable::size() const {
+        return static_cast<int>(noteNum.size());
+    }
+
+    inline bool NoteTable::empty() const {
+        return noteNum.empty();
+    }
+
+    inline void NoteTable::append(const std::vector<Note> &notes) {
+        append(notes.data(), static_cast<int>(notes.size()));
+    }
+
+}
+
+#endif // NOTETABLE_H
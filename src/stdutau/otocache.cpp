@@ -0,0 +1,615 @@
+#include "otocache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <unordered_map>
+
+#include "utaconst.h"
+#include "voicebank.h"
+#include "private/mappedfile_p.h"
+#include "private/pathhelper_p.h"
+
+namespace fs = std::filesystem;
+
+namespace Utau {
+
+    namespace {
+
+        // File layout, all sections are 8-byte aligned and in native byte order:
+        // Header | Source[] | Record[] (line order) | Slot[] | strings
+
+        constexpr const char CACHE_MAGIC[8] = {'U', 'T', 'A', 'U', 'O', 'T', 'O', '\0'};
+        constexpr const std::uint32_t CACHE_VERSION = 3;
+        constexpr const std::uint32_t CACHE_BYTE_ORDER = 0x01020304;
+
+        struct Header {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byteOrder;
+            std::uint32_t sourceCount;
+            std::uint32_t recordCount; // Records of all entries in the line order
+            std::uint32_t slotCount;
+            std::uint32_t loadFlags; // Load options the snapshot was built with
+            std::uint64_t sourcesOffset;
+            std::uint64_t recordsOffset;
+            std::uint64_t slotsOffset;
+            std::uint64_t stringsOffset;
+            std::uint64_t stringsSize;
+            std::uint64_t fileSize;
+        };
+
+        enum LoadFlag : std::uint32_t {
+            RecursiveLoad = 1,
+        };
+
+        std::uint32_t loadFlagsOf(const VoicebankLoadOptions &options) {
+            return options.recursive ? std::uint32_t(RecursiveLoad) : 0u;
+        }
+
+        enum SourceType : std::uint32_t {
+            OtoSource,
+            DirectorySource,
+            CacheDirectorySource, // Stamped by the modification time of the snapshot
+        };
+
+        struct Source {
+            std::uint32_t pathOffset;
+            std::uint32_t pathLength;
+            std::uint32_t type;
+            std::uint32_t entryCount;
+            std::int64_t size;
+            std::int64_t mtime;
+        };
+
+        struct Record {
+            std::uint32_t fileNameOffset;
+            std::uint32_t fileNameLength;
+            std::uint32_t aliasOffset;
+            std::uint32_t aliasLength;
+            double values[5];
+        };
+
+        struct Slot {
+            std::uint32_t hash;
+            std::int32_t record; // -1 for empty slots
+        };
+
+        inline std::uint64_t align8(std::uint64_t size) {
+            return (size + 7) & ~std::uint64_t(7);
+        }
+
+        // Stable across compilers and runs, unlike std::hash
+        inline std::uint32_t hashOf(const std::string_view &s) {
+            std::uint32_t h = 2166136261u;
+            for (char ch : s) {
+                h ^= static_cast<unsigned char>(ch);
+                h *= 16777619u;
+            }
+            return h;
+        }
+
+        bool statSource(const fs::path &path, bool directory, std::int64_t &size,
+                        std::int64_t &mtime) {
+            std::error_code ec;
+            auto time = fs::last_write_time(path, ec);
+            if (ec) {
+                return false;
+            }
+            mtime = static_cast<std::int64_t>(time.time_since_epoch().count());
+            if (directory) {
+                size = 0;
+                return fs::is_directory(path, ec);
+            }
+            auto fileSize = fs::file_size(path, ec);
+            if (ec) {
+                return false;
+            }
+            size = static_cast<std::int64_t>(fileSize);
+            return true;
+        }
+
+        class StringTable {
+        public:
+            std::uint32_t add(const std::string_view &s) {
+                auto it = m_offsets.find(std::string(s));
+                if (it != m_offsets.end()) {
+                    return it->second;
+                }
+                auto offset = static_cast<std::uint32_t>(m_data.size());
+                m_data.append(s);
+                m_offsets.emplace(std::string(s), offset);
+                return offset;
+            }
+
+            const std::string &data() const {
+                return m_data;
+            }
+
+        protected:
+            std::string m_data;
+            std::unordered_map<std::string, std::uint32_t> m_offsets;
+        };
+
+        Record makeRecord(const GenonSettings &genon, StringTable &strings) {
+            Record record;
+            record.fileNameOffset = strings.add(genon.fileName);
+            record.fileNameLength = static_cast<std::uint32_t>(genon.fileName.size());
+            record.aliasOffset = strings.add(genon.alias);
+            record.aliasLength = static_cast<std::uint32_t>(genon.alias.size());
+            record.values[0] = genon.offset;
+            record.values[1] = genon.consonant;
+            record.values[2] = genon.blank;
+            record.values[3] = genon.preUtterance;
+            record.values[4] = genon.voiceOverlap;
+            return record;
+        }
+
+        struct CacheView {
+            const Header *header;
+            const Source *sources;
+            const Record *records;
+            const Slot *slots;
+            const char *strings;
+
+            std::string_view string(std::uint32_t offset, std::uint32_t length) const {
+                return {strings + offset, length};
+            }
+
+            OtoCacheEntry entry(const Record &record) const {
+                OtoCacheEntry res;
+                res.fileName = string(record.fileNameOffset, record.fileNameLength);
+                res.alias = string(record.aliasOffset, record.aliasLength);
+                res.offset = record.values[0];
+                res.consonant = record.values[1];
+                res.blank = record.values[2];
+                res.preUtterance = record.values[3];
+                res.voiceOverlap = record.values[4];
+                return res;
+            }
+        };
+
+        CacheView viewOf(const std::string_view &data) {
+            auto header = reinterpret_cast<const Header *>(data.data());
+            CacheView view;
+            view.header = header;
+            view.sources = reinterpret_cast<const Source *>(data.data() + header->sourcesOffset);
+            view.records = reinterpret_cast<const Record *>(data.data() + header->recordsOffset);
+            view.slots = reinterpret_cast<const Slot *>(data.data() + header->slotsOffset);
+            view.strings = data.data() + header->stringsOffset;
+            return view;
+        }
+
+        inline bool isInStrings(const Header *header, std::uint32_t offset, std::uint32_t length) {
+            return std::uint64_t(offset) + length <= header->stringsSize;
+        }
+
+        // Checks every offset and count once, so the lookups don't need to
+        bool isValidCache(const std::string_view &data) {
+            if (data.size() < sizeof(Header)) {
+                return false;
+            }
+            auto header = reinterpret_cast<const Header *>(data.data());
+            if (std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+                header->version != CACHE_VERSION || header->byteOrder != CACHE_BYTE_ORDER ||
+                header->fileSize != data.size()) {
+                return false;
+            }
+
+            // Sections must be aligned, in order and inside the file, the offsets are checked
+            // one by one so that no sum overflows
+            auto size = header->fileSize;
+            for (auto offset : {header->sourcesOffset, header->recordsOffset, header->slotsOffset,
+                                header->stringsOffset}) {
+                if (offset > size || offset % 8 != 0) {
+                    return false;
+                }
+            }
+            if (header->sourcesOffset < sizeof(Header) ||
+                header->sourcesOffset + std::uint64_t(header->sourceCount) * sizeof(Source) >
+                    header->recordsOffset ||
+                header->recordsOffset + std::uint64_t(header->recordCount) * sizeof(Record) >
+                    header->slotsOffset ||
+                header->slotsOffset + std::uint64_t(header->slotCount) * sizeof(Slot) >
+                    header->stringsOffset ||
+                header->stringsSize != size - header->stringsOffset) {
+                return false;
+            }
+
+            auto view = viewOf(data);
+            for (std::uint32_t i = 0; i < header->sourceCount; ++i) {
+                const auto &source = view.sources[i];
+                if (source.type > CacheDirectorySource ||
+                    !isInStrings(header, source.pathOffset, source.pathLength)) {
+                    return false;
+                }
+            }
+            for (std::uint32_t i = 0; i < header->recordCount; ++i) {
+                const auto &record = view.records[i];
+                if (!isInStrings(header, record.fileNameOffset, record.fileNameLength) ||
+                    !isInStrings(header, record.aliasOffset, record.aliasLength)) {
+                    return false;
+                }
+            }
+
+            // A lookup stops at an empty slot, so there must be one
+            if (header->slotCount == 0 || (header->slotCount & (header->slotCount - 1)) != 0) {
+                return false;
+            }
+            bool hasEmptySlot = false;
+            for (std::uint32_t i = 0; i < header->slotCount; ++i) {
+                auto record = view.slots[i].record;
+                if (record < 0) {
+                    hasEmptySlot = true;
+                } else if (std::uint32_t(record) >= header->recordCount) {
+                    return false;
+                }
+            }
+            return hasEmptySlot;
+        }
+
+    }
+
+    /*!
+        \class OtoCacheEntry
+        \brief Entry of an OtoCache, the strings refer to the mapped cache file.
+    */
+
+    /*!
+        Returns a copy of the entry that doesn't depend on the cache.
+    */
+    GenonSettings OtoCacheEntry::toGenonSettings() const {
+        GenonSettings genon;
+        genon.fileName = fileName;
+        genon.alias = alias;
+        genon.offset = offset;
+        genon.consonant = consonant;
+        genon.blank = blank;
+        genon.preUtterance = preUtterance;
+        genon.voiceOverlap = voiceOverlap;
+        return genon;
+    }
+
+    /*!
+        \class OtoCache
+        \brief Binary snapshot of the \c oto.ini files of a voicebank.
+
+        The snapshot holds a string table, the entries as fixed-width records and the alias hash
+        table, it's loaded with a single memory mapping and lookups read the mapping directly.
+        The size and modification time of every source file and searched directory are stored, so
+        a stale snapshot is detected without parsing any \c oto.ini.
+
+        The snapshot is written to a temporary file and renamed over the old one, and every
+        offset is checked when it's opened, so a truncated or foreign file is rejected instead of
+        read out of bounds.
+
+        The file is written in native byte order and is meant to be a local cache, not a
+        distribution format.
+    */
+
+    /*!
+        Constructor.
+    */
+    OtoCache::OtoCache() = default;
+
+    /*!
+        Destructor.
+    */
+    OtoCache::~OtoCache() = default;
+
+    /*!
+        Writes the snapshot of the loaded voicebank, returns \c true if success.
+
+        The voicebank should have been loaded with the same \a options, since the directories to
+        validate are searched again.
+    */
+    bool OtoCache::build(const Voicebank &voicebank, const std::filesystem::path &path,
+                         const VoicebankLoadOptions &options) {
+        const auto &root = voicebank.root;
+        StringTable strings;
+
+        // The directory of the cache changes when the file is replaced, so it's validated
+        // against the modification time of the cache file instead
+        std::error_code ec;
+        auto cacheDir = path.parent_path().empty() ? fs::path(".") : path.parent_path();
+        auto directoryType = [&](const fs::path &dir) -> std::uint32_t {
+            std::error_code equivalentEc;
+            return fs::equivalent(root / dir, cacheDir, equivalentEc) ? CacheDirectorySource
+                                                                       : DirectorySource;
+        };
+
+        // Sources
+        std::vector<std::pair<fs::path, Source>> sources;
+        for (const auto &report : voicebank.reports) {
+            Source source = {};
+            source.type = OtoSource;
+            source.entryCount = static_cast<std::uint32_t>(report.entryCount);
+            if (!report.success ||
+                !statSource(root / report.path, false, source.size, source.mtime)) {
+                return false;
+            }
+            sources.emplace_back(report.path, source);
+        }
+        {
+            std::vector<fs::path> dirs{fs::path()};
+            if (options.recursive) {
+                fs::recursive_directory_iterator it(
+                    root, fs::directory_options::skip_permission_denied, ec);
+                for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+                    std::error_code typeEc;
+                    if (it->is_directory(typeEc)) {
+                        dirs.push_back(it->path().lexically_relative(root));
+                    }
+                }
+            }
+            for (const auto &dir : dirs) {
+                Source source = {};
+                source.type = directoryType(dir);
+                if (source.type == DirectorySource &&
+                    !statSource(root / dir, true, source.size, source.mtime)) {
+                    return false;
+                }
+                sources.emplace_back(dir, source);
+            }
+        }
+        for (auto &item : sources) {
+            auto sourcePath = genericPathToUtf8(item.first);
+            item.second.pathOffset = strings.add(sourcePath);
+            item.second.pathLength = static_cast<std::uint32_t>(sourcePath.size());
+        }
+
+        // Records, each entry is stored once and the slots refer to it by record number
+        const auto entries = voicebank.oto.entries(true);
+        std::vector<Record> records;
+        records.reserve(entries.size());
+        for (const auto &genon : entries) {
+            records.push_back(makeRecord(*genon, strings));
+        }
+
+        // The first line of an alias wins, as in OtoIndex
+        std::uint32_t slotCount = 16;
+        while (slotCount < std::uint32_t(records.size()) * 2) {
+            slotCount *= 2;
+        }
+        std::vector<Slot> slots(slotCount, Slot{0, -1});
+        std::vector<std::string_view> keys(slotCount);
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            auto key = OtoIndex::aliasOf(*entries[i]);
+            auto hash = hashOf(key);
+            for (auto j = hash & (slotCount - 1);; j = (j + 1) & (slotCount - 1)) {
+                if (slots[j].record < 0) {
+                    slots[j] = {hash, static_cast<std::int32_t>(i)};
+                    keys[j] = key;
+                    break;
+                }
+                if (slots[j].hash == hash && keys[j] == key) {
+                    break;
+                }
+            }
+        }
+
+        Header header = {};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        header.byteOrder = CACHE_BYTE_ORDER;
+        header.sourceCount = static_cast<std::uint32_t>(sources.size());
+        header.recordCount = static_cast<std::uint32_t>(records.size());
+        header.slotCount = slotCount;
+        header.loadFlags = loadFlagsOf(options);
+        header.sourcesOffset = align8(sizeof(Header));
+        header.recordsOffset = align8(header.sourcesOffset + sources.size() * sizeof(Source));
+        header.slotsOffset = align8(header.recordsOffset + records.size() * sizeof(Record));
+        header.stringsOffset = align8(header.slotsOffset + slots.size() * sizeof(Slot));
+        header.stringsSize = strings.data().size();
+        header.fileSize = header.stringsOffset + header.stringsSize;
+
+        std::string data(header.fileSize, '\0');
+        auto write = [&data](std::uint64_t offset, const void *src, std::size_t size) {
+            if (size > 0) {
+                std::memcpy(&data[offset], src, size);
+            }
+        };
+        write(0, &header, sizeof(header));
+        for (size_t i = 0; i < sources.size(); ++i) {
+            write(header.sourcesOffset + i * sizeof(Source), &sources[i].second, sizeof(Source));
+        }
+        write(header.recordsOffset, records.data(), records.size() * sizeof(Record));
+        write(header.slotsOffset, slots.data(), slots.size() * sizeof(Slot));
+        write(header.stringsOffset, strings.data().data(), strings.data().size());
+
+        // Write a temporary file next to the cache and replace the cache at once, so a reader
+        // never maps a partly written file
+        char suffix[24];
+        std::snprintf(suffix, sizeof(suffix), ".tmp%08x", std::random_device()());
+        auto tempPath = path;
+        tempPath += suffix;
+        std::ofstream fs(tempPath, std::ios::binary | std::ios::trunc);
+        if (fs.is_open()) {
+            fs.write(data.data(), static_cast<std::streamsize>(data.size()));
+            fs.close();
+        }
+        if (fs.fail()) {
+            fs::remove(tempPath, ec);
+            return false;
+        }
+        fs::rename(tempPath, path, ec);
+        if (ec) {
+            fs::remove(tempPath, ec);
+            return false;
+        }
+
+        // Stamp the cache with its directory, now that the directory won't change again
+        auto dirTime = fs::last_write_time(cacheDir, ec);
+        if (!ec) {
+            fs::last_write_time(path, dirTime, ec);
+        }
+        return !ec;
+    }
+
+    /*!
+        Returns the default snapshot path, which is in the voicebank root.
+    */
+    std::filesystem::path OtoCache::defaultPath(const std::filesystem::path &root) {
+        return root / OTO_CACHE_FILE_NAME;
+    }
+
+    /*!
+        Maps the snapshot file, returns \c true if it's a snapshot of this version.
+    */
+    bool OtoCache::open(const std::filesystem::path &path) {
+        close();
+
+        auto file = std::make_unique<MappedFile>();
+        if (!file->open(path) || !isValidCache(file->data())) {
+            return false;
+        }
+        m_file = std::move(file);
+        m_path = path;
+        return true;
+    }
+
+    /*!
+        Unmaps the snapshot, all entries returned before become dangling.
+    */
+    void OtoCache::close() {
+        m_file.reset();
+        m_path.clear();
+    }
+
+    /*!
+        Returns \c true if a snapshot is open.
+    */
+    bool OtoCache::isOpen() const {
+        return m_file != nullptr;
+    }
+
+    /*!
+        Returns \c true if no source of the snapshot in \a root has changed its size or
+        modification time, and no source has been removed.
+    */
+    bool OtoCache::isValid(const std::filesystem::path &root) const {
+        if (!m_file) {
+            return false;
+        }
+        auto view = viewOf(m_file->data());
+        for (std::uint32_t i = 0; i < view.header->sourceCount; ++i) {
+            const auto &source = view.sources[i];
+            auto path = root / utf8ToPath(view.string(source.pathOffset, source.pathLength));
+            auto expected = source;
+            if (source.type == CacheDirectorySource &&
+                !statSource(m_path, false, expected.size, expected.mtime)) {
+                return false;
+            }
+            std::int64_t size;
+            std::int64_t mtime;
+            if (!statSource(path, source.type != OtoSource, size, mtime) ||
+                (source.type == OtoSource && size != expected.size) ||
+                mtime != expected.mtime) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*!
+        \overload
+
+        Also returns \c false if the snapshot was built with other load \a options, whose
+        entries may differ even if no source has changed.
+    */
+    bool OtoCache::isValid(const std::filesystem::path &root,
+                           const VoicebankLoadOptions &options) const {
+        return m_file && viewOf(m_file->data()).header->loadFlags == loadFlagsOf(options) &&
+               isValid(root);
+    }
+
+    /*!
+        Returns the number of entries.
+    */
+    int OtoCache::size() const {
+        return m_file ? static_cast<int>(viewOf(m_file->data()).header->recordCount) : 0;
+    }
+
+    /*!
+        Returns the entry at \a index, the entries are in the line order of the source files.
+    */
+    OtoCacheEntry OtoCache::entry(int index) const {
+        if (index < 0 || index >= size()) {
+            return {};
+        }
+        auto view = viewOf(m_file->data());
+        return view.entry(view.records[index]);
+    }
+
+    /*!
+        Finds the entry of the alias with the same rules as OtoIndex, returns \c true if found.
+    */
+    bool OtoCache::find(const std::string_view &alias, OtoCacheEntry &entry) const {
+        if (!m_file) {
+            return false;
+        }
+        auto view = viewOf(m_file->data());
+        auto mask = view.header->slotCount - 1;
+        auto hash = hashOf(alias);
+        for (auto i = hash & mask;; i = (i + 1) & mask) {
+            const auto &slot = view.slots[i];
+            if (slot.record < 0) {
+                return false;
+            }
+            if (slot.hash != hash) {
+                continue;
+            }
+            auto res = view.entry(view.records[slot.record]);
+            if (OtoIndex::aliasOf(res.fileName, res.alias) == alias) {
+                entry = res;
+                return true;
+            }
+        }
+    }
+
+    /*!
+        Replaces the contents, index and reports of the voicebank with the snapshot of \a root.
+    */
+    void OtoCache::restore(const std::filesystem::path &root, Voicebank &voicebank) const {
+        voicebank.clear();
+        if (!m_file) {
+            return;
+        }
+        voicebank.root = root;
+
+        auto view = viewOf(m_file->data());
+        auto &oto = voicebank.oto;
+        for (std::uint32_t i = 0; i < view.header->recordCount; ++i) {
+            oto.add(view.entry(view.records[i]).toGenonSettings());
+        }
+
+        // The records follow the files of the sources, so the line runs are taken in order
+        std::uint32_t record = 0;
+        for (std::uint32_t i = 0; i < view.header->sourceCount; ++i) {
+            const auto &source = view.sources[i];
+            if (source.type != OtoSource) {
+                continue;
+            }
+            OtoFileReport report;
+            report.path = utf8ToPath(view.string(source.pathOffset, source.pathLength));
+            report.path.make_preferred();
+            report.subdirectory = report.path.parent_path();
+            report.success = true;
+            report.entryCount = static_cast<int>(source.entryCount);
+            auto end = std::min(view.header->recordCount, record + source.entryCount);
+            for (auto &runs = report.lineRuns; record < end; ++record) {
+                auto fileName = view.entry(view.records[record]).fileName;
+                if (!runs.empty() && runs.back().first == fileName) {
+                    runs.back().second++;
+                } else {
+                    runs.emplace_back(fileName, 1);
+                }
+            }
+            voicebank.reports.push_back(std::move(report));
+        }
+    }
+
+}
@@ -0,0 +1,70 @@
+#ifndef OTOCACHE_H
+#define OTOCACHE_H
+
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+#include <stdutau/otoini.h>
+
+namespace Utau {
+
+    class MappedFile;
+
+    class Voicebank;
+
+    class VoicebankLoadOptions;
+
+    class STDUTAU_EXPORT OtoCacheEntry {
+    public:
+        inline OtoCacheEntry();
+
+        GenonSettings toGenonSettings() const;
+
+    public:
+        std::string_view fileName;
+        std::string_view alias;
+        double offset;
+        double consonant;
+        double blank;
+        double preUtterance;
+        double voiceOverlap;
+    };
+
+    inline OtoCacheEntry::OtoCacheEntry()
+        : offset(0), consonant(0), blank(0), preUtterance(0), voiceOverlap(0) {
+    }
+
+    class STDUTAU_EXPORT OtoCache {
+    public:
+        OtoCache();
+        ~OtoCache();
+
+        OtoCache(const OtoCache &) = delete;
+        OtoCache &operator=(const OtoCache &) = delete;
+
+        static bool build(const Voicebank &voicebank, const std::filesystem::path &path,
+                          const VoicebankLoadOptions &options);
+        static std::filesystem::path defaultPath(const std::filesystem::path &root);
+
+        bool open(const std::filesystem::path &path);
+        void close();
+        bool isOpen() const;
+        bool isValid(const std::filesystem::path &root) const;
+        bool isValid(const std::filesystem::path &root,
+                     const VoicebankLoadOptions &options) const;
+
+        int size() const;
+        OtoCacheEntry entry(int index) const;
+        bool find(const std::string_view &alias, OtoCacheEntry &entry) const;
+
+        void restore(const std::filesystem::path &root, Voicebank &voicebank) const;
+
+    protected:
+        std::unique_ptr<MappedFile> m_file;
+        std::filesystem::path m_path;
+    };
+
+}
+
+#endif // OTOCACHE_H
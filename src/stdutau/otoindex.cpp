@@ -0,0 +1,266 @@
+#include "otoindex.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace Utau {
+
+    static constexpr const std::size_t MIN_SLOT_COUNT = 16;
+
+    static inline std::size_t hashOf(const std::string_view &s) {
+        return std::hash<std::string_view>()(s);
+    }
+
+    /*!
+        \class OtoIndexEntry
+        \brief Entry of an OtoIndex, the strings are views into the string pool of the index.
+    */
+
+    /*!
+        \fn inline OtoIndexEntry::OtoIndexEntry()
+
+        Constructor.
+    */
+
+    /*!
+        Returns a copy of the entry that doesn't depend on the index.
+    */
+    GenonSettings OtoIndexEntry::toGenonSettings() const {
+        GenonSettings genon;
+        genon.fileName = fileName;
+        genon.alias = alias;
+        genon.offset = offset;
+        genon.consonant = consonant;
+        genon.blank = blank;
+        genon.preUtterance = preUtterance;
+        genon.voiceOverlap = voiceOverlap;
+        return genon;
+    }
+
+    /*!
+        \class OtoIndex
+        \brief Open addressing hash index from alias to \c oto.ini entry.
+
+        The first entry of an alias wins and later duplicates are ignored, as UTAU does. The index
+        interns the file names and aliases in a StringPool and keeps the parameters of each alias
+        in a \c std::deque, which doesn't move them when it grows, and the keys are read from
+        these entries. So a pointer returned by find() stays valid until the index is cleared or
+        destroyed, whatever happens to the lists that the entries came from. Changes to those
+        lists are not seen until the index is rebuilt.
+
+        The pool may be shared with the owner of the index, it keeps its strings when the index
+        is cleared. A copy of the index interns its strings in a new pool.
+    */
+
+    /*!
+        Constructs an empty index with a new string pool.
+    */
+    OtoIndex::OtoIndex() : OtoIndex(std::make_shared<StringPool>()) {
+    }
+
+    /*!
+        Constructs an empty index that interns its strings in the given pool.
+    */
+    OtoIndex::OtoIndex(std::shared_ptr<StringPool> strings) : m_strings(std::move(strings)) {
+    }
+
+    /*!
+        Copy constructor, the entries are inserted again into a new string pool.
+    */
+    OtoIndex::OtoIndex(const OtoIndex &other) : OtoIndex() {
+        *this = other;
+    }
+
+    /*!
+        Move constructor, the moved-from index may only be assigned or destroyed.
+    */
+    OtoIndex::OtoIndex(OtoIndex &&other) = default;
+
+    /*!
+        Destructor.
+    */
+    OtoIndex::~OtoIndex() = default;
+
+    OtoIndex &OtoIndex::operator=(const OtoIndex &other) {
+        if (this == &other) {
+            return *this;
+        }
+        m_strings = std::make_shared<StringPool>();
+        m_entries.clear();
+        m_slots.clear();
+        reserve(other.size());
+        for (const auto &entry : other.m_entries) {
+            insert(entry.fileName, entry.alias,
+                   {entry.offset, entry.consonant, entry.blank, entry.preUtterance,
+                    entry.voiceOverlap});
+        }
+        return *this;
+    }
+
+    OtoIndex &OtoIndex::operator=(OtoIndex &&other) = default;
+
+    /*!
+        \fn const std::shared_ptr<StringPool> &OtoIndex::strings() const
+
+        Returns the pool of the file names and aliases.
+    */
+
+    /*!
+        Adds the entry, returns \c false if its alias already exists.
+    */
+    bool OtoIndex::insert(const GenonSettings &genon) {
+        return insert(genon.fileName, genon.alias,
+                      {genon.offset, genon.consonant, genon.blank, genon.preUtterance,
+                       genon.voiceOverlap});
+    }
+
+    /*!
+        \overload
+
+        The values are the offset, consonant, blank, pre-utterance and voice overlap.
+    */
+    bool OtoIndex::insert(const std::string_view &fileName, const std::string_view &alias,
+                          const double (&values)[5]) {
+        auto key = aliasOf(fileName, alias);
+        auto hash = hashOf(key);
+        if (findSlot(key, hash)) {
+            return false;
+        }
+
+        // Intern only the entries that are kept
+        if (!m_strings) {
+            m_strings = std::make_shared<StringPool>();
+        }
+        OtoIndexEntry entry;
+        entry.fileName = m_strings->at(m_strings->intern(fileName));
+        entry.alias = m_strings->at(m_strings->intern(alias));
+        entry.offset = values[0];
+        entry.consonant = values[1];
+        entry.blank = values[2];
+        entry.preUtterance = values[3];
+        entry.voiceOverlap = values[4];
+        m_entries.push_back(entry);
+        addSlot(hash);
+        return true;
+    }
+
+    /*!
+        Returns the entry of the alias, or \c nullptr if there's none. The pointer is valid until
+        the index is cleared or destroyed.
+    */
+    const OtoIndexEntry *OtoIndex::find(const std::string_view &alias) const {
+        auto slot = findSlot(alias, hashOf(alias));
+        return slot ? &m_entries[slot->index] : nullptr;
+    }
+
+    /*!
+        Reserves slots for \a count entries.
+    */
+    void OtoIndex::reserve(int count) {
+        std::size_t slotCount = MIN_SLOT_COUNT;
+        while (slotCount < static_cast<std::size_t>(count) * 2) {
+            slotCount *= 2;
+        }
+        if (slotCount > m_slots.size()) {
+            rehash(slotCount);
+        }
+    }
+
+    /*!
+        Removes all entries, the strings stay in the pool.
+    */
+    void OtoIndex::clear() {
+        m_entries.clear();
+        m_slots.clear();
+    }
+
+    /*!
+        Returns the key of the entry, which is the alias, or the file name without the directory
+        and extension if the alias is empty.
+    */
+    std::string_view OtoIndex::aliasOf(const GenonSettings &genon) {
+        return aliasOf(genon.fileName, genon.alias);
+    }
+
+    /*!
+        \overload
+    */
+    std::string_view OtoIndex::aliasOf(const OtoIndexEntry &entry) {
+        return aliasOf(entry.fileName, entry.alias);
+    }
+
+    /*!
+        \overload
+    */
+    std::string_view OtoIndex::aliasOf(const std::string_view &fileName,
+                                       const std::string_view &alias) {
+        if (!alias.empty()) {
+            return alias;
+        }
+        std::string_view name = fileName;
+        auto slash = name.find_last_of("/\\");
+        if (slash != std::string_view::npos) {
+            name.remove_prefix(slash + 1);
+        }
+        auto dot = name.rfind('.');
+        if (dot != std::string_view::npos) {
+            name = name.substr(0, dot);
+        }
+        return name;
+    }
+
+    const OtoIndex::Slot *OtoIndex::findSlot(const std::string_view &alias,
+                                             std::size_t hash) const {
+        if (m_slots.empty()) {
+            return nullptr;
+        }
+        std::size_t mask = m_slots.size() - 1;
+        for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+            const auto &slot = m_slots[i];
+            if (slot.index < 0) {
+                return nullptr;
+            }
+            if (slot.hash != hash) {
+                continue;
+            }
+            if (aliasOf(m_entries[slot.index]) == alias) {
+                return &slot;
+            }
+        }
+    }
+
+    void OtoIndex::addSlot(std::size_t hash) {
+        // Keep the load factor under 1/2
+        if (m_entries.size() * 2 > m_slots.size()) {
+            rehash(std::max(MIN_SLOT_COUNT, m_slots.size() * 2));
+        }
+
+        int index = static_cast<int>(m_entries.size()) - 1;
+        std::size_t mask = m_slots.size() - 1;
+        for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+            if (m_slots[i].index < 0) {
+                m_slots[i] = {hash, index};
+                break;
+            }
+        }
+    }
+
+    void OtoIndex::rehash(std::size_t slotCount) {
+        std::vector<Slot> slots(slotCount, Slot{0, -1});
+        std::size_t mask = slotCount - 1;
+        for (const auto &slot : m_slots) {
+            if (slot.index < 0) {
+                continue;
+            }
+            for (std::size_t i = slot.hash & mask;; i = (i + 1) & mask) {
+                if (slots[i].index < 0) {
+                    slots[i] = slot;
+                    break;
+                }
+            }
+        }
+        m_slots = std::move(slots);
+    }
+
+}
@@ -0,0 +1,105 @@
+#ifndef OTOINDEX_H
+#define OTOINDEX_H
+
+#include <deque>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <stdutau/genonsettings.h>
+#include <stdutau/stringpool.h>
+
+namespace Utau {
+
+    class STDUTAU_EXPORT OtoIndexEntry {
+    public:
+        inline OtoIndexEntry();
+
+        GenonSettings toGenonSettings() const;
+
+    public:
+        std::string_view fileName; // Interned in the string pool of the index
+        std::string_view alias;
+        double offset;
+        double consonant;
+        double blank;
+        double preUtterance;
+        double voiceOverlap;
+    };
+
+    inline OtoIndexEntry::OtoIndexEntry()
+        : offset(0), consonant(0), blank(0), preUtterance(0), voiceOverlap(0) {
+    }
+
+    class STDUTAU_EXPORT OtoIndex {
+    public:
+        OtoIndex();
+        explicit OtoIndex(std::shared_ptr<StringPool> strings);
+        OtoIndex(const OtoIndex &other);
+        OtoIndex(OtoIndex &&other);
+        ~OtoIndex();
+
+        OtoIndex &operator=(const OtoIndex &other);
+        OtoIndex &operator=(OtoIndex &&other);
+
+        inline const std::shared_ptr<StringPool> &strings() const;
+
+        bool insert(const GenonSettings &genon);
+        bool insert(const std::string_view &fileName, const std::string_view &alias,
+                    const double (&values)[5]);
+
+        const OtoIndexEntry *find(const std::string_view &alias) const;
+        inline bool contains(const std::string_view &alias) const;
+
+        inline int size() const;
+        inline bool empty() const;
+        inline const OtoIndexEntry &at(int index) const;
+
+        void reserve(int count);
+        void clear();
+
+        static std::string_view aliasOf(const GenonSettings &genon);
+        static std::string_view aliasOf(const OtoIndexEntry &entry);
+        static std::string_view aliasOf(const std::string_view &fileName,
+                                        const std::string_view &alias);
+
+    protected:
+        struct Slot {
+            std::size_t hash;
+            int index; // -1 for empty slots
+        };
+
+        std::shared_ptr<StringPool> m_strings;
+
+        // A deque doesn't move the entries when it grows, and the keys are read from them
+        std::deque<OtoIndexEntry> m_entries;
+        std::vector<Slot> m_slots;
+
+        const Slot *findSlot(const std::string_view &alias, std::size_t hash) const;
+        void addSlot(std::size_t hash);
+        void rehash(std::size_t slotCount);
+    };
+
+    inline const std::shared_ptr<StringPool> &OtoIndex::strings() const {
+        return m_strings;
+    }
+
+    inline bool OtoIndex::contains(const std::string_view &alias) const {
+        return find(alias) != nullptr;
+    }
+
+    inline int OtoIndex::size() const {
+        return static_cast<int>(m_entries.size());
+    }
+
+    inline bool OtoIndex::empty() const {
+        return m_entries.empty();
+    }
+
+    inline const OtoIndexEntry &OtoIndex::at(int index) const {
+        return m_entries.at(index);
+    }
+
+}
+
+#endif // OTOINDEX_H
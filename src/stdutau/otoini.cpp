@@ -1,53 +1,99 @@
 #include "otoini.h"
 
-#include <sstream>
+#include <cstring>
 #include <fstream>
+#include <unordered_map>
 
 #include "utautils.h"
+#include "private/mappedfile_p.h"
+#include "private/textbuffer_p.h"
 
 namespace Utau {
 
-    static GenonSettings StringToGenon(const std::string_view &s) {
-        if (s.empty()) {
-            return {};
-        }
-
+    // Reads the tokens of a line in place, returns false if it has no file name
+    static bool parseGenonLine(const std::string_view &s, std::string_view &fileName,
+                               std::string_view &alias, double (&values)[5]) {
         auto eq = s.find(EQUAL);
-        if (eq == std::string::npos) {
-            return {};
+        if (eq == std::string::npos || eq == 0) {
+            return false;
         }
 
         auto key = s.substr(0, eq);
         auto tokens = s.substr(eq + 1);
-        auto tokenList = split(tokens, {&COMMA, 1});
-        if (tokenList.empty())
-            return {}; // No file name is not acceptable
-
-        while (tokenList.size() < 6) {
-            tokenList.emplace_back("0"); // If the following entry is missing, we simply fill with 0
-        }
-
-        GenonSettings res;
-        res.fileName = key;
-        res.alias = tokenList[0];
-        res.offset = stod2(tokenList[1]);
-        res.consonant = stod2(tokenList[2]);
-        res.blank = stod2(tokenList[3]);
-        res.preUtterance = stod2(tokenList[4]);
-        res.voiceOverlap = stod2(tokenList[5]);
-        return res;
+
+        // Same tokens as split(), read in place without a temporary list
+        std::string_view tokenList[6];
+        std::string_view::size_type pos = 0;
+        int count = 0;
+        while (count < 6) {
+            auto comma = tokens.find(COMMA, pos);
+            if (comma == std::string_view::npos) {
+                tokenList[count++] = tokens.substr(pos);
+                break;
+            }
+            tokenList[count++] = tokens.substr(pos, comma - pos);
+            pos = comma + 1;
+        }
+        while (count < 6) {
+            tokenList[count++] = "0"; // If the following entry is missing, we simply fill with 0
+        }
+
+        fileName = key;
+        alias = tokenList[0];
+        for (int i = 0; i < 5; ++i) {
+            values[i] = stod2(tokenList[i + 1]);
+        }
+        return true;
+    }
+
+    // Calls func(line) for the lines split in the same way as a text mode file stream
+    template <class Func>
+    static void forEachLine(const std::string_view &data, Func &&func) {
+        const char *p = data.data();
+        const char *end = p + data.size();
+        while (p < end) {
+            auto lineEnd = static_cast<const char *>(std::memchr(p, '\n', end - p));
+            if (!lineEnd) {
+                lineEnd = end;
+            }
+            std::string_view line(p, lineEnd - p);
+#ifdef _WIN32
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+#endif
+            func(line);
+            p = lineEnd + 1;
+        }
     }
 
-    static std::string GenonToString(const GenonSettings &genon) {
-        std::stringstream out;
-        out << genon.fileName << EQUAL;
-        out << genon.alias << COMMA;
-        out << genon.offset << COMMA;
-        out << genon.consonant << COMMA;
-        out << genon.blank << COMMA;
-        out << genon.preUtterance << COMMA;
-        out << genon.voiceOverlap;
-        return out.str();
+    static GenonSettings makeGenon(const std::string_view &fileName, const std::string_view &alias,
+                                   const double (&values)[5]) {
+        GenonSettings genon;
+        genon.fileName = fileName;
+        genon.alias = alias;
+        genon.offset = values[0];
+        genon.consonant = values[1];
+        genon.blank = values[2];
+        genon.preUtterance = values[3];
+        genon.voiceOverlap = values[4];
+        return genon;
+    }
+
+    static void writeGenon(const std::string_view &fileName, const std::string_view &alias,
+                           const double (&values)[5], TextBuffer &out) {
+        out.append(fileName).append(EQUAL).append(alias);
+        for (double num : values) {
+            out.append(COMMA).appendDouble(num);
+        }
+        out.append('\n');
+    }
+
+    static void writeGenon(const GenonSettings &genon, TextBuffer &out) {
+        writeGenon(genon.fileName, genon.alias,
+                   {genon.offset, genon.consonant, genon.blank, genon.preUtterance,
+                    genon.voiceOverlap},
+                   out);
     }
 
     /*!
@@ -56,6 +102,13 @@ namespace Utau {
 
         The string data in this class is pure bytes, please perform appropriate encoding speculation
         and conversion when accessing.
+
+        The reading functions and add() also add the items to index() in the order of the lines,
+        so the entry of an alias can be found without scanning \a contents. The index keeps the
+        parameters of each alias with the file name and alias interned, so modifying \a contents
+        directly never leaves it dangling, call rebuildIndex() afterwards for the index to see
+        the changes. The order of the lines is kept as runs of file names interned in the same
+        pool.
     */
 
     /*!
@@ -63,43 +116,294 @@ namespace Utau {
     */
     OtoIni::OtoIni() = default;
 
+    /*!
+        Copy constructor.
+    */
+    OtoIni::OtoIni(const OtoIni &other) : UtaFileBase(other) {
+        *this = other;
+    }
+
+    /*!
+        Move constructor.
+    */
+    OtoIni::OtoIni(OtoIni &&other) = default;
+
+    /*!
+        Destructor.
+    */
+    OtoIni::~OtoIni() = default;
+
+    OtoIni &OtoIni::operator=(const OtoIni &other) {
+        if (this == &other) {
+            return *this;
+        }
+        contents = other.contents;
+
+        // The copy of the index has a new pool, intern the file names of the runs into it
+        m_index = other.m_index;
+        m_lineRuns.clear();
+        m_lineRuns.reserve(other.m_lineRuns.size());
+        for (const auto &run : other.m_lineRuns) {
+            auto fileName = other.m_index.strings()->at(run.first);
+            m_lineRuns.emplace_back(m_index.strings()->intern(fileName), run.second);
+        }
+        return *this;
+    }
+
+    OtoIni &OtoIni::operator=(OtoIni &&other) = default;
+
+    /*!
+        Maps the file into memory and reads \c oto.ini items from it, returns \c true if success.
+    */
+    bool OtoIni::loadMapped(const std::filesystem::path &path) {
+        MappedFile file;
+        if (!file.open(path))
+            return false;
+
+        return read(file.data());
+    }
+
     /*!
         Reads \c oto.ini items from stream, returns \c true if success.
     */
     bool OtoIni::read(std::istream &is) {
         std::string line;
         while (std::getline(is, line)) {
-            if (line.empty()) {
-                continue;
+            addLine(line);
+        }
+        return true;
+    }
+
+    /*!
+        Reads \c oto.ini items from the buffer, returns \c true if success.
+
+        The lines are split in the same way as a text mode file stream.
+    */
+    bool OtoIni::read(const std::string_view &data) {
+        forEachLine(data, [this](const std::string_view &line) { addLine(line); });
+        return true;
+    }
+
+    /*!
+        Writes \c oto.ini items to stream in the file name order, returns \c true if success.
+    */
+    bool OtoIni::write(std::ostream &os) const {
+        return write(os, {});
+    }
+
+    /*!
+        Writes \c oto.ini items to stream with the given options, returns \c true if success.
+
+        The lines are formatted into a buffer and written in large blocks.
+    */
+    bool OtoIni::write(std::ostream &os, const OtoWriteOptions &options) const {
+        TextBuffer out;
+        if (options.keepLineOrder) {
+            for (const auto &genon : entries(true)) {
+                writeGenon(*genon, out);
+                if (!out.flushBlock(os))
+                    return false;
+            }
+        } else {
+            for (const auto &item : contents) {
+                for (const auto &genon : item.second) {
+                    writeGenon(genon, out);
+                    if (!out.flushBlock(os))
+                        return false;
+                }
             }
+        }
+        return out.flush(os);
+    }
 
-            auto genon = StringToGenon(line);
-            const auto &fileName = genon.fileName;
-            if (fileName.empty())
-                continue;
+    /*!
+        Writes the specific file with the given options, returns \c true if success.
+    */
+    bool OtoIni::save(const std::filesystem::path &path, const OtoWriteOptions &options) const {
+        std::ofstream fs(path);
+        if (!fs.is_open())
+            return false;
+        return write(fs, options);
+    }
+
+    /*!
+        Appends the \c oto.ini items of the buffer to \a table, returns \c true if success.
+
+        Nothing is allocated outside the resource of the table, so a whole voicebank can be
+        read into a \c std::pmr::monotonic_buffer_resource and released at once.
+    */
+    bool OtoIni::readTable(const std::string_view &data, OtoTable &table) {
+        forEachLine(data, [&table](const std::string_view &line) {
+            std::string_view fileName;
+            std::string_view alias;
+            double values[5];
+            if (parseGenonLine(line, fileName, alias, values)) {
+                table.append(fileName, alias, values);
+            }
+        });
+        return true;
+    }
+
+    /*!
+        Appends the \c oto.ini items of the buffer to \a genons in the line order, returns
+        \c true if success.
+
+        No index is built, the items can be merged into an OtoIni with add() afterwards.
+    */
+    bool OtoIni::readEntries(const std::string_view &data, std::vector<GenonSettings> &genons) {
+        forEachLine(data, [&genons](const std::string_view &line) {
+            std::string_view fileName;
+            std::string_view alias;
+            double values[5];
+            if (!line.empty() && parseGenonLine(line, fileName, alias, values)) {
+                genons.push_back(makeGenon(fileName, alias, values));
+            }
+        });
+        return true;
+    }
+
+    /*!
+        Writes the items of \a table to stream in the order of the rows, returns \c true if
+        success.
+    */
+    bool OtoIni::writeTable(std::ostream &os, const OtoTable &table) {
+        TextBuffer out;
+        for (int i = 0; i < table.size(); ++i) {
+            writeGenon(table.fileName.at(i), table.alias.at(i),
+                       {table.offset[i], table.consonant[i], table.blank[i],
+                        table.preUtterance[i], table.voiceOverlap[i]},
+                       out);
+            if (!out.flushBlock(os))
+                return false;
+        }
+        return out.flush(os);
+    }
+
+    /*!
+        Appends an item as if it's the next line, it's also added to the index.
+    */
+    void OtoIni::add(GenonSettings genon) {
+        m_index.insert(genon);
+
+        auto fileName = m_index.strings()->intern(genon.fileName);
+        if (!m_lineRuns.empty() && m_lineRuns.back().first == fileName) {
+            m_lineRuns.back().second++;
+        } else {
+            m_lineRuns.emplace_back(fileName, 1);
+        }
+        contents[genon.fileName].push_back(std::move(genon));
+    }
+
+    /*!
+        \overload
+
+        Appends the items in their order as if they're the next lines, the items are moved.
+    */
+    void OtoIni::add(std::vector<GenonSettings> &&genons) {
+        m_index.reserve(m_index.size() + static_cast<int>(genons.size()));
+        for (auto &genon : genons) {
+            add(std::move(genon));
+        }
+        genons.clear();
+    }
+
+    // Calls func(list, position) for all items in the file name order, or in the order of adding
+    template <class Func>
+    void OtoIni::forEachEntry(bool lineOrder, Func &&func) const {
+        if (!lineOrder) {
+            for (const auto &item : contents) {
+                for (std::size_t i = 0; i < item.second.size(); ++i) {
+                    func(item.second, i);
+                }
+            }
+            return;
+        }
 
+        // Number of items of each file name that have been taken
+        std::unordered_map<const std::vector<GenonSettings> *, std::size_t> taken;
+        std::string fileName; // Reused
+        for (const auto &run : m_lineRuns) {
+            fileName = m_index.strings()->at(run.first);
             auto it = contents.find(fileName);
             if (it == contents.end()) {
-                contents[fileName].push_back(genon);
-            } else {
-                it->second.push_back(genon);
+                continue;
+            }
+            const auto &list = it->second;
+            auto &begin = taken[&list];
+            auto end = std::min(list.size(), begin + run.second);
+            for (; begin < end; ++begin) {
+                func(list, begin);
+            }
+        }
+        for (const auto &item : contents) {
+            auto it = taken.find(&item.second);
+            for (auto i = (it == taken.end()) ? 0 : it->second; i < item.second.size(); ++i) {
+                func(item.second, i);
             }
         }
-        return true;
     }
 
     /*!
-        Writes \c oto.ini items to stream, returns \c true if success.
+        Returns all items in the file name order, or in the order of adding if \a lineOrder is
+        \c true. The items that were put into \a contents directly follow in the file name order.
     */
-    bool OtoIni::write(std::ostream &os) const {
+    std::vector<const GenonSettings *> OtoIni::entries(bool lineOrder) const {
+        std::vector<const GenonSettings *> res;
+        forEachEntry(lineOrder, [&res](const std::vector<GenonSettings> &list, std::size_t i) {
+            res.push_back(&list[i]);
+        });
+        return res;
+    }
+
+    /*!
+        \fn const OtoIndex &OtoIni::index() const
+
+        Returns the alias index of the items.
+    */
+
+    /*!
+        Rebuilds the index from \a contents in the order of entries(true), so the first line of
+        an alias wins as it does when reading. The strings are interned into a new pool, which
+        drops those of the erased file names and items.
+    */
+    void OtoIni::rebuildIndex() {
+        OtoIndex index;
+        std::size_t count = 0;
         for (const auto &item : contents) {
-            for (const auto &genon : item.second) {
-                os << GenonToString(genon) << std::endl;
-                if (!os.good())
-                    return false;
+            count += item.second.size();
+        }
+        index.reserve(static_cast<int>(count));
+
+        // Keep the runs of the file names that are still there
+        std::vector<std::pair<StringPool::Id, int>> lineRuns;
+        lineRuns.reserve(m_lineRuns.size());
+        std::string fileName; // Reused
+        for (const auto &run : m_lineRuns) {
+            fileName = m_index.strings()->at(run.first);
+            if (contents.count(fileName)) {
+                lineRuns.emplace_back(index.strings()->intern(fileName), run.second);
             }
         }
-        return true;
+
+        forEachEntry(true, [&index](const std::vector<GenonSettings> &list, std::size_t i) {
+            index.insert(list[i]);
+        });
+        m_index = std::move(index);
+        m_lineRuns = std::move(lineRuns);
+    }
+
+    void OtoIni::addLine(const std::string_view &line) {
+        if (line.empty()) {
+            return;
+        }
+
+        std::string_view fileName;
+        std::string_view alias;
+        double values[5];
+        if (!parseGenonLine(line, fileName, alias, values))
+            return;
+
+        add(makeGenon(fileName, alias, values));
     }
 
 }
\ No newline at end of file
@@ -2,24 +2,77 @@
 #define OTOINI_H
 
 #include <map>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include <stdutau/utafilebase.h>
 #include <stdutau/genonsettings.h>
+#include <stdutau/otoindex.h>
+#include <stdutau/ototable.h>
 
 namespace Utau {
 
+    class OtoWriteOptions {
+    public:
+        inline OtoWriteOptions();
+
+    public:
+        bool keepLineOrder; // Write in the order of reading instead of the file name order
+    };
+
+    inline OtoWriteOptions::OtoWriteOptions() : keepLineOrder(false) {
+    }
+
     class STDUTAU_EXPORT OtoIni : public UtaFileBase {
     public:
         OtoIni();
+        OtoIni(const OtoIni &other);
+        OtoIni(OtoIni &&other);
+        ~OtoIni();
+
+        OtoIni &operator=(const OtoIni &other);
+        OtoIni &operator=(OtoIni &&other);
+
+        bool loadMapped(const std::filesystem::path &path);
 
         bool read(std::istream &is) override;
+        bool read(const std::string_view &data);
         bool write(std::ostream &os) const override;
+        bool write(std::ostream &os, const OtoWriteOptions &options) const;
+        using UtaFileBase::save;
+        bool save(const std::filesystem::path &path, const OtoWriteOptions &options) const;
+
+        static bool readEntries(const std::string_view &data,
+                                std::vector<GenonSettings> &genons);
+        static bool readTable(const std::string_view &data, OtoTable &table);
+        static bool writeTable(std::ostream &os, const OtoTable &table);
+
+        void add(GenonSettings genon);
+        void add(std::vector<GenonSettings> &&genons);
+        std::vector<const GenonSettings *> entries(bool lineOrder = false) const;
+
+        inline const OtoIndex &index() const;
+        void rebuildIndex();
 
     public:
         std::map<std::string, std::vector<GenonSettings>> contents;
+
+    protected:
+        // Runs of consecutive lines with the same file name, in the order of adding, the file
+        // names are interned in the string pool of the index
+        std::vector<std::pair<StringPool::Id, int>> m_lineRuns;
+        OtoIndex m_index;
+
+        template <class Func>
+        void forEachEntry(bool lineOrder, Func &&func) const;
+        void addLine(const std::string_view &line);
     };
 
+    inline const OtoIndex &OtoIni::index() const {
+        return m_index;
+    }
+
 }
 
 #endif // OTOINI_H
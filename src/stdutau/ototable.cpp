@@ -0,0 +1,148 @@
+#include "ototable.h"
+
+#include <algorithm>
+
+#include "otoindex.h"
+
+namespace Utau {
+
+    /*!
+        \class OtoTable
+        \brief Column storage of the \c oto.ini entries.
+
+        The file names and aliases are interned in a StringPool and the parameters are
+        contiguous arrays indexed by row, the rows are in the order of the lines.
+
+        All columns, the pool and the alias lookup allocate from the memory resource of the
+        table, so a voicebank read with OtoIni::readTable() into a table in a
+        \c std::pmr::monotonic_buffer_resource is released at once. OtoIni itself keeps its
+        standard containers.
+    */
+
+    /*!
+        Constructs an empty table with a new string pool.
+    */
+    OtoTable::OtoTable() : OtoTable(std::pmr::get_default_resource()) {
+    }
+
+    /*!
+        Constructs an empty table with a new string pool, the table and the pool allocate from
+        \a resource.
+    */
+    OtoTable::OtoTable(std::pmr::memory_resource *resource)
+        : OtoTable(std::allocate_shared<StringPool>(
+              std::pmr::polymorphic_allocator<StringPool>(resource), resource)) {
+    }
+
+    /*!
+        Constructs an empty table that interns its strings in the given pool, the table
+        allocates from the resource of the pool.
+    */
+    OtoTable::OtoTable(std::shared_ptr<StringPool> strings)
+        : fileName(strings), alias(strings), offset(strings->resource()),
+          consonant(strings->resource()), blank(strings->resource()),
+          preUtterance(strings->resource()), voiceOverlap(strings->resource()),
+          m_strings(std::move(strings)), m_rows(m_strings->resource()) {
+    }
+
+    /*!
+        \fn const std::shared_ptr<StringPool> &OtoTable::strings() const
+
+        Returns the pool of the file names and aliases.
+    */
+
+    /*!
+        \fn std::pmr::memory_resource *OtoTable::resource() const
+
+        Returns the memory resource of the table.
+    */
+
+    /*!
+        Removes all rows, the strings stay in the pool.
+    */
+    void OtoTable::clear() {
+        fileName.clear();
+        alias.clear();
+        for (auto column : {&offset, &consonant, &blank, &preUtterance, &voiceOverlap}) {
+            column->clear();
+        }
+        m_rows.clear();
+    }
+
+    /*!
+        Reserves the columns for \a count rows.
+    */
+    void OtoTable::reserve(int count) {
+        auto n = static_cast<std::size_t>(std::max(0, count));
+        fileName.ids.reserve(n);
+        alias.ids.reserve(n);
+        for (auto column : {&offset, &consonant, &blank, &preUtterance, &voiceOverlap}) {
+            column->reserve(n);
+        }
+        m_rows.reserve(n);
+    }
+
+    /*!
+        Appends an entry as the last row.
+    */
+    void OtoTable::append(const GenonSettings &genon) {
+        append(genon.fileName, genon.alias,
+               {genon.offset, genon.consonant, genon.blank, genon.preUtterance,
+                genon.voiceOverlap});
+    }
+
+    /*!
+        \overload
+
+        The values are the offset, consonant, blank, pre-utterance and voice overlap.
+    */
+    void OtoTable::append(const std::string_view &fileName, const std::string_view &alias,
+                          const double (&values)[5]) {
+        int row = size();
+        this->fileName.append(fileName);
+        this->alias.append(alias);
+        offset.push_back(values[0]);
+        consonant.push_back(values[1]);
+        blank.push_back(values[2]);
+        preUtterance.push_back(values[3]);
+        voiceOverlap.push_back(values[4]);
+
+        // The first line of an alias wins
+        m_rows.emplace(m_strings->intern(OtoIndex::aliasOf(fileName, alias)), row);
+    }
+
+    /*!
+        Returns the entry of the row.
+    */
+    GenonSettings OtoTable::entry(int row) const {
+        GenonSettings res;
+        toEntry(row, res);
+        return res;
+    }
+
+    /*!
+        Writes the entry of the row to \a out, whose string capacities are reused.
+    */
+    void OtoTable::toEntry(int row, GenonSettings &out) const {
+        out.fileName = fileName.at(row);
+        out.alias = alias.at(row);
+        out.offset = offset[row];
+        out.consonant = consonant[row];
+        out.blank = blank[row];
+        out.preUtterance = preUtterance[row];
+        out.voiceOverlap = voiceOverlap[row];
+    }
+
+    /*!
+        Returns the first row of the alias with the same rules as OtoIndex, or -1 if not found.
+    */
+    int OtoTable::find(const std::string_view &alias) const {
+        auto id = m_strings->find(alias);
+        if (id < 0) {
+            return -1;
+        }
+        auto it = m_rows.find(id);
+        return it == m_rows.end() ? -1 : it->second;
+    }
+
+}
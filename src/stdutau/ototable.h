@@ -0,0 +1,75 @@
+#ifndef OTOTABLE_H
+#define OTOTABLE_H
+
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+
+#include <stdutau/genonsettings.h>
+#include <stdutau/notetable.h>
+
+namespace Utau {
+
+    class STDUTAU_EXPORT OtoTable {
+    public:
+        OtoTable();
+        explicit OtoTable(std::pmr::memory_resource *resource);
+        explicit OtoTable(std::shared_ptr<StringPool> strings);
+
+        // A copy would share the string pool and put its columns in the default resource
+        OtoTable(const OtoTable &) = delete;
+        OtoTable &operator=(const OtoTable &) = delete;
+        OtoTable(OtoTable &&) = default;
+        OtoTable &operator=(OtoTable &&) = default;
+
+        inline const std::shared_ptr<StringPool> &strings() const;
+        inline std::pmr::memory_resource *resource() const;
+
+        inline int size() const;
+        inline bool empty() const;
+        void clear();
+        void reserve(int count);
+
+        void append(const GenonSettings &genon);
+        void append(const std::string_view &fileName, const std::string_view &alias,
+                    const double (&values)[5]);
+
+        GenonSettings entry(int row) const;
+        void toEntry(int row, GenonSettings &out) const;
+        int find(const std::string_view &alias) const;
+
+    public:
+        // The aliases of a recording share its file name
+        InternedColumn fileName;
+        InternedColumn alias;
+
+        std::pmr::vector<double> offset, consonant, blank;
+        std::pmr::vector<double> preUtterance, voiceOverlap;
+
+    protected:
+        std::shared_ptr<StringPool> m_strings;
+
+        // First row of each alias, with the same rules as OtoIndex
+        std::pmr::unordered_map<StringPool::Id, int> m_rows;
+    };
+
+    inline const std::shared_ptr<StringPool> &OtoTable::strings() const {
+        return m_strings;
+    }
+
+    inline std::pmr::memory_resource *OtoTable::resource() const {
+        return m_strings->resource();
+    }
+
+    inline int OtoTable::size() const {
+        return static_cast<int>(offset.size());
+    }
+
+    inline bool OtoTable::empty() const {
+        return offset.empty();
+    }
+
+}
+
+#endif // OTOTABLE_H
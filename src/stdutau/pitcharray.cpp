@@ -0,0 +1,244 @@
+#include "pitcharray.h"
+
+#include <charconv>
+#include <cstring>
+#include <utility>
+
+#include "utautils.h"
+
+namespace Utau {
+
+    /*!
+        \class PitchArray
+        \brief Compact storage of the Mode1 pitch bend values.
+
+        The values are integer cents, which are stored as 16-bit integers, and up to
+        INLINE_CAPACITY values are kept inside the object without a heap allocation. An array
+        takes a quarter of the memory of the same values in a \c std::vector<double>.
+
+        The conversions from doubles and ints fail instead of rounding, so a value that is read
+        back is always equal to the one that was stored.
+    */
+
+    /*!
+        Constructs an empty array.
+    */
+    PitchArray::PitchArray() : m_size(0), m_capacity(INLINE_CAPACITY), m_heap(nullptr) {
+    }
+
+    /*!
+        Copy constructor.
+    */
+    PitchArray::PitchArray(const PitchArray &other) : PitchArray() {
+        *this = other;
+    }
+
+    /*!
+        Move constructor.
+    */
+    PitchArray::PitchArray(PitchArray &&other) noexcept : PitchArray() {
+        *this = std::move(other);
+    }
+
+    /*!
+        Destructor.
+    */
+    PitchArray::~PitchArray() {
+        if (!isInline()) {
+            delete[] m_heap;
+        }
+    }
+
+    /*!
+        Copy assignment.
+    */
+    PitchArray &PitchArray::operator=(const PitchArray &other) {
+        if (this == &other) {
+            return *this;
+        }
+        m_size = 0;
+        reserve(other.m_size);
+        std::memcpy(data(), other.data(), other.m_size * sizeof(value_type));
+        m_size = other.m_size;
+        return *this;
+    }
+
+    /*!
+        Move assignment, the inline values are copied and the heap buffer is taken over.
+    */
+    PitchArray &PitchArray::operator=(PitchArray &&other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        if (!isInline()) {
+            delete[] m_heap;
+        }
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+        if (other.isInline()) {
+            std::memcpy(m_inline, other.m_inline, sizeof(m_inline));
+        } else {
+            m_heap = other.m_heap;
+        }
+        other.m_size = 0;
+        other.m_capacity = INLINE_CAPACITY;
+        other.m_heap = nullptr;
+        return *this;
+    }
+
+    /*!
+        Removes all values and releases the heap buffer.
+    */
+    void PitchArray::clear() {
+        if (!isInline()) {
+            delete[] m_heap;
+        }
+        m_size = 0;
+        m_capacity = INLINE_CAPACITY;
+        m_heap = nullptr;
+    }
+
+    /*!
+        Ensures that the array can hold \a capacity values without a reallocation.
+    */
+    void PitchArray::reserve(std::size_t capacity) {
+        if (capacity <= m_capacity) {
+            return;
+        }
+        auto buffer = new value_type[capacity];
+        std::memcpy(buffer, data(), m_size * sizeof(value_type));
+        if (!isInline()) {
+            delete[] m_heap;
+        }
+        m_heap = buffer;
+        m_capacity = static_cast<std::uint32_t>(capacity);
+    }
+
+    /*!
+        Resizes the array, the new values are zero.
+    */
+    void PitchArray::resize(std::size_t size) {
+        reserve(size);
+        if (size > m_size) {
+            std::memset(data() + m_size, 0, (size - m_size) * sizeof(value_type));
+        }
+        m_size = static_cast<std::uint32_t>(size);
+    }
+
+    /*!
+        Appends a value.
+    */
+    void PitchArray::push_back(value_type value) {
+        if (m_size == m_capacity) {
+            reserve(m_capacity * 2);
+        }
+        data()[m_size++] = value;
+    }
+
+    /*!
+        Parses the comma separated values of the \c PitchBend key, returns \c false if a value is
+        not an integer in range.
+
+        The values are read in the same way as the decoder of \c Note::pitches, an empty or
+        malformed value is zero, and most values take a plain integer path without a detour
+        through floating point.
+    */
+    bool PitchArray::parse(const std::string_view &s) {
+        std::size_t count = 1;
+        for (auto ch : s) {
+            count += (ch == ',');
+        }
+
+        m_size = 0;
+        reserve(count);
+
+        auto out = data();
+        const char *p = s.data();
+        const char *last = p + s.size();
+        for (std::size_t i = 0; i < count; ++i) {
+            auto comma =
+                (p < last) ? static_cast<const char *>(std::memchr(p, ',', last - p)) : nullptr;
+            const char *tokenEnd = comma ? comma : last;
+
+            int num;
+            auto res = std::from_chars(p, tokenEnd, num);
+            if (res.ec != std::errc() || res.ptr != tokenEnd || !isRepresentable(num)) {
+                // Not a plain integer, try the general decoder
+                double value = stod2(std::string_view(p, tokenEnd - p));
+                if (!isRepresentable(value)) {
+                    clear();
+                    return false;
+                }
+                num = static_cast<int>(value);
+            }
+            out[i] = static_cast<value_type>(num);
+            p = comma ? comma + 1 : last;
+        }
+        m_size = static_cast<std::uint32_t>(count);
+        return true;
+    }
+
+    /*!
+        Stores the values, returns \c false if a value is not an integer in range.
+
+        Negative zero is stored as zero.
+    */
+    bool PitchArray::assign(const std::vector<double> &values) {
+        m_size = 0;
+        reserve(values.size());
+        auto out = data();
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            if (!isRepresentable(values[i])) {
+                clear();
+                return false;
+            }
+            out[i] = static_cast<value_type>(values[i]);
+        }
+        m_size = static_cast<std::uint32_t>(values.size());
+        return true;
+    }
+
+    /*!
+        \overload
+    */
+    bool PitchArray::assign(const std::vector<int> &values) {
+        m_size = 0;
+        reserve(values.size());
+        auto out = data();
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            if (!isRepresentable(values[i])) {
+                clear();
+                return false;
+            }
+            out[i] = static_cast<value_type>(values[i]);
+        }
+        m_size = static_cast<std::uint32_t>(values.size());
+        return true;
+    }
+
+    /*!
+        Returns the values as doubles, in the form of \c Note::pitches.
+    */
+    std::vector<double> PitchArray::toDoubles() const {
+        std::vector<double> res;
+        toDoubles(res);
+        return res;
+    }
+
+    /*!
+        \overload
+
+        Writes to \a out, whose capacity is reused.
+    */
+    void PitchArray::toDoubles(std::vector<double> &out) const {
+        out.assign(begin(), end());
+    }
+
+    /*!
+        Returns the values as ints, in the form of \c ResamplerArguments::pitchCurves.
+    */
+    std::vector<int> PitchArray::toInts() const {
+        return std::vector<int>(begin(), end());
+    }
+
+}
@@ -0,0 +1,119 @@
+#ifndef PITCHARRAY_H
+#define PITCHARRAY_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <stdutau/utaglobal.h>
+
+namespace Utau {
+
+    class STDUTAU_EXPORT PitchArray {
+    public:
+        using value_type = std::int16_t;
+
+        PitchArray();
+        PitchArray(const PitchArray &other);
+        PitchArray(PitchArray &&other) noexcept;
+        ~PitchArray();
+
+        PitchArray &operator=(const PitchArray &other);
+        PitchArray &operator=(PitchArray &&other) noexcept;
+
+        inline std::size_t size() const;
+        inline bool empty() const;
+        inline std::size_t capacity() const;
+        inline bool isInline() const;
+
+        inline const value_type *data() const;
+        inline value_type *data();
+        inline const value_type *begin() const;
+        inline const value_type *end() const;
+        inline value_type operator[](std::size_t index) const;
+        inline value_type &operator[](std::size_t index);
+
+        void clear();
+        void reserve(std::size_t capacity);
+        void resize(std::size_t size);
+        void push_back(value_type value);
+
+        // Each returns false and clears the array if a value is not representable
+        bool parse(const std::string_view &s);
+        bool assign(const std::vector<double> &values);
+        bool assign(const std::vector<int> &values);
+
+        std::vector<double> toDoubles() const;
+        void toDoubles(std::vector<double> &out) const;
+        std::vector<int> toInts() const;
+
+        static inline bool isRepresentable(double value);
+        static inline bool isRepresentable(int value);
+
+        // Values stored without a heap allocation, the array is as large as a std::vector
+        static constexpr const std::size_t INLINE_CAPACITY = sizeof(value_type *) * 2 /
+                                                              sizeof(value_type);
+
+        static constexpr const int VALUE_MIN = INT16_MIN;
+        static constexpr const int VALUE_MAX = INT16_MAX;
+
+    protected:
+        std::uint32_t m_size;
+        std::uint32_t m_capacity; // INLINE_CAPACITY while the values are inline
+        union {
+            value_type *m_heap;
+            value_type m_inline[INLINE_CAPACITY];
+        };
+    };
+
+    inline std::size_t PitchArray::size() const {
+        return m_size;
+    }
+
+    inline bool PitchArray::empty() const {
+        return m_size == 0;
+    }
+
+    inline std::size_t PitchArray::capacity() const {
+        return m_capacity;
+    }
+
+    inline bool PitchArray::isInline() const {
+        return m_capacity == INLINE_CAPACITY;
+    }
+
+    inline const PitchArray::value_type *PitchArray::data() const {
+        return isInline() ? m_inline : m_heap;
+    }
+
+    inline PitchArray::value_type *PitchArray::data() {
+        return isInline() ? m_inline : m_heap;
+    }
+
+    inline const PitchArray::value_type *PitchArray::begin() const {
+        return data();
+    }
+
+    inline const PitchArray::value_type *PitchArray::end() const {
+        return data() + m_size;
+    }
+
+    inline PitchArray::value_type PitchArray::operator[](std::size_t index) const {
+        return data()[index];
+    }
+
+    inline PitchArray::value_type &PitchArray::operator[](std::size_t index) {
+        return data()[index];
+    }
+
+    inline bool PitchArray::isRepresentable(double value) {
+        return value >= VALUE_MIN && value <= VALUE_MAX && value == static_cast<int>(value);
+    }
+
+    inline bool PitchArray::isRepresentable(int value) {
+        return value >= VALUE_MIN && value <= VALUE_MAX;
+    }
+
+}
+
+#endif // PITCHARRAY_H
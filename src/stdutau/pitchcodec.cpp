@@ -0,0 +1,184 @@
+#include "pitchcodec.h"
+
+#include <array>
+
+#include "utautils.h"
+
+namespace Utau {
+
+    static constexpr const char Base64EncodeMap[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    static constexpr std::array<signed char, 256> makeDecodeMap() {
+        std::array<signed char, 256> map{};
+        for (auto &item : map) {
+            item = -1;
+        }
+        for (int i = 0; i < 64; ++i) {
+            map[static_cast<unsigned char>(Base64EncodeMap[i])] = static_cast<signed char>(i);
+        }
+        return map;
+    }
+
+    static constexpr const std::array<signed char, 256> Base64DecodeMap = makeDecodeMap();
+
+    static inline char *encodeSingle(int n, char *out) {
+        // The negative values are stored as 12-bit two's complement
+        n &= 0xFFF;
+        out[0] = Base64EncodeMap[n >> 6];
+        out[1] = Base64EncodeMap[n & 0x3F];
+        return out + 2;
+    }
+
+    static inline char *encodeRun(int value, int count, char *out) {
+        // Repeats of the previous value are written as #count# when it's shorter
+        if (count >= 2) {
+            *out++ = '#';
+            out = to_chars2(out, out + NUMBER_BUFFER_SIZE, count);
+            *out++ = '#';
+        } else if (count == 1) {
+            out = encodeSingle(value, out);
+        }
+        return out;
+    }
+
+    /*!
+        \class PitchCodec
+        \brief Codec of the Base64 pitch bend argument of the resampler.
+
+        Every value takes two Base64 digits of a 12-bit two's complement integer, and a value that
+        repeats the previous one \c n times in a row is followed by \c #n#. The \c NODEF_INT values
+        are written as 0, and the values out of VALUE_MIN to VALUE_MAX wrap around.
+    */
+
+    /*!
+        Encodes the values to the buffer, which must hold maxEncodedSize() characters, returns the
+        end of the written characters.
+    */
+    char *PitchCodec::encode(const int *values, std::size_t count, char *out) {
+        int prev = 0;
+        int repeat = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            int value = (values[i] == NODEF_INT) ? 0 : values[i];
+            if (i > 0 && value == prev) {
+                ++repeat;
+                continue;
+            }
+            out = encodeRun(prev, repeat, out);
+            out = encodeSingle(value, out);
+            prev = value;
+            repeat = 0;
+        }
+        return encodeRun(prev, repeat, out);
+    }
+
+    /*!
+        \overload
+    */
+    std::string PitchCodec::encode(const std::vector<int> &values) {
+        std::string res;
+        encode(values, res);
+        return res;
+    }
+
+    /*!
+        \overload
+
+        Encodes to \a out, whose capacity is reused.
+    */
+    void PitchCodec::encode(const std::vector<int> &values, std::string &out) {
+        out.resize(maxEncodedSize(values.size()));
+        char *end = encode(values.data(), values.size(), out.data());
+        out.resize(end - out.data());
+    }
+
+    /*!
+        Encodes the pitch curves of all the resampler arguments into the arena, returns the views
+        of the encoded strings in the same order.
+    */
+    std::vector<std::string_view> PitchCodec::encode(const Synth::SynthParams &params,
+                                                     std::string &arena) {
+        std::size_t size = 0;
+        for (const auto &item : params) {
+            size += maxEncodedSize(item.first.pitchCurves.size());
+        }
+
+        arena.resize(size);
+        std::vector<std::size_t> offsets(params.size() + 1);
+        char *out = arena.data();
+        for (size_t i = 0; i < params.size(); ++i) {
+            const auto &values = params[i].first.pitchCurves;
+            offsets[i] = out - arena.data();
+            out = encode(values.data(), values.size(), out);
+        }
+        offsets[params.size()] = out - arena.data();
+        arena.resize(offsets[params.size()]);
+
+        std::vector<std::string_view> res(params.size());
+        for (size_t i = 0; i < params.size(); ++i) {
+            res[i] = std::string_view(arena.data() + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+        return res;
+    }
+
+    /*!
+        Decodes the pitch bend argument into \a values, returns \c false if the string is
+        malformed, and the position of the error is stored to \a errorPos if it's not null.
+
+        A string that would decode to more than \c DECODED_SIZE_MAX values is malformed, so a
+        short string with a huge run count can't exhaust the memory.
+    */
+    bool PitchCodec::decode(const std::string_view &s, std::vector<int> &values,
+                            std::size_t *errorPos) {
+        values.clear();
+        values.reserve(s.size() / 2);
+
+        auto fail = [&](std::size_t pos) {
+            if (errorPos) {
+                *errorPos = pos;
+            }
+            return false;
+        };
+
+        std::size_t i = 0;
+        while (i < s.size()) {
+            if (s[i] == '#') {
+                std::size_t end = s.find('#', i + 1);
+                if (end == std::string_view::npos || end == i + 1 || values.empty()) {
+                    return fail(i);
+                }
+                // The count is bounded before it's multiplied, so it neither overflows nor
+                // allocates more than the limit
+                std::size_t limit = DECODED_SIZE_MAX - values.size();
+                std::size_t count = 0;
+                for (std::size_t j = i + 1; j < end; ++j) {
+                    if (s[j] < '0' || s[j] > '9') {
+                        return fail(j);
+                    }
+                    count = count * 10 + (s[j] - '0');
+                    if (count > limit) {
+                        return fail(j);
+                    }
+                }
+                int last = values.back();
+                values.insert(values.end(), count, last);
+                i = end + 1;
+                continue;
+            }
+
+            if (i + 1 >= s.size()) {
+                return fail(i);
+            }
+            int hi = Base64DecodeMap[static_cast<unsigned char>(s[i])];
+            int lo = Base64DecodeMap[static_cast<unsigned char>(s[i + 1])];
+            if (hi < 0 || lo < 0) {
+                return fail(hi < 0 ? i : i + 1);
+            }
+            int value = (hi << 6) | lo;
+            values.push_back(value > VALUE_MAX ? value - 4096 : value);
+            i += 2;
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,38 @@
+#ifndef PITCHCODEC_H
+#define PITCHCODEC_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <stdutau/synth.h>
+
+namespace Utau {
+
+    struct STDUTAU_EXPORT PitchCodec {
+        // Upper bound of the encoded length of count values
+        static inline constexpr std::size_t maxEncodedSize(std::size_t count);
+
+        static char *encode(const int *values, std::size_t count, char *out);
+        static std::string encode(const std::vector<int> &values);
+        static void encode(const std::vector<int> &values, std::string &out);
+        static std::vector<std::string_view> encode(const Synth::SynthParams &params,
+                                                    std::string &arena);
+
+        static bool decode(const std::string_view &s, std::vector<int> &values,
+                           std::size_t *errorPos = nullptr);
+
+        static constexpr const int VALUE_MIN = -2048;
+        static constexpr const int VALUE_MAX = 2047;
+
+        // Longest array that decode() accepts, a run may not expand beyond it
+        static constexpr const std::size_t DECODED_SIZE_MAX = 1 << 20;
+    };
+
+    inline constexpr std::size_t PitchCodec::maxEncodedSize(std::size_t count) {
+        return count * 2;
+    }
+
+}
+
+#endif // PITCHCODEC_H
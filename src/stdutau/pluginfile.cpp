@@ -3,21 +3,15 @@
 #include <map>
 #include <set>
 #include <fstream>
-#include <algorithm>
+#include <utility>
 
 #include "private/usthelper_p.h"
+#include "private/mappedfile_p.h"
+#include "private/sharedhelper_p.h"
 #include "utautils.h"
 
 namespace Utau {
 
-    template <class T>
-    inline void detach_shared_ptr(std::shared_ptr<T> &d) {
-        if (d.use_count() == 1)
-            return;
-        auto x = std::make_shared<T>(*d);
-        d = x;
-    }
-
     inline NoteExt createInitialNoteExt() {
         NoteExt note;
 
@@ -59,80 +53,71 @@ namespace Utau {
         Reads plugin information from stream, returns \c true if success.
     */
     bool PluginFileReader::load(const std::filesystem::path &path) {
-        std::ifstream fs(path);
-        if (!fs.is_open())
-            return false;
-        std::istream &is = fs;
-
-        // Read File
-        std::vector<std::string> currentSection;
+        return loadFile(path, nullptr);
+    }
 
-        detach_shared_ptr(d_ptr); // Detach
+    /*!
+        Reads plugin information from stream, the selected notes are appended to \a table
+        instead of notes(), returns \c true if success.
 
-        std::string line;
-        while (std::getline(is, line)) {
-            if (line.empty() && !is.eof()) {
-                continue;
-            }
+        The previous and next notes are still available as NoteExt, the readonly values of the
+        selected notes are not kept in the table. The section lines are allocated from the
+        memory resource of the table.
+    */
+    bool PluginFileReader::load(const std::filesystem::path &path, NoteTable &table) {
+        return loadFile(path, &table);
+    }
 
-            // Continue to add until meet the start of section or end
-            if (!starts_with(line, SECTION_BEGIN_MARK) && !is.eof()) {
-                currentSection.push_back(line);
-                continue;
-            }
+    bool PluginFileReader::loadFile(const std::filesystem::path &path, NoteTable *table) {
+        MappedFile file;
+        if (!file.open(path))
+            return false;
 
-            // If meet end, append without continue
-            if (!line.empty() && is.eof()) {
-                currentSection.push_back(line);
-            }
+        detach_shared_ptr(d_ptr); // Detach
 
-            // Previous section is empty
-            if (currentSection.size() <= 1) {
-                // ...
-            } else {
-                const auto &sectionHead = currentSection[0];
-
-                // If Section Name is invalid
-                std::string_view sectionName;
-                if (!parseSectionName(sectionHead, sectionName)) {
-                    currentSection.clear();
-                    continue;
+        auto d = d_ptr.get();
+#ifdef _WIN32
+        bool stripCR = true; // Keep the same line endings as a text mode file stream
+#else
+        bool stripCR = false;
+#endif
+        readSections(file.data(), stripCR, [d, table](const std::string_view &sectionName,
+                                                      const SectionView &sectionList) {
+            if (sectionName == SECTION_NAME_VERSION) {
+                // Parse Version Sequence
+                parseSectionVersion(sectionList, d->version);
+            } else if (sectionName == SECTION_NAME_SETTING) {
+                // Parse global settings
+                parseSectionSettings(sectionList, d->settings);
+            } else if (isNoteSectionName(sectionName)) {
+                // Parse Note (Name should be numeric)
+                auto note = createInitialNoteExt();
+                parseSectionNoteExt(sectionList, note);
+                // Ignore note whose length is invalid
+                if (note.length <= 0) {
+                    return;
                 }
-
-                if (sectionName == SECTION_NAME_VERSION) {
-                    // Parse Version Sequence
-                    parseSectionVersion(currentSection, d_ptr->version);
-                } else if (sectionName == SECTION_NAME_SETTING) {
-                    // Parse global settings
-                    parseSectionSettings(currentSection, d_ptr->settings);
-                } else if (std::all_of(sectionName.begin(), sectionName.end(), ::isdigit)) {
-                    // Parse Note (Name should be numeric)
-                    auto note = createInitialNoteExt();
-                    parseSectionNoteExt(currentSection, note);
-                    // Ignore note whose length is invalid
-                    if (note.length > 0) {
-                        d_ptr->notes.push_back(note);
-                    }
-                } else if (sectionName == SECTION_NAME_PREV) {
-                    auto note = createInitialNoteExt();
-                    parseSectionNoteExt(currentSection, note);
-                    // Ignore note whose length is invalid
-                    if (note.length > 0) {
-                        d_ptr->prevNote = note;
-                    }
-                } else if (sectionName == SECTION_NAME_NEXT) {
-                    auto note = createInitialNoteExt();
-                    parseSectionNoteExt(currentSection, note);
-                    // Ignore note whose length is invalid
-                    if (note.length > 0) {
-                        d_ptr->nextNote = note;
-                    }
+                if (table) {
+                    table->append(note);
+                } else {
+                    d->notes.push_back(std::move(note));
+                }
+            } else if (sectionName == SECTION_NAME_PREV) {
+                auto note = createInitialNoteExt();
+                parseSectionNoteExt(sectionList, note);
+                // Ignore note whose length is invalid
+                if (note.length > 0) {
+                    d->prevNote = std::move(note);
+                }
+            } else if (sectionName == SECTION_NAME_NEXT) {
+                auto note = createInitialNoteExt();
+                parseSectionNoteExt(sectionList, note);
+                // Ignore note whose length is invalid
+                if (note.length > 0) {
+                    d->nextNote = std::move(note);
                 }
             }
-
-            currentSection.clear();
-            currentSection.push_back(line);
-        }
+        }, table ? table->resource() : std::pmr::get_default_resource());
 
         return true;
     }
@@ -201,6 +186,7 @@ namespace Utau {
             return false;
 
         std::ostream &os = fs;
+        TextBuffer out;
 
         auto d = d_ptr.get();
 
@@ -225,18 +211,18 @@ namespace Utau {
         // Previous
         if (!d->notesBeforePrev.empty()) {
             for (const auto &note : d->notesBeforePrev) {
-                writeSectionName(SECTION_NAME_INSERT, os);
-                writeSectionNote(-1, note, os);
+                writeSectionName(SECTION_NAME_INSERT, out);
+                writeSectionNote(-1, note, out);
             }
 
             // Complement
             if (!d->prevNote) {
-                writeSectionName(SECTION_NAME_PREV, os);
+                writeSectionName(SECTION_NAME_PREV, out);
             }
         }
         if (d->prevNote) {
-            writeSectionName(SECTION_NAME_PREV, os);
-            writeSectionNote(-1, d->prevNote.value(), os);
+            writeSectionName(SECTION_NAME_PREV, out);
+            writeSectionNote(-1, d->prevNote.value(), out);
         }
 
         // Selection
@@ -244,8 +230,8 @@ namespace Utau {
             const auto &item = noteItems.at(i);
             if (item.inserted) {
                 for (const auto &note : *item.inserted) {
-                    writeSectionName(SECTION_NAME_INSERT, os);
-                    writeSectionNote(-1, note, os);
+                    writeSectionName(SECTION_NAME_INSERT, out);
+                    writeSectionNote(-1, note, out);
                 }
             }
 
@@ -254,37 +240,37 @@ namespace Utau {
                 break;
 
             if (item.removed) {
-                writeSectionName(SECTION_NAME_DELETE, os);
+                writeSectionName(SECTION_NAME_DELETE, out);
                 continue;
             }
 
             int idx = d->startIndex + i;
             if (item.changed) {
-                writeSectionNote(idx, *item.changed, os);
+                writeSectionNote(idx, *item.changed, out);
                 continue;
             }
 
             // Keep index
-            writeSectionName(idx, os);
+            writeSectionName(idx, out);
         }
 
         // Next
         if (d->nextNote) {
-            writeSectionName(SECTION_NAME_NEXT, os);
-            writeSectionNote(-1, d->nextNote.value(), os);
+            writeSectionName(SECTION_NAME_NEXT, out);
+            writeSectionNote(-1, d->nextNote.value(), out);
         }
         if (!d->notesAfterNext.empty()) {
             // Complement
             if (!d->nextNote) {
-                writeSectionName(SECTION_NAME_NEXT, os);
+                writeSectionName(SECTION_NAME_NEXT, out);
             }
 
             for (const auto &note : d->notesAfterNext) {
-                writeSectionName(SECTION_NAME_INSERT, os);
-                writeSectionNote(-1, note, os);
+                writeSectionName(SECTION_NAME_INSERT, out);
+                writeSectionNote(-1, note, out);
             }
         }
-        return true;
+        return out.flush(os);
     }
 
     void PluginFileWriter::setNote(int index, const Note &note) {
@@ -4,6 +4,7 @@
 #include <memory>
 
 #include <stdutau/ustfile.h>
+#include <stdutau/notetable.h>
 
 namespace Utau {
 
@@ -12,6 +13,7 @@ namespace Utau {
         PluginFileReader();
 
         bool load(const std::filesystem::path &path);
+        bool load(const std::filesystem::path &path, NoteTable &table);
 
     public:
         UstVersion version() const;
@@ -26,6 +28,8 @@ namespace Utau {
     protected:
         struct Private;
         std::shared_ptr<Private> d_ptr;
+
+        bool loadFile(const std::filesystem::path &path, NoteTable *table);
     };
 
     class STDUTAU_EXPORT PluginFileWriter {
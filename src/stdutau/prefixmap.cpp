@@ -24,10 +24,6 @@ namespace Utau {
         Reads \c prefix.map items from stream, returns \c true if success.
     */
     bool PrefixMap::read(std::istream &is) {
-        static const constexpr int min = TONE_NUMBER_BASE;
-        static const constexpr int max =
-            min + (TONE_OCTAVE_MAX - TONE_OCTAVE_MIN + 1) * TONE_OCTAVE_STEPS - 1;
-
         std::string line;
         while (std::getline(is, line)) {
             if (line.empty()) {
@@ -38,9 +34,9 @@ namespace Utau {
             if (tokens.size() < 3) {
                 continue;
             }
-            int noteNum = toneNameToToneNum(tokens[0]);
-            if (noteNum >= min && noteNum <= max) {
-                map[noteNum] = Item{
+            int index = toneNameToToneNum(tokens[0]) - TONE_NUMBER_BASE;
+            if (index >= 0 && index < TONE_COUNT) {
+                items[index] = Item{
                     std::string(tokens[1]),
                     std::string(tokens[2]),
                 };
@@ -53,10 +49,13 @@ namespace Utau {
         Writes \c prefix.map map items to stream, returns \c true if success.
     */
     bool PrefixMap::write(std::ostream &os) const {
-        for (auto it = map.begin(); it != map.end(); ++it) {
-            int key = it->first;
-            os << toneNumToToneName(key) << "\t" << it->second.prefix << "\t" << it->second.suffix
-               << std::endl;
+        for (int i = 0; i < TONE_COUNT; ++i) {
+            const auto &item = items[i];
+            if (!item) {
+                continue;
+            }
+            os << toneNumToToneName(TONE_NUMBER_BASE + i) << "\t" << item->prefix << "\t"
+               << item->suffix << std::endl;
             if (!os.good())
                 return false;
         }
@@ -67,11 +66,51 @@ namespace Utau {
         Returns the new lyric with the prefix and suffix if found.
     */
     std::string PrefixMap::prefixedLyric(int noteNum, const std::string &lyric) const {
-        auto it = map.find(noteNum);
-        if (it == map.end()) {
+        auto item = find(noteNum);
+        if (!item) {
             return lyric;
         }
-        return it->second.prefix + lyric + it->second.suffix;
+        return item->prefix + lyric + item->suffix;
+    }
+
+    /*!
+        Resolves the prefixed lyrics of all notes into \a arena, returns the views of the lyrics in
+        the same order as the notes.
+
+        The arena is cleared and allocated once, the views are valid until it's modified.
+    */
+    std::vector<std::string_view> PrefixMap::prefixedLyrics(const std::vector<Note> &notes,
+                                                            std::string &arena) const {
+        std::vector<const Item *> found(notes.size());
+        std::size_t size = 0;
+        for (size_t i = 0; i < notes.size(); ++i) {
+            found[i] = find(notes[i].noteNum);
+            size += notes[i].lyric.size();
+            if (found[i]) {
+                size += found[i]->prefix.size() + found[i]->suffix.size();
+            }
+        }
+
+        arena.clear();
+        arena.reserve(size);
+        std::vector<std::size_t> offsets(notes.size() + 1);
+        for (size_t i = 0; i < notes.size(); ++i) {
+            offsets[i] = arena.size();
+            if (found[i]) {
+                arena += found[i]->prefix;
+                arena += notes[i].lyric;
+                arena += found[i]->suffix;
+            } else {
+                arena += notes[i].lyric;
+            }
+        }
+        offsets[notes.size()] = arena.size();
+
+        std::vector<std::string_view> res(notes.size());
+        for (size_t i = 0; i < notes.size(); ++i) {
+            res[i] = std::string_view(arena.data() + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+        return res;
     }
 
 }
\ No newline at end of file
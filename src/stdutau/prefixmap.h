@@ -1,11 +1,15 @@
 #ifndef PREFIXMAP_H
 #define PREFIXMAP_H
 
-#include <map>
+#include <array>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <stdutau/utafilebase.h>
+#include <stdutau/utaconst.h>
+#include <stdutau/note.h>
 
 namespace Utau {
 
@@ -21,11 +25,28 @@ namespace Utau {
             std::string prefix;
             std::string suffix;
         };
-        std::map<int, Item> map;
+
+        static constexpr const int TONE_COUNT =
+            (TONE_OCTAVE_MAX - TONE_OCTAVE_MIN + 1) * TONE_OCTAVE_STEPS;
+
+        // Indexed by noteNum - TONE_NUMBER_BASE, C1 to B7
+        std::array<std::optional<Item>, TONE_COUNT> items;
+
+        inline const Item *find(int noteNum) const;
 
         std::string prefixedLyric(int noteNum, const std::string &lyric) const;
+        std::vector<std::string_view> prefixedLyrics(const std::vector<Note> &notes,
+                                                     std::string &arena) const;
     };
 
+    inline const PrefixMap::Item *PrefixMap::find(int noteNum) const {
+        int index = noteNum - TONE_NUMBER_BASE;
+        if (index < 0 || index >= TONE_COUNT || !items[index]) {
+            return nullptr;
+        }
+        return &*items[index];
+    }
+
 }
 
 #endif // PREFIXMAP_H
@@ -0,0 +1,145 @@
+#include "mappedfile_p.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <cerrno>
+#endif
+
+namespace Utau {
+
+    static inline std::error_code lastError() {
+#ifdef _WIN32
+        return std::error_code(static_cast<int>(::GetLastError()), std::system_category());
+#else
+        return std::error_code(errno, std::generic_category());
+#endif
+    }
+
+    /*!
+        \class MappedFile
+        \brief Read-only memory mapping of a whole file.
+
+        An empty file is mapped successfully with an empty data view.
+    */
+
+    MappedFile::MappedFile()
+        : m_data(nullptr), m_size(0), m_open(false)
+#ifdef _WIN32
+          ,
+          m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#endif
+    {
+    }
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    /*!
+        Maps the file read-only, returns \c true if success, otherwise error() returns the reason.
+    */
+    bool MappedFile::open(const std::filesystem::path &path) {
+        close();
+        m_error.clear();
+
+#ifdef _WIN32
+        HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            m_error = lastError();
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if (!::GetFileSizeEx(file, &size)) {
+            m_error = lastError();
+            ::CloseHandle(file);
+            return false;
+        }
+        m_file = file;
+        m_open = true;
+        if (size.QuadPart == 0) {
+            return true;
+        }
+
+        m_mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_mapping) {
+            m_error = lastError();
+            close();
+            return false;
+        }
+
+        auto ptr = ::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!ptr) {
+            m_error = lastError();
+            close();
+            return false;
+        }
+        m_data = static_cast<const char *>(ptr);
+        m_size = static_cast<std::size_t>(size.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            m_error = lastError();
+            return false;
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            m_error = lastError();
+            ::close(fd);
+            return false;
+        }
+        m_open = true;
+        if (st.st_size == 0) {
+            ::close(fd);
+            return true;
+        }
+
+        auto ptr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            m_error = lastError();
+        }
+        ::close(fd); // The mapping keeps its own reference
+        if (ptr == MAP_FAILED) {
+            m_open = false;
+            return false;
+        }
+        m_data = static_cast<const char *>(ptr);
+        m_size = static_cast<std::size_t>(st.st_size);
+#endif
+        return true;
+    }
+
+    /*!
+        Unmaps the file, all views into the data become dangling.
+    */
+    void MappedFile::close() {
+#ifdef _WIN32
+        if (m_data) {
+            ::UnmapViewOfFile(m_data);
+        }
+        if (m_mapping) {
+            ::CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+        if (m_file != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (m_data) {
+            ::munmap(const_cast<char *>(m_data), m_size);
+        }
+#endif
+        m_data = nullptr;
+        m_size = 0;
+        m_open = false;
+    }
+
+}
@@ -0,0 +1,50 @@
+#ifndef MAPPEDFILE_P_H
+#define MAPPEDFILE_P_H
+
+#include <string_view>
+#include <filesystem>
+#include <system_error>
+
+namespace Utau {
+
+    class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool open(const std::filesystem::path &path);
+        void close();
+
+        inline bool isOpen() const;
+        inline std::string_view data() const;
+        inline std::error_code error() const;
+
+    protected:
+        const char *m_data;
+        std::size_t m_size;
+        bool m_open;
+        std::error_code m_error;
+#ifdef _WIN32
+        void *m_file;
+        void *m_mapping;
+#endif
+    };
+
+    inline bool MappedFile::isOpen() const {
+        return m_open;
+    }
+
+    inline std::string_view MappedFile::data() const {
+        return {m_data, m_size};
+    }
+
+    inline std::error_code MappedFile::error() const {
+        return m_error;
+    }
+
+}
+
+#endif // MAPPEDFILE_P_H
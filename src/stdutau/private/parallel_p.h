@@ -0,0 +1,102 @@
+#ifndef PARALLEL_P_H
+#define PARALLEL_P_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "threadpool_p.h"
+
+namespace Utau {
+
+    // Returns the number of workers to use, non-positive values mean one per hardware thread
+    inline int resolveThreadCount(int threadCount) {
+        if (threadCount > 0) {
+            return threadCount;
+        }
+        return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    // Calls func(begin, end) over [0, count) in chunks of the given grain on up to threadCount
+    // workers, the calling thread is one of them and the others are taken from the global
+    // ThreadPool. The first exception thrown by a worker is rethrown after all workers are done.
+    template <class Func>
+    void parallelFor(int count, int threadCount, int grain, Func &&func) {
+        if (count <= 0) {
+            return;
+        }
+        grain = std::max(1, grain);
+
+        int workers = std::min(resolveThreadCount(threadCount), (count + grain - 1) / grain);
+        if (workers <= 1) {
+            func(0, count);
+            return;
+        }
+
+        std::atomic<int> next(0);
+        std::exception_ptr error;
+        std::mutex errorLock;
+
+        auto work = [&]() {
+            try {
+                int begin;
+                while ((begin = next.fetch_add(grain)) < count) {
+                    func(begin, std::min(count, begin + grain));
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = count; // Stop the other workers
+            }
+        };
+
+        // A task that starts after the caller is done returns at once, so the caller only waits
+        // for the running ones and a busy pool can't block it
+        struct Helpers {
+            std::mutex lock;
+            std::condition_variable idle;
+            int running = 0;
+            bool closed = false;
+        };
+        auto helpers = std::make_shared<Helpers>();
+        auto &pool = ThreadPool::global();
+        for (int i = 0; i < workers - 1; ++i) {
+            pool.post(
+                [helpers, &work]() {
+                    {
+                        std::lock_guard<std::mutex> guard(helpers->lock);
+                        if (helpers->closed) {
+                            return;
+                        }
+                        helpers->running++;
+                    }
+                    work();
+                    {
+                        std::lock_guard<std::mutex> guard(helpers->lock);
+                        helpers->running--;
+                    }
+                    helpers->idle.notify_all();
+                },
+                workers - 1);
+        }
+        work();
+        {
+            std::unique_lock<std::mutex> lock(helpers->lock);
+            helpers->closed = true;
+            helpers->idle.wait(lock, [&helpers]() { return helpers->running == 0; });
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+}
+
+#endif // PARALLEL_P_H
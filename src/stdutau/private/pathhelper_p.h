@@ -0,0 +1,32 @@
+#ifndef PATHHELPER_P_H
+#define PATHHELPER_P_H
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace Utau {
+
+    // UTF-8 form of a path, unlike string() it doesn't depend on the code page of the system
+    inline std::string pathToUtf8(const std::filesystem::path &path) {
+        auto s = path.u8string();
+        return std::string(s.begin(), s.end());
+    }
+
+    // UTF-8 form with '/' separators, for paths stored in files
+    inline std::string genericPathToUtf8(const std::filesystem::path &path) {
+        auto s = path.generic_u8string();
+        return std::string(s.begin(), s.end());
+    }
+
+    inline std::filesystem::path utf8ToPath(const std::string_view &s) {
+#if __cplusplus >= 202002L
+        return std::filesystem::path(std::u8string(s.begin(), s.end()));
+#else
+        return std::filesystem::u8path(s.begin(), s.end());
+#endif
+    }
+
+}
+
+#endif // PATHHELPER_P_H
@@ -0,0 +1,276 @@
+#include "pitchcurve_p.h"
+
+#include <cmath>
+
+namespace Utau {
+
+    // Same value as QSynthesis
+    static constexpr const double PI = 3.1415926;
+
+    PitchCurve::PitchCurve() : m_firstY(0), m_cursor(0) {
+    }
+
+    PitchCurve::PitchCurve(const std::vector<Point> &points, double positiveTempo,
+                           double negativeTempo) {
+        build(points, positiveTempo, negativeTempo);
+    }
+
+    void PitchCurve::build(const std::vector<Point> &points, double positiveTempo,
+                           double negativeTempo) {
+        m_x.resize(points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            double x = points[i].x;
+            m_x[i] = x * ((x < 0) ? negativeTempo : positiveTempo) / 60 * 480 / 1000;
+        }
+
+        m_segments.clear();
+        if (points.size() > 1) {
+            m_segments.reserve(points.size() - 1);
+        }
+        for (size_t i = 0; i + 1 < points.size(); ++i) {
+            Segment seg;
+            seg.x1 = m_x[i];
+            seg.y1 = points[i].y * 10;
+            seg.x2 = m_x[i + 1];
+            seg.y2 = points[i + 1].y * 10;
+            seg.type = points[i + 1].type;
+
+            // The expressions keep the order of the operations of the original shape functions
+            switch (seg.type) {
+                case Point::linearJoin:
+                    seg.a = (seg.y2 - seg.y1) / (seg.x2 - seg.x1);
+                    seg.c = 0;
+                    seg.w = 0;
+                    break;
+                case Point::jJoin:
+                    seg.a = seg.y1 - seg.y2;
+                    seg.c = 0;
+                    seg.w = PI / 2 / (seg.x2 - seg.x1);
+                    break;
+                case Point::rJoin:
+                    seg.a = seg.y2 - seg.y1;
+                    seg.c = 0;
+                    seg.w = PI / 2 / (seg.x2 - seg.x1);
+                    break;
+                default:
+                    seg.a = (seg.y1 - seg.y2) / 2;
+                    seg.c = (seg.y1 + seg.y2) / 2;
+                    seg.w = seg.x2 - seg.x1;
+                    break;
+            }
+            m_segments.push_back(seg);
+        }
+
+        m_firstY = points.empty() ? 0 : points[0].y * 10;
+        m_cursor = 0;
+    }
+
+    int PitchCurve::locate(int tick) {
+        // The cursor only moves forward if the points ascend, but the backward search of
+        // QSynthesis is kept for the points that don't
+        int &i = m_cursor;
+        int last = static_cast<int>(m_x.size()) - 1;
+        while (i < last) {
+            if (tick < m_x[i]) {
+                if (i > 0) {
+                    i--;
+                    continue;
+                }
+                return Before;
+            }
+            if (tick > m_x[i + 1]) {
+                i++;
+                continue;
+            }
+            return i;
+        }
+        return None;
+    }
+
+    void PitchCurve::rasterize(int segment, const int *ticks, int count, int *out) const {
+        const auto &seg = m_segments[segment];
+        if (seg.x1 == seg.x2) {
+            int value = int(seg.y1);
+            for (int s = 0; s < count; ++s) {
+                out[s] = value;
+            }
+            return;
+        }
+
+        switch (seg.type) {
+            case Point::linearJoin:
+                for (int s = 0; s < count; ++s) {
+                    out[s] = int(seg.a * (ticks[s] - seg.x1) + seg.y1);
+                }
+                break;
+            case Point::jJoin:
+                for (int s = 0; s < count; ++s) {
+                    out[s] = int(seg.a * std::cos(seg.w * (ticks[s] - seg.x1)) + seg.y2);
+                }
+                break;
+            case Point::rJoin:
+                for (int s = 0; s < count; ++s) {
+                    out[s] = int(seg.a * std::cos(seg.w * (ticks[s] - seg.x2)) + seg.y1);
+                }
+                break;
+            default:
+                // Dividing by the width instead of multiplying by its reciprocal keeps the result
+                // identical to QSynthesis
+                for (int s = 0; s < count; ++s) {
+                    out[s] = int(seg.a * std::cos(PI * (ticks[s] - seg.x1) / seg.w) + seg.c);
+                }
+                break;
+        }
+    }
+
+    int PitchCurve::addTo(const int *ticks, int count, bool stopAtLastPoint, int *out,
+                          std::vector<int> &buffer) {
+        if (stopAtLastPoint && m_x.size() < 2) {
+            return 0;
+        }
+        if (m_x.empty()) {
+            return count;
+        }
+
+        // Find the sample range of every segment, then rasterize the segments as a whole
+        buffer.resize(count);
+
+        int runBegin = 0;
+        int runState = None;
+        auto flush = [&](int runEnd) {
+            int runCount = runEnd - runBegin;
+            if (runCount <= 0 || runState == None) {
+                return;
+            }
+            if (runState == Before) {
+                int value = int(m_firstY);
+                for (int s = runBegin; s < runEnd; ++s) {
+                    out[s] += value;
+                }
+                return;
+            }
+            int *values = buffer.data() + runBegin;
+            rasterize(runState, ticks + runBegin, runCount, values);
+            for (int s = 0; s < runCount; ++s) {
+                out[runBegin + s] += values[s];
+            }
+        };
+
+        int last = static_cast<int>(m_x.size()) - 1;
+        for (int s = 0; s < count; ++s) {
+            if (stopAtLastPoint && m_cursor >= last) {
+                count = s;
+                break;
+            }
+            int state = locate(ticks[s]);
+            if (state != runState) {
+                flush(s);
+                runBegin = s;
+                runState = state;
+            }
+        }
+        flush(count);
+        return count;
+    }
+
+    VibratoOscillator::VibratoOscillator()
+        : m_null(true), m_amplitude(0), m_offset(0), m_k(0), m_p(0), m_start(0), m_length(0),
+          m_easeIn(0), m_easeOut(0), m_easeInK(0), m_easeOutK(0), m_run(0), m_lastTick(0),
+          m_step(0), m_sin(0), m_cos(1), m_stepSin(0), m_stepCos(1) {
+    }
+
+    VibratoOscillator::VibratoOscillator(const std::vector<double> &vibrato, int length,
+                                         double tempo)
+        : VibratoOscillator() {
+        build(vibrato, length, tempo);
+    }
+
+    void VibratoOscillator::build(const std::vector<double> &vibrato, int length, double tempo) {
+        reset();
+
+        m_null = vibrato.size() < 8 || length <= 0;
+        if (m_null) {
+            return;
+        }
+
+        double proportion = vibrato[0] / 100.0;
+        double period = vibrato[1];
+        double amplitude = vibrato[2];
+        double easeIn = vibrato[3];
+        double easeOut = vibrato[4];
+        double phase = vibrato[5];
+        double offset = vibrato[6];
+
+        double tick_time = period * tempo / 60 * 480 / 1000;
+        m_length = proportion * length;
+        m_start = (1 - proportion) * length; // ticks time relative to start
+
+        m_k = 1 / tick_time * 2 * PI; // Circular frequency
+        m_p = phase / 100.0 * 2 * PI; // Initial phase
+
+        m_easeIn = easeIn / 100.0 * m_length;         // Fade in time
+        m_easeOut = (1 - easeOut / 100.0) * m_length; // Fade out time
+        m_easeInK = 1 / m_easeIn;
+        m_easeOutK = 1 / (m_length - m_easeOut);
+
+        m_amplitude = amplitude;
+        m_offset = offset / 100.0 * amplitude;
+    }
+
+    int VibratoOscillator::sample(int tick) {
+        double x = tick - m_start; // tick x
+        if (m_null || !(x > 0 && x < m_length)) {
+            return 0;
+        }
+
+        int step = tick - m_lastTick;
+        if (m_run > 0 && m_run < RESEED_INTERVAL && step == m_step) {
+            // Rotate the phase by one step
+            double s = m_sin * m_stepCos + m_cos * m_stepSin;
+            double c = m_cos * m_stepCos - m_sin * m_stepSin;
+            m_sin = s;
+            m_cos = c;
+            m_run++;
+        } else {
+            if (m_run > 0 && step != m_step) {
+                m_step = step;
+                m_stepSin = std::sin(m_k * step);
+                m_stepCos = std::cos(m_k * step);
+            }
+            double theta = m_k * x - m_p;
+            m_sin = std::sin(theta);
+            m_cos = std::cos(theta);
+            m_run = 1;
+        }
+        m_lastTick = tick;
+
+        double y = m_amplitude * m_sin + m_offset;
+        double ratio = 1;
+        if (x < m_easeIn) {
+            ratio *= x * m_easeInK;
+        }
+        if (x > m_easeOut) {
+            ratio *= 1 - (x - m_easeOut) * m_easeOutK;
+        }
+        return int(ratio * y);
+    }
+
+    void VibratoOscillator::addTo(const int *ticks, int count, int *out) {
+        if (m_null) {
+            return;
+        }
+
+        // The ticks ascend, so the vibrato covers a continuous range of samples
+        for (int s = 0; s < count; ++s) {
+            double x = ticks[s] - m_start;
+            if (x <= 0) {
+                continue;
+            }
+            if (!(x < m_length)) {
+                break;
+            }
+            out[s] += sample(ticks[s]);
+        }
+    }
+
+}
@@ -0,0 +1,134 @@
+#ifndef PITCHCURVE_P_H
+#define PITCHCURVE_P_H
+
+#include <vector>
+
+#include "note.h"
+
+namespace Utau {
+
+    // Mode2 pitch curve of a note in tick space, the segments are built once with their shape
+    // coefficients and a cursor follows the ascending ticks that are rasterized
+    class PitchCurve {
+    public:
+        PitchCurve();
+        PitchCurve(const std::vector<Point> &points, double positiveTempo, double negativeTempo);
+
+        // Ticks of the points are scaled with positiveTempo or negativeTempo by the sign of x
+        void build(const std::vector<Point> &points, double positiveTempo, double negativeTempo);
+
+        inline int pointCount() const;
+        inline bool empty() const;
+
+        // Special values returned by locate()
+        enum Location {
+            Before = -2, // Before the first point, the pitch is the first point
+            None = -1,   // After the last point, no pitch
+        };
+
+        inline int cursor() const;
+        inline void reset();
+
+        // Moves the cursor to the segment that contains the tick
+        int locate(int tick);
+
+        // Writes the pitch of the segment at the ticks
+        void rasterize(int segment, const int *ticks, int count, int *out) const;
+
+        // Adds the pitch at the ascending ticks to out, returns the number of samples covered.
+        // With stopAtLastPoint the samples from the one that starts on the last point are skipped,
+        // which is how the next note's curve is applied.
+        int addTo(const int *ticks, int count, bool stopAtLastPoint, int *out,
+                  std::vector<int> &buffer);
+
+    protected:
+        struct Segment {
+            double x1, y1;
+            double x2, y2;
+            Point::Type type;
+            double a; // Slope of the linear join, amplitude of the others
+            double c; // Center of the s join
+            double w; // Angular coefficient of the r and j joins, width of the s join
+        };
+
+        std::vector<double> m_x; // Tick of every point
+        std::vector<Segment> m_segments;
+        double m_firstY;
+        int m_cursor;
+    };
+
+    inline int PitchCurve::pointCount() const {
+        return static_cast<int>(m_x.size());
+    }
+
+    inline bool PitchCurve::empty() const {
+        return m_x.empty();
+    }
+
+    inline int PitchCurve::cursor() const {
+        return m_cursor;
+    }
+
+    inline void PitchCurve::reset() {
+        m_cursor = 0;
+    }
+
+    // Vibrato of a note, the constants are computed once and the phase of ascending ticks with a
+    // constant step advances by rotation instead of calling sin()
+    class VibratoOscillator {
+    public:
+        VibratoOscillator();
+        VibratoOscillator(const std::vector<double> &vibrato, int length, double tempo);
+
+        // The vibrato is the 8 Mode2 values, tempo converts the period to ticks
+        void build(const std::vector<double> &vibrato, int length, double tempo);
+
+        inline bool isNull() const;
+
+        // Restarts the recurrence, required before the ticks go backward
+        inline void reset();
+
+        // Returns the pitch offset at the tick, the ticks must ascend since the last reset
+        int sample(int tick);
+
+        // Adds the pitch offset at the ascending ticks to out
+        void addTo(const int *ticks, int count, int *out);
+
+        // The rotation is restarted from sin() after this many steps, the sine stays within 1e-12
+        // of sin(), which is far below the integer rounding of the pitch
+        static constexpr const int RESEED_INTERVAL = 64;
+
+    protected:
+        bool m_null;
+
+        double m_amplitude;
+        double m_offset;    // Offset multiplied by the amplitude
+        double m_k;         // Circular frequency per tick
+        double m_p;         // Initial phase
+        double m_start;     // First tick
+        double m_length;    // Length in ticks
+        double m_easeIn;    // End of the fade in
+        double m_easeOut;   // Start of the fade out
+        double m_easeInK;   // Reciprocal of the fade in length
+        double m_easeOutK;  // Reciprocal of the fade out length
+
+        // Recurrence state
+        int m_run; // Samples since the last reseed, 0 if there's no previous sample
+        int m_lastTick;
+        int m_step;
+        double m_sin, m_cos;
+        double m_stepSin, m_stepCos;
+    };
+
+    inline bool VibratoOscillator::isNull() const {
+        return m_null;
+    }
+
+    inline void VibratoOscillator::reset() {
+        m_run = 0;
+        m_step = 0;
+    }
+
+}
+
+#endif // PITCHCURVE_P_H
@@ -0,0 +1,18 @@
+#ifndef SHAREDHELPER_P_H
+#define SHAREDHELPER_P_H
+
+#include <memory>
+
+namespace Utau {
+
+    template <class T>
+    inline void detach_shared_ptr(std::shared_ptr<T> &d) {
+        if (d.use_count() == 1)
+            return;
+        auto x = std::make_shared<T>(*d);
+        d = x;
+    }
+
+}
+
+#endif // SHAREDHELPER_P_H
@@ -0,0 +1,35 @@
+#ifndef SYNTH_P_H
+#define SYNTH_P_H
+
+#include <string>
+
+#include "synth.h"
+
+namespace Utau {
+
+    // Everything the arguments of one note depend on, the optional neighbours are null when
+    // they're out of the range limits
+    struct SynthNoteInput {
+        int index = 0;
+
+        const Note *note = nullptr;
+        const Note *prev = nullptr;     // Previous note, for the pitch curve
+        const Note *prevPrev = nullptr; // Note before the previous one, for the pitch curve
+        const Note *next = nullptr;     // Next note
+
+        const GenonSettings *genon = nullptr;
+        const GenonSettings *nextGenon = nullptr; // Required if next is set
+
+        double tempo = DEFAULT_VALUE_TEMPO; // Effective tempo of the note
+        double prevDuration = 0;            // Duration of the previous note, 0 if there's none
+        bool prevIsRest = false;
+    };
+
+    void calcSynthNote(const SynthNoteInput &input, const std::string &globalFlags,
+                       ResamplerArguments &res, WavtoolArguments &wav);
+
+    std::string synthCacheName(int index, const Note &note);
+
+}
+
+#endif // SYNTH_P_H
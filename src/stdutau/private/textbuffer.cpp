@@ -0,0 +1,43 @@
+#include "textbuffer_p.h"
+
+#include "utautils.h"
+
+namespace Utau {
+
+    TextBuffer::TextBuffer() : m_size(0), m_capacity(0) {
+        reserve(256);
+    }
+
+    void TextBuffer::reserve(std::size_t capacity) {
+        if (capacity <= m_capacity) {
+            return;
+        }
+        std::unique_ptr<char[]> data(new char[capacity]);
+        if (m_size > 0) {
+            std::memcpy(data.get(), m_data.get(), m_size);
+        }
+        m_data = std::move(data);
+        m_capacity = capacity;
+    }
+
+    TextBuffer &TextBuffer::appendInt(int num) {
+        char *first = prepare(NUMBER_BUFFER_SIZE);
+        m_size += to_chars2(first, first + NUMBER_BUFFER_SIZE, num) - first;
+        return *this;
+    }
+
+    TextBuffer &TextBuffer::appendDouble(double num) {
+        char *first = prepare(NUMBER_BUFFER_SIZE);
+        m_size += to_chars2(first, first + NUMBER_BUFFER_SIZE, num) - first;
+        return *this;
+    }
+
+    bool TextBuffer::flush(std::ostream &os) {
+        if (m_size > 0) {
+            os.write(m_data.get(), static_cast<std::streamsize>(m_size));
+            m_size = 0;
+        }
+        return os.good();
+    }
+
+}
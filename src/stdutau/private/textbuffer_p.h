@@ -0,0 +1,106 @@
+#ifndef TEXTBUFFER_P_H
+#define TEXTBUFFER_P_H
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <iostream>
+#include <string_view>
+
+namespace Utau {
+
+    // Growable char buffer that formats numbers in place, the numbers are written in the same way
+    // as the default formatting of std::ostream
+    class TextBuffer {
+    public:
+        TextBuffer();
+
+        TextBuffer(const TextBuffer &) = delete;
+        TextBuffer &operator=(const TextBuffer &) = delete;
+
+        inline const char *data() const;
+        inline std::size_t size() const;
+        inline bool empty() const;
+        inline std::string_view view() const;
+
+        inline void clear();
+        inline void truncate(std::size_t size);
+        void reserve(std::size_t capacity);
+
+        inline TextBuffer &append(char ch);
+        inline TextBuffer &append(const std::string_view &s);
+        TextBuffer &appendInt(int num);
+        TextBuffer &appendDouble(double num);
+
+        // Writes the contents to the stream and clears the buffer
+        bool flush(std::ostream &os);
+        // Flushes only if the buffer exceeds the block size
+        inline bool flushBlock(std::ostream &os);
+
+        static constexpr const std::size_t BLOCK_SIZE = 64 * 1024;
+
+    protected:
+        std::unique_ptr<char[]> m_data;
+        std::size_t m_size;
+        std::size_t m_capacity;
+
+        inline char *prepare(std::size_t count);
+    };
+
+    inline const char *TextBuffer::data() const {
+        return m_data.get();
+    }
+
+    inline std::size_t TextBuffer::size() const {
+        return m_size;
+    }
+
+    inline bool TextBuffer::empty() const {
+        return m_size == 0;
+    }
+
+    inline std::string_view TextBuffer::view() const {
+        return {m_data.get(), m_size};
+    }
+
+    inline void TextBuffer::clear() {
+        m_size = 0;
+    }
+
+    inline void TextBuffer::truncate(std::size_t size) {
+        if (size < m_size) {
+            m_size = size;
+        }
+    }
+
+    inline TextBuffer &TextBuffer::append(char ch) {
+        *prepare(1) = ch;
+        m_size++;
+        return *this;
+    }
+
+    inline TextBuffer &TextBuffer::append(const std::string_view &s) {
+        if (!s.empty()) {
+            std::memcpy(prepare(s.size()), s.data(), s.size());
+            m_size += s.size();
+        }
+        return *this;
+    }
+
+    inline bool TextBuffer::flushBlock(std::ostream &os) {
+        if (m_size < BLOCK_SIZE) {
+            return os.good();
+        }
+        return flush(os);
+    }
+
+    inline char *TextBuffer::prepare(std::size_t count) {
+        if (m_size + count > m_capacity) {
+            reserve(std::max(m_capacity * 2, m_size + count));
+        }
+        return m_data.get() + m_size;
+    }
+
+}
+
+#endif // TEXTBUFFER_P_H
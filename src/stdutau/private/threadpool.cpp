@@ -0,0 +1,54 @@
+#include "threadpool_p.h"
+
+namespace Utau {
+
+    /*!
+        \class ThreadPool
+        \brief Persistent workers of the parallel loops.
+
+        The workers are started on demand and then wait for the next task, so that the jobs
+        that load or calculate many files in a row don't start new threads on every call.
+    */
+
+    ThreadPool::ThreadPool() = default;
+
+    /*!
+        Returns the pool shared by the whole library.
+
+        The pool is never destroyed, since the workers may already be terminated when the
+        statics are destroyed at exit on some platforms.
+    */
+    ThreadPool &ThreadPool::global() {
+        static auto pool = new ThreadPool();
+        return *pool;
+    }
+
+    /*!
+        Queues \a task, starting workers until there are at least \a threadCount of them.
+    */
+    void ThreadPool::post(std::function<void()> task, int threadCount) {
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_tasks.push_back(std::move(task));
+            while (static_cast<int>(m_threads.size()) < threadCount) {
+                m_threads.emplace_back(&ThreadPool::work, this);
+                m_threads.back().detach();
+            }
+        }
+        m_wake.notify_one();
+    }
+
+    void ThreadPool::work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_lock);
+                m_wake.wait(lock, [this]() { return !m_tasks.empty(); });
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+}
@@ -0,0 +1,35 @@
+#ifndef THREADPOOL_P_H
+#define THREADPOOL_P_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Utau {
+
+    class ThreadPool {
+    public:
+        ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        static ThreadPool &global();
+
+        void post(std::function<void()> task, int threadCount);
+
+    protected:
+        std::mutex m_lock;
+        std::condition_variable m_wake;
+        std::deque<std::function<void()>> m_tasks;
+        std::vector<std::thread> m_threads;
+
+        void work();
+    };
+
+}
+
+#endif // THREADPOOL_P_H
@@ -1,6 +1,10 @@
 #include "usthelper_p.h"
 
+#include <algorithm>
+#include <charconv>
+
 #include "utautils.h"
+#include "ustkeys_p.h"
 
 namespace Utau {
 
@@ -30,11 +34,11 @@ namespace Utau {
         return false;
     }
 
-    void parseSectionNote(const std::vector<std::string> &sectionList, Note &note) {
-        PBStrings mode2;
+    static void parseNoteLines(const SectionView &sectionList, Note &note, NoteExt *ext,
+                               const UnknownKeyHandler &handler, NoteRawFields *rawOut) {
+        NoteRawFields raw;
 
-        for (const auto &item : sectionList) {
-            std::string_view line = item;
+        for (const auto &line : sectionList) {
             auto eq = line.find('=');
             if (eq == std::string_view::npos) {
                 continue;
@@ -42,86 +46,209 @@ namespace Utau {
 
             auto key = line.substr(0, eq);
             auto value = line.substr(eq + 1);
-            if (key == KEY_NAME_LYRIC) {
-                note.lyric = value;                // Lyric
-            } else if (key == KEY_NAME_NOTE_NUM) {
-                getInt(value, note.noteNum);       // Note Num
-            } else if (key == KEY_NAME_LENGTH) {
-                getInt(value, note.length);        // Length
-            } else if (key == KEY_NAME_FLAGS) {
-                note.flags = value;                // Flags
-            } else if (key == KEY_NAME_INTENSITY) {
-                getDouble(value, note.intensity);  // Intensity
-            } else if (key == KEY_NAME_MODULATION || key == KEY_NAME_MODURATION) {
-                getDouble(value, note.modulation); // Modulation
-            } else if (key == KEY_NAME_PRE_UTTERANCE) {
-                getDouble(value, note.preUttr);    // PreUtterance
-            } else if (key == KEY_NAME_VOICE_OVERLAP) {
-                getDouble(value, note.overlap);    // Overlap
-            } else if (key == KEY_NAME_VELOCITY) {
-                getDouble(value, note.velocity);   // Consonant Velocity
-            } else if (key == KEY_NAME_START_POINT) {
-                getDouble(value, note.stp);        // StartPoint
-            } else if (key == KEY_NAME_TEMPO) {
-                getDouble(value, note.tempo);      // Tempo
-            } else if (key == KEY_NAME_REGION_START) {
-                note.region = value;               // Start of region
-            } else if (key == KEY_NAME_REGION_END) {
-                note.regionEnd = value;            // End of region
-            } else if (key == KEY_NAME_PB_START) {
-                getDouble(value, note.pbstart);    // Mode1 Start
-            } else if (key == KEY_NAME_PBS) {
-                mode2.PBS = value;                 // Mode2 Start
-            } else if (key == KEY_NAME_PBW) {
-                mode2.PBW = value;                 // Mode2 Intervals
-            } else if (key == KEY_NAME_PBY) {
-                mode2.PBY = value;                 // Mode2 Offsets
-            } else if (key == KEY_NAME_PBM) {
-                mode2.PBM = value;                 // Mode2 Types
-            } else if (key == KEY_NAME_PICHES || key == KEY_NAME_PITCHES ||
-                       key == KEY_NAME_PITCH_BEND) {
-                note.pitches = stringsToDoubles(split(value, ","));       // Mode1 Pitch
-            } else if (key == KEY_NAME_VBR) {
-                note.vibrato = Vibrato::fromString(std::string(value));   // Vibrato
-            } else if (key == KEY_NAME_ENVELOPE) {
-                note.envelope = Envelope::fromString(std::string(value)); // Envelope
+            auto noteKey = noteKeyOf(key);
+            if (!ext && noteKey >= NoteKey::PreUtteranceRO) {
+                noteKey = NoteKey::Unknown; // Readonly keys exist only in plugin files
+            }
+
+            switch (noteKey) {
+                case NoteKey::Lyric:
+                    note.lyric = value;                                 // Lyric
+                    break;
+                case NoteKey::NoteNum:
+                    getInt(value, note.noteNum);                        // Note Num
+                    break;
+                case NoteKey::Length:
+                    getInt(value, note.length);                         // Length
+                    break;
+                case NoteKey::Flags:
+                    note.flags = value;                                 // Flags
+                    break;
+                case NoteKey::Intensity:
+                    getDouble(value, note.intensity);                   // Intensity
+                    break;
+                case NoteKey::Modulation:
+                    getDouble(value, note.modulation);                  // Modulation
+                    break;
+                case NoteKey::PreUtterance:
+                    getDouble(value, note.preUttr);                     // PreUtterance
+                    break;
+                case NoteKey::VoiceOverlap:
+                    getDouble(value, note.overlap);                     // Overlap
+                    break;
+                case NoteKey::Velocity:
+                    getDouble(value, note.velocity);                    // Consonant Velocity
+                    break;
+                case NoteKey::StartPoint:
+                    getDouble(value, note.stp);                         // StartPoint
+                    break;
+                case NoteKey::Tempo:
+                    getDouble(value, note.tempo);                       // Tempo
+                    break;
+                case NoteKey::RegionStart:
+                    note.region = value;                                // Start of region
+                    break;
+                case NoteKey::RegionEnd:
+                    note.regionEnd = value;                             // End of region
+                    break;
+                case NoteKey::PBStart:
+                    getDouble(value, note.pbstart);                     // Mode1 Start
+                    break;
+                case NoteKey::PBS:
+                    raw.PBS = value;                                    // Mode2 Start
+                    break;
+                case NoteKey::PBW:
+                    raw.PBW = value;                                    // Mode2 Intervals
+                    break;
+                case NoteKey::PBY:
+                    raw.PBY = value;                                    // Mode2 Offsets
+                    break;
+                case NoteKey::PBM:
+                    raw.PBM = value;                                    // Mode2 Types
+                    break;
+                case NoteKey::Pitches:
+                    raw.pitches = value;                                // Mode1 Pitch
+                    break;
+                case NoteKey::VBR:
+                    raw.vibrato = value;                                // Vibrato
+                    break;
+                case NoteKey::Envelope:
+                    raw.envelope = value;                               // Envelope
+                    break;
+                case NoteKey::PreUtteranceRO:
+                    getDouble(value, ext->preUttrRO);                   // @preuttr
+                    break;
+                case NoteKey::VoiceOverlapRO:
+                    getDouble(value, ext->overlapRO);                   // @overlap
+                    break;
+                case NoteKey::StartPointRO:
+                    getDouble(value, ext->stpRO);                       // @stpoint
+                    break;
+                case NoteKey::FileNameRO:
+                    ext->filenameRO = value;                            // @filename
+                    break;
+                case NoteKey::AliasRO:
+                    ext->aliasRO = value;                               // @alias
+                    break;
+                case NoteKey::CacheRO:
+                    ext->cacheRO = value;                               // @cache
+                    break;
+                default:
+                    if (handler) {
+                        handler(note, key, value);
+                    }
+                    break;
             }
         }
-        note.portamento = mode2.toPoints(); // Mode2 Pitch
+
+        if (rawOut) {
+            *rawOut = raw;
+        } else {
+            decodeNoteRawFields(raw, note);
+        }
     }
 
-    void parseSectionNoteExt(const std::vector<std::string> &sectionList, NoteExt &note) {
-        parseSectionNote(sectionList, note);
+    void parseSectionNote(const SectionView &sectionList, Note &note,
+                          const UnknownKeyHandler &handler) {
+        parseNoteLines(sectionList, note, nullptr, handler, nullptr);
+    }
 
-        for (const auto &item : sectionList) {
-            std::string_view line = item;
-            auto eq = line.find('=');
-            if (eq == std::string_view::npos) {
-                continue;
+    void parseSectionNoteExt(const SectionView &sectionList, NoteExt &note,
+                             const UnknownKeyHandler &handler) {
+        parseNoteLines(sectionList, note, &note, handler, nullptr);
+    }
+
+    void parseSectionNoteRaw(const SectionView &sectionList, Note &note, NoteRawFields &raw,
+                             const UnknownKeyHandler &handler) {
+        parseNoteLines(sectionList, note, nullptr, handler, &raw);
+    }
+
+    void decodeNoteRawFields(const NoteRawFields &raw, Note &note) {
+        if (raw.pitches.data()) {
+            doublesFromString(raw.pitches, note.pitches);       // Mode1 Pitch
+        }
+        if (raw.vibrato.data()) {
+            note.vibrato = Vibrato::fromString(raw.vibrato);    // Vibrato
+        }
+        if (raw.envelope.data()) {
+            note.envelope = Envelope::fromString(raw.envelope); // Envelope
+        }
+        pointsFromPBStrings(raw.PBS, raw.PBW, raw.PBY, raw.PBM, note.portamento); // Mode2 Pitch
+    }
+
+    void pointsFromPBStrings(const std::string_view &PBS, const std::string_view &PBW,
+                             const std::string_view &PBY, const std::string_view &PBM,
+                             std::vector<Point> &res) {
+        res.clear();
+        if (PBS.empty() || PBW.empty()) {
+            return;
+        }
+
+        Point p;
+        TokenReader PBSXY(PBS, SIMICOLON);
+        std::string_view token;
+        if (PBSXY.next(token)) {
+            p.x = stod2(token, p.x);
+            if (PBSXY.next(token)) {
+                p.y = stod2(token, p.y);
+            }
+        }
+        res.push_back(p);
+
+        TokenReader PBWs(PBW, COMMA);
+        TokenReader PBYs(PBY, COMMA);
+        TokenReader PBMs(PBM, COMMA);
+
+        auto count = std::max(PBWs.count(), PBYs.count());
+        res.reserve(count + 1);
+        for (std::size_t i = 0; i < count; i++) {
+            p = {};
+            if (PBWs.next(token)) {
+                p.x = stod2(token, p.x);
             }
+            if (PBYs.next(token)) {
+                if (!token.empty())
+                    p.y = stod2(token, p.y);
+            }
+            if (PBMs.next(token)) {
+                p.type = Point::stringToType(token);
+            }
+            p.x += res.back().x;
+            res.push_back(p);
+        }
 
-            auto key = line.substr(0, eq);
-            auto value = line.substr(eq + 1);
+        // Fix Negative Correction
+        for (int i = 1; i < res.size(); ++i) {
+            auto &curPoint = res[i];
+            auto &prevPoint = res[i - 1];
 
-            if (key == KEY_NAME_PRE_UTTERANCE_READONLY) {
-                getDouble(value, note.preUttrRO); // PreUtterance
-            } else if (key == KEY_NAME_VOICE_OVERLAP_READONLY) {
-                getDouble(value, note.overlapRO); // Overlap
-            } else if (key == KEY_NAME_START_POINT_READONLY) {
-                getDouble(value, note.stpRO);     // StartPoint
-            } else if (key == KEY_NAME_FILENAME_READONLY) {
-                note.filenameRO = value;          // @filename
-            } else if (key == KEY_NAME_ALIAS_READONLY) {
-                note.aliasRO = value;             // @readonly
-            } else if (key == KEY_NAME_CACHE_READONLY) {
-                note.cacheRO = value;             // @cache
+            if (curPoint.x < prevPoint.x) {
+                curPoint.x = prevPoint.x;
             }
         }
     }
 
-    void parseSectionVersion(const std::vector<std::string> &sectionList, UstVersion &out) {
-        for (const auto &item : sectionList) {
-            std::string_view line = item;
+    std::vector<Point> pointsFromPBStrings(const std::string_view &PBS, const std::string_view &PBW,
+                                           const std::string_view &PBY,
+                                           const std::string_view &PBM) {
+        std::vector<Point> res;
+        pointsFromPBStrings(PBS, PBW, PBY, PBM, res);
+        return res;
+    }
+
+    void doublesFromString(const std::string_view &s, std::vector<double> &res) {
+        res.clear();
+        res.reserve(TokenReader(s, COMMA).count());
+
+        TokenReader tokens(s, COMMA);
+        std::string_view token;
+        while (tokens.next(token)) {
+            res.push_back(stod2(token));
+        }
+    }
+
+    void parseSectionVersion(const SectionView &sectionList, UstVersion &out) {
+        for (const auto &line : sectionList) {
             auto eq = line.find('=');
             if (eq != std::string_view::npos) {
                 auto key = line.substr(0, eq);
@@ -138,9 +265,8 @@ namespace Utau {
         }
     }
 
-    void parseSectionSettings(const std::vector<std::string> &sectionList, UstSettings &out) {
-        for (const auto &item : sectionList) {
-            std::string_view line = item;
+    void parseSectionSettings(const SectionView &sectionList, UstSettings &out) {
+        for (const auto &line : sectionList) {
             auto eq = line.find('=');
             if (eq == std::string::npos) {
                 continue;
@@ -173,123 +299,299 @@ namespace Utau {
         }
     }
 
-    void writeSectionName(const std::string &name, std::ostream &out) {
-        out << SECTION_BEGIN_MARK + name + SECTION_END_MARK << std::endl;
+    template <class String>
+    static bool readStreamDataImpl(std::istream &is, String &data) {
+        char buf[65536];
+        while (is.read(buf, sizeof(buf)) || is.gcount() > 0) {
+            data.append(buf, is.gcount());
+        }
+        return !is.bad();
+    }
+
+    bool readStreamData(std::istream &is, std::string &data) {
+        return readStreamDataImpl(is, data);
     }
 
-    void writeSectionName(int name, std::ostream &out) {
-        auto newName = to_string(name);
-        auto nums = newName.size();
-        if (nums < 4) {
-            newName = std::string(4 - nums, '0') + newName;
+    bool readStreamData(std::istream &is, std::pmr::string &data) {
+        return readStreamDataImpl(is, data);
+    }
+
+    static inline void writeKey(const char *key, TextBuffer &out) {
+        out.append(key).append(EQUAL);
+    }
+
+    static void writeEnvelope(const Envelope &env, TextBuffer &out) {
+        // Same as Envelope::toString()
+        int offset = (env.count() == 5);
+        double nums[10] = {
+            env.anchors[0].x,          env.anchors[1].x,          env.anchors[2 + offset].x,
+            env.anchors[0].y,          env.anchors[1].y,          env.anchors[2 + offset].y,
+            env.anchors[3 + offset].y, env.anchors[3 + offset].x,
+        };
+        int count = 8;
+        if (env.count() == 5) {
+            nums[count++] = env.anchors[2].x;
+            nums[count++] = env.anchors[2].y;
+        }
+        if (count == 8 && nums[7] == 0.0) {
+            count--;
+        }
+        for (int i = 0; i < count; ++i) {
+            if (i > 0) {
+                out.append(COMMA);
+            }
+            if (i == 7) {
+                out.append('%').append(COMMA);
+            }
+            out.appendDouble(nums[i]);
+        }
+    }
+
+    static void writeVibrato(const Vibrato &vbr, TextBuffer &out) {
+        // Same as Vibrato::toString()
+        out.appendDouble(vbr.length).append(COMMA);
+        out.appendDouble(vbr.period).append(COMMA);
+        out.appendDouble(vbr.amplitude).append(COMMA);
+        out.appendDouble(vbr.attack).append(COMMA);
+        out.appendDouble(vbr.release).append(COMMA);
+        out.appendDouble(vbr.phase).append(COMMA);
+        out.appendDouble(vbr.offset).append(COMMA);
+        out.appendDouble(vbr.intensity);
+    }
+
+    static void writePitches(const std::vector<double> &pitches, TextBuffer &out) {
+        // Same as join(doublesToStrings(pitches), ","), zeros are omitted
+        auto count = pitches.size();
+        while (count > 0 && pitches[count - 1] == 0) {
+            count--;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            if (i > 0) {
+                out.append(COMMA);
+            }
+            if (pitches[i] != 0) {
+                out.appendDouble(pitches[i]);
+            }
         }
-        writeSectionName(newName, out);
     }
 
-    void writeSectionNote(int num, const Note &note, std::ostream &out) {
+    static void writePitches(const PitchArray &pitches, TextBuffer &out) {
+        // Same as writePitches() of the doubles
+        auto count = pitches.size();
+        while (count > 0 && pitches[count - 1] == 0) {
+            count--;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            if (i > 0) {
+                out.append(COMMA);
+            }
+            if (pitches[i] != 0) {
+                out.appendInt(pitches[i]);
+            }
+        }
+    }
+
+    static void writePortamento(const std::vector<Point> &points, TextBuffer &out) {
+        // Same as PBStrings::fromPoints(), empty PBY and PBM are omitted
+        const Point &first = points.front();
+        writeKey(KEY_NAME_PBS, out);
+        out.appendDouble(first.x).append(SIMICOLON).appendDouble(first.y).append('\n');
+
+        writeKey(KEY_NAME_PBW, out);
+        for (std::size_t i = 1; i < points.size(); i++) {
+            if (i > 1) {
+                out.append(COMMA);
+            }
+            out.appendDouble(points[i].x - points[i - 1].x);
+        }
+        out.append('\n');
+
+        if (points.size() > 1) {
+            writeKey(KEY_NAME_PBY, out);
+            for (std::size_t i = 1; i < points.size(); i++) {
+                if (i > 1) {
+                    out.append(COMMA);
+                }
+                out.appendDouble(points[i].y);
+            }
+            out.append('\n');
+        }
+
+        auto mark = out.size();
+        writeKey(KEY_NAME_PBM, out);
+        auto valueStart = out.size();
+        for (std::size_t i = 1; i < points.size(); i++) {
+            if (i > 1) {
+                out.append(COMMA);
+            }
+            switch (points[i].type) {
+                case Point::linearJoin:
+                    out.append('s');
+                    break;
+                case Point::rJoin:
+                    out.append('r');
+                    break;
+                case Point::jJoin:
+                    out.append('j');
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (out.size() == valueStart) {
+            out.truncate(mark);
+        } else {
+            out.append('\n');
+        }
+    }
+
+    void writeSectionName(const std::string_view &name, TextBuffer &out) {
+        out.append(SECTION_BEGIN_MARK).append(name).append(SECTION_END_MARK).append('\n');
+    }
+
+    void writeSectionName(int name, TextBuffer &out) {
+        char buf[16];
+        auto res = std::to_chars(buf, buf + sizeof(buf), name);
+        auto nums = res.ptr - buf;
+
+        out.append(SECTION_BEGIN_MARK);
+        for (auto i = nums; i < 4; ++i) {
+            out.append('0');
+        }
+        out.append({buf, std::size_t(nums)}).append(SECTION_END_MARK).append('\n');
+    }
+
+    void writeSectionNote(int num, const Note &note, TextBuffer &out,
+                          const PitchArray *pitches) {
         if (num >= 0) {
             writeSectionName(num, out);
         }
 
         // Items always exists
-        out << KEY_NAME_LENGTH << "=" << note.length << std::endl;
-        out << KEY_NAME_LYRIC << "=" << note.lyric << std::endl;
-        out << KEY_NAME_NOTE_NUM << "=" << note.noteNum << std::endl;
+        writeKey(KEY_NAME_LENGTH, out);
+        out.appendInt(note.length).append('\n');
+        writeKey(KEY_NAME_LYRIC, out);
+        out.append(note.lyric).append('\n');
+        writeKey(KEY_NAME_NOTE_NUM, out);
+        out.appendInt(note.noteNum).append('\n');
 
         // Items can be omitted
+        writeKey(KEY_NAME_PRE_UTTERANCE, out);
         if (note.preUttr != NODEF_DOUBLE) {
-            out << KEY_NAME_PRE_UTTERANCE << "=" << note.preUttr << std::endl;
-        } else {
-            // UST files always keep this property even if empty
-            out << KEY_NAME_PRE_UTTERANCE << "=" << std::endl;
+            out.appendDouble(note.preUttr);
         }
+        out.append('\n'); // UST files always keep this property even if empty
+
         if (note.overlap != NODEF_DOUBLE) {
-            out << KEY_NAME_VOICE_OVERLAP << "=" << note.overlap << std::endl;
+            writeKey(KEY_NAME_VOICE_OVERLAP, out);
+            out.appendDouble(note.overlap).append('\n');
         }
         if (note.velocity != NODEF_DOUBLE) {
-            out << KEY_NAME_VELOCITY << "=" << to_string(note.velocity) << std::endl;
+            writeKey(KEY_NAME_VELOCITY, out);
+            out.appendDouble(note.velocity).append('\n');
         }
         if (note.intensity != NODEF_DOUBLE) {
-            out << KEY_NAME_INTENSITY << "=" << note.intensity << std::endl;
+            writeKey(KEY_NAME_INTENSITY, out);
+            out.appendDouble(note.intensity).append('\n');
         }
         if (note.modulation != NODEF_DOUBLE) {
-            out << KEY_NAME_MODULATION << "=" << note.modulation << std::endl;
+            writeKey(KEY_NAME_MODULATION, out);
+            out.appendDouble(note.modulation).append('\n');
         }
         if (note.stp != NODEF_DOUBLE) {
-            out << KEY_NAME_START_POINT << "=" << note.stp << std::endl;
+            writeKey(KEY_NAME_START_POINT, out);
+            out.appendDouble(note.stp).append('\n');
         }
         if (!note.flags.empty()) {
-            out << KEY_NAME_FLAGS << "=" << note.flags << std::endl;
+            writeKey(KEY_NAME_FLAGS, out);
+            out.append(note.flags).append('\n');
         }
 
         // Items may not exist
-        if (!note.pitches.empty()) {
-            out << KEY_NAME_PB_TYPE << "=5" << std::endl;
-            out << KEY_NAME_PB_START << "=" << note.pbstart << std::endl;
-            out << KEY_NAME_PITCH_BEND << "=" << join(doublesToStrings(note.pitches), ",")
-                << std::endl;
+        bool compact = pitches && !pitches->empty();
+        if (compact || !note.pitches.empty()) {
+            writeKey(KEY_NAME_PB_TYPE, out);
+            out.append(VALUE_PITCH_TYPE).append('\n');
+            writeKey(KEY_NAME_PB_START, out);
+            out.appendDouble(note.pbstart).append('\n');
+            writeKey(KEY_NAME_PITCH_BEND, out);
+            if (compact) {
+                writePitches(*pitches, out);
+            } else {
+                writePitches(note.pitches, out);
+            }
+            out.append('\n');
         }
 
         if (note.envelope) {
-            out << KEY_NAME_ENVELOPE << "=" << note.envelope->toString() << std::endl;
+            writeKey(KEY_NAME_ENVELOPE, out);
+            writeEnvelope(note.envelope.value(), out);
+            out.append('\n');
         }
 
         if (!note.portamento.empty()) {
-            auto mode2 = PBStrings::fromPoints(note.portamento);
-            out << KEY_NAME_PBS << "=" << mode2.PBS << std::endl;
-            out << KEY_NAME_PBW << "=" << mode2.PBW << std::endl;
-            if (!mode2.PBY.empty()) {
-                out << KEY_NAME_PBY << "=" << mode2.PBY << std::endl;
-            }
-            if (!mode2.PBM.empty()) {
-                out << KEY_NAME_PBM << "=" << mode2.PBM << std::endl;
-            }
+            writePortamento(note.portamento, out);
         }
         if (note.vibrato) {
-            out << KEY_NAME_VBR << "=" << note.vibrato->toString() << std::endl;
+            writeKey(KEY_NAME_VBR, out);
+            writeVibrato(note.vibrato.value(), out);
+            out.append('\n');
         }
         if (note.tempo != NODEF_DOUBLE) {
-            out << KEY_NAME_TEMPO << "=" << note.tempo << std::endl;
+            writeKey(KEY_NAME_TEMPO, out);
+            out.appendDouble(note.tempo).append('\n');
         }
         if (!note.region.empty()) {
-            out << KEY_NAME_REGION_START << "=" << note.region << std::endl;
+            writeKey(KEY_NAME_REGION_START, out);
+            out.append(note.region).append('\n');
         }
         if (!note.regionEnd.empty()) {
-            out << KEY_NAME_REGION_END << "=" << note.regionEnd << std::endl;
+            writeKey(KEY_NAME_REGION_END, out);
+            out.append(note.regionEnd).append('\n');
         }
     }
 
-    void writeSectionVersion(const UstVersion &version, std::ostream &out) {
+    void writeSectionVersion(const UstVersion &version, TextBuffer &out) {
         writeSectionName(SECTION_NAME_VERSION, out);
 
-        out << UST_VERSION_PREFIX_NOSPACE << version.version << std::endl;
+        out.append(UST_VERSION_PREFIX_NOSPACE).append(version.version).append('\n');
 
         // UTF-8 UST File?
-        std::string charset = version.charset;
-        if (!charset.empty()) {
-            out << KEY_NAME_CHARSET << "=" << charset << std::endl;
+        if (!version.charset.empty()) {
+            writeKey(KEY_NAME_CHARSET, out);
+            out.append(version.charset).append('\n');
         }
     }
 
-    void writeSectionSettings(const UstSettings &settings, std::ostream &out) {
+    void writeSectionSettings(const UstSettings &settings, TextBuffer &out) {
         writeSectionName(SECTION_NAME_SETTING, out);
 
-        out << KEY_NAME_TEMPO << "=" << settings.tempo << std::endl;
-        out << KEY_NAME_TRACKS << "=" << VALUE_PROJECT_TRACKS << std::endl;
-        out << KEY_NAME_PROJECT_NAME << "=" << settings.projectName << std::endl;
-        out << KEY_NAME_VOICE_DIR << "=" << settings.voiceDir << std::endl;
-        out << KEY_NAME_OUTPUT_FILE << "=" << settings.outputFileName << std::endl;
-        out << KEY_NAME_CACHE_DIR << "=" << settings.cacheDir << std::endl;
-        out << KEY_NAME_TOOL1 << "=" << settings.wavtoolPath << std::endl;
-        out << KEY_NAME_TOOL2 << "=" << settings.resamplerPath << std::endl;
+        writeKey(KEY_NAME_TEMPO, out);
+        out.appendDouble(settings.tempo).append('\n');
+        writeKey(KEY_NAME_TRACKS, out);
+        out.append(VALUE_PROJECT_TRACKS).append('\n');
+        writeKey(KEY_NAME_PROJECT_NAME, out);
+        out.append(settings.projectName).append('\n');
+        writeKey(KEY_NAME_VOICE_DIR, out);
+        out.append(settings.voiceDir).append('\n');
+        writeKey(KEY_NAME_OUTPUT_FILE, out);
+        out.append(settings.outputFileName).append('\n');
+        writeKey(KEY_NAME_CACHE_DIR, out);
+        out.append(settings.cacheDir).append('\n');
+        writeKey(KEY_NAME_TOOL1, out);
+        out.append(settings.wavtoolPath).append('\n');
+        writeKey(KEY_NAME_TOOL2, out);
+        out.append(settings.resamplerPath).append('\n');
 
         if (settings.isMode2) {
-            out << KEY_NAME_MODE2 << "=" << VALUE_MODE2_ON << std::endl;
+            writeKey(KEY_NAME_MODE2, out);
+            out.append(VALUE_MODE2_ON).append('\n');
         }
 
         if (!settings.flags.empty()) {
-            out << KEY_NAME_FLAGS << "=" << settings.flags << std::endl;
+            writeKey(KEY_NAME_FLAGS, out);
+            out.append(settings.flags).append('\n');
         }
     }
 
-}
\ No newline at end of file
+}
@@ -1,26 +1,255 @@
 #ifndef USTHELPER_P_H
 #define USTHELPER_P_H
 
+#include <cctype>
+#include <cstring>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <functional>
 #include <iostream>
+#include <memory_resource>
 
 #include <stdutau/note.h>
 #include <stdutau/ustfile.h>
+#include <stdutau/pitcharray.h>
+
+#include "utautils.h"
+#include "textbuffer_p.h"
 
 namespace Utau {
 
+    // A range of section lines, the first line is the section head
+    class SectionView {
+    public:
+        inline SectionView(const std::vector<std::string_view> &lines);
+        inline SectionView(const std::string_view *first, const std::string_view *last);
+
+        inline const std::string_view *begin() const;
+        inline const std::string_view *end() const;
+        inline std::size_t size() const;
+        inline const std::string_view &front() const;
+
+    protected:
+        const std::string_view *m_first;
+        const std::string_view *m_last;
+    };
+
+    inline SectionView::SectionView(const std::vector<std::string_view> &lines)
+        : m_first(lines.data()), m_last(lines.data() + lines.size()) {
+    }
+
+    inline SectionView::SectionView(const std::string_view *first, const std::string_view *last)
+        : m_first(first), m_last(last) {
+    }
+
+    inline const std::string_view *SectionView::begin() const {
+        return m_first;
+    }
+
+    inline const std::string_view *SectionView::end() const {
+        return m_last;
+    }
+
+    inline std::size_t SectionView::size() const {
+        return m_last - m_first;
+    }
+
+    inline const std::string_view &SectionView::front() const {
+        return *m_first;
+    }
+
     bool parseSectionName(const std::string_view &str, std::string_view &name);
-    void parseSectionNote(const std::vector<std::string> &sectionList, Note &note);
-    void parseSectionNoteExt(const std::vector<std::string> &sectionList, NoteExt &note);
-    void parseSectionVersion(const std::vector<std::string> &sectionList, UstVersion &out);
-    void parseSectionSettings(const std::vector<std::string> &sectionList, UstSettings &out);
-
-    void writeSectionName(const std::string &name, std::ostream &out);
-    void writeSectionName(int name, std::ostream &out);
-    void writeSectionNote(int num, const Note &note, std::ostream &out);
-    void writeSectionVersion(const UstVersion &version, std::ostream &out);
-    void writeSectionSettings(const UstSettings &settings, std::ostream &out);
+
+    void parseSectionNote(const SectionView &sectionList, Note &note,
+                          const UnknownKeyHandler &handler = {});
+    void parseSectionNoteExt(const SectionView &sectionList, NoteExt &note,
+                             const UnknownKeyHandler &handler = {});
+    // Raw values of the note keys that are expensive to decode, a view with null data means the
+    // key is absent while an empty view with valid data means an empty value
+    struct NoteRawFields {
+        std::string_view PBS;
+        std::string_view PBW;
+        std::string_view PBY;
+        std::string_view PBM;
+        std::string_view pitches;
+        std::string_view vibrato;
+        std::string_view envelope;
+    };
+
+    // Parses the cheap fields and keeps the raw values of the others
+    void parseSectionNoteRaw(const SectionView &sectionList, Note &note, NoteRawFields &raw,
+                             const UnknownKeyHandler &handler = {});
+    void decodeNoteRawFields(const NoteRawFields &raw, Note &note);
+
+    void parseSectionVersion(const SectionView &sectionList, UstVersion &out);
+    void parseSectionSettings(const SectionView &sectionList, UstSettings &out);
+
+    // Splits a string lazily with the same tokens as split()
+    class TokenReader {
+    public:
+        inline TokenReader(const std::string_view &s, char delimiter);
+
+        inline std::size_t count() const;
+        inline bool next(std::string_view &token);
+
+    protected:
+        std::string_view m_str;
+        std::size_t m_pos;
+        char m_delimiter;
+        bool m_done;
+    };
+
+    inline TokenReader::TokenReader(const std::string_view &s, char delimiter)
+        : m_str(s), m_pos(0), m_delimiter(delimiter), m_done(false) {
+    }
+
+    inline std::size_t TokenReader::count() const {
+        std::size_t res = 1;
+        for (auto ch : m_str) {
+            res += (ch == m_delimiter);
+        }
+        return res;
+    }
+
+    inline bool TokenReader::next(std::string_view &token) {
+        if (m_done) {
+            return false;
+        }
+        auto pos = m_str.find(m_delimiter, m_pos);
+        if (pos == std::string_view::npos) {
+            token = m_str.substr(m_pos);
+            m_done = true;
+        } else {
+            token = m_str.substr(m_pos, pos - m_pos);
+            m_pos = pos + 1;
+        }
+        return true;
+    }
+
+    std::vector<Point> pointsFromPBStrings(const std::string_view &PBS, const std::string_view &PBW,
+                                           const std::string_view &PBY,
+                                           const std::string_view &PBM);
+    void pointsFromPBStrings(const std::string_view &PBS, const std::string_view &PBW,
+                             const std::string_view &PBY, const std::string_view &PBM,
+                             std::vector<Point> &res);
+    void doublesFromString(const std::string_view &s, std::vector<double> &res);
+
+    void writeSectionName(const std::string_view &name, TextBuffer &out);
+    void writeSectionName(int name, TextBuffer &out);
+    // The compact pitches are written instead of the note pitches if they are not empty
+    void writeSectionNote(int num, const Note &note, TextBuffer &out,
+                          const PitchArray *pitches = nullptr);
+    void writeSectionVersion(const UstVersion &version, TextBuffer &out);
+    void writeSectionSettings(const UstSettings &settings, TextBuffer &out);
+
+    bool readStreamData(std::istream &is, std::string &data);
+    bool readStreamData(std::istream &is, std::pmr::string &data);
+
+    // Splits the buffer into lines and sections with the same rules as reading lines with
+    // std::getline, calls handler(sectionName, first, last) for each section whose name is valid,
+    // the indexes refer to the line list. The lines of handled sections are kept in the list if
+    // keepLines is true, otherwise the list is reused between sections.
+    template <class Handler>
+    void splitSections(const std::string_view &data, bool stripCR,
+                       std::pmr::vector<std::string_view> &lines, bool keepLines,
+                       Handler &&handler) {
+        std::size_t base = lines.size(); // Start of current section
+
+        std::string_view::size_type pos = 0;
+        while (pos < data.size()) {
+            std::string_view line;
+            bool eof;
+            auto lf = static_cast<const char *>(
+                std::memchr(data.data() + pos, '\n', data.size() - pos));
+            if (!lf) {
+                line = data.substr(pos);
+                pos = data.size();
+                eof = true;
+            } else {
+                auto len = lf - (data.data() + pos);
+                line = data.substr(pos, len);
+                pos += len + 1;
+                eof = false;
+                if (stripCR && !line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+            }
+
+            if (line.empty() && !eof) {
+                continue;
+            }
+
+            // Continue to add until meet the start of section or end
+            if (!starts_with(line, SECTION_BEGIN_MARK) && !eof) {
+                lines.push_back(line);
+                continue;
+            }
+
+            // If meet end, append without continue
+            if (!line.empty() && eof) {
+                lines.push_back(line);
+            }
+
+            // Previous section is empty
+            if (lines.size() - base > 1) {
+                // If Section Name is invalid
+                std::string_view sectionName;
+                if (!parseSectionName(lines[base], sectionName)) {
+                    lines.resize(base);
+                    continue;
+                }
+                handler(sectionName, base, lines.size());
+                if (keepLines) {
+                    base = lines.size();
+                }
+            }
+
+            lines.resize(base);
+            lines.push_back(line);
+        }
+        lines.resize(base);
+    }
+
+    // Calls handler(sectionName, sectionList) for each section whose name is valid, the views
+    // point into the buffer. The line list is allocated from the resource.
+    template <class Handler>
+    void readSections(const std::string_view &data, bool stripCR, Handler &&handler,
+                      std::pmr::memory_resource *resource = std::pmr::get_default_resource()) {
+        std::pmr::vector<std::string_view> lines(resource);
+        splitSections(data, stripCR, lines, false,
+                      [&](const std::string_view &sectionName, std::size_t first,
+                          std::size_t last) {
+                          handler(sectionName,
+                                  SectionView(lines.data() + first, lines.data() + last));
+                      });
+    }
+
+    struct SectionSpan {
+        std::string_view name;
+        std::size_t first;
+        std::size_t last;
+    };
+
+    // Boundary scan of the whole buffer, keeps all section lines for a later parsing pass
+    inline void scanSections(const std::string_view &data, bool stripCR,
+                             std::pmr::vector<std::string_view> &lines,
+                             std::pmr::vector<SectionSpan> &sections) {
+        splitSections(data, stripCR, lines, true,
+                      [&](const std::string_view &sectionName, std::size_t first,
+                          std::size_t last) {
+                          sections.push_back({sectionName, first, last});
+                      });
+    }
+
+    inline bool isNoteSectionName(const std::string_view &name) {
+        for (auto ch : name) {
+            if (!std::isdigit(static_cast<unsigned char>(ch)))
+                return false;
+        }
+        return true;
+    }
 
 }
 
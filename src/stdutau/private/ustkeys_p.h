@@ -0,0 +1,149 @@
+#ifndef USTKEYS_P_H
+#define USTKEYS_P_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include <stdutau/utaconst.h>
+
+namespace Utau {
+
+    enum class NoteKey : std::uint8_t {
+        Unknown,
+        Lyric,
+        NoteNum,
+        Length,
+        Flags,
+        Intensity,
+        Modulation,
+        PreUtterance,
+        VoiceOverlap,
+        Velocity,
+        StartPoint,
+        Tempo,
+        RegionStart,
+        RegionEnd,
+        PBStart,
+        PBS,
+        PBW,
+        PBY,
+        PBM,
+        Pitches,
+        VBR,
+        Envelope,
+        PreUtteranceRO, // Readonly keys of plugin files, keep them at the end
+        VoiceOverlapRO,
+        StartPointRO,
+        FileNameRO,
+        AliasRO,
+        CacheRO,
+    };
+
+    struct NoteKeyEntry {
+        std::string_view name;
+        NoteKey key;
+    };
+
+    constexpr const NoteKeyEntry NOTE_KEY_ENTRIES[] = {
+        {KEY_NAME_LYRIC,                  NoteKey::Lyric         },
+        {KEY_NAME_NOTE_NUM,               NoteKey::NoteNum       },
+        {KEY_NAME_LENGTH,                 NoteKey::Length        },
+        {KEY_NAME_FLAGS,                  NoteKey::Flags         },
+        {KEY_NAME_INTENSITY,              NoteKey::Intensity     },
+        {KEY_NAME_MODULATION,             NoteKey::Modulation    },
+        {KEY_NAME_MODURATION,             NoteKey::Modulation    },
+        {KEY_NAME_PRE_UTTERANCE,          NoteKey::PreUtterance  },
+        {KEY_NAME_VOICE_OVERLAP,          NoteKey::VoiceOverlap  },
+        {KEY_NAME_VELOCITY,               NoteKey::Velocity      },
+        {KEY_NAME_START_POINT,            NoteKey::StartPoint    },
+        {KEY_NAME_TEMPO,                  NoteKey::Tempo         },
+        {KEY_NAME_REGION_START,           NoteKey::RegionStart   },
+        {KEY_NAME_REGION_END,             NoteKey::RegionEnd     },
+        {KEY_NAME_PB_START,               NoteKey::PBStart       },
+        {KEY_NAME_PBS,                    NoteKey::PBS           },
+        {KEY_NAME_PBW,                    NoteKey::PBW           },
+        {KEY_NAME_PBY,                    NoteKey::PBY           },
+        {KEY_NAME_PBM,                    NoteKey::PBM           },
+        {KEY_NAME_PICHES,                 NoteKey::Pitches       },
+        {KEY_NAME_PITCHES,                NoteKey::Pitches       },
+        {KEY_NAME_PITCH_BEND,             NoteKey::Pitches       },
+        {KEY_NAME_VBR,                    NoteKey::VBR           },
+        {KEY_NAME_ENVELOPE,               NoteKey::Envelope      },
+        {KEY_NAME_PRE_UTTERANCE_READONLY, NoteKey::PreUtteranceRO},
+        {KEY_NAME_VOICE_OVERLAP_READONLY, NoteKey::VoiceOverlapRO},
+        {KEY_NAME_START_POINT_READONLY,   NoteKey::StartPointRO  },
+        {KEY_NAME_FILENAME_READONLY,      NoteKey::FileNameRO    },
+        {KEY_NAME_ALIAS_READONLY,         NoteKey::AliasRO       },
+        {KEY_NAME_CACHE_READONLY,         NoteKey::CacheRO       },
+    };
+
+    namespace NoteKeyHash {
+
+        constexpr const int ENTRY_COUNT = sizeof(NOTE_KEY_ENTRIES) / sizeof(NOTE_KEY_ENTRIES[0]);
+        constexpr const std::uint32_t SLOT_COUNT = 128;
+
+        constexpr inline std::uint32_t hash(const std::string_view &s, std::uint32_t seed) {
+            // FNV-1a with a search seed
+            std::uint32_t h = 2166136261u ^ seed;
+            for (char ch : s) {
+                h ^= static_cast<unsigned char>(ch);
+                h *= 16777619u;
+            }
+            return (h ^ (h >> 15)) & (SLOT_COUNT - 1);
+        }
+
+        struct Table {
+            std::uint32_t seed = 0;
+            std::array<std::int8_t, SLOT_COUNT> slots = {};
+        };
+
+        constexpr inline bool tryBuild(std::uint32_t seed, Table &table) {
+            table.seed = seed;
+            for (auto &slot : table.slots) {
+                slot = -1;
+            }
+            for (int i = 0; i < ENTRY_COUNT; ++i) {
+                auto &slot = table.slots[hash(NOTE_KEY_ENTRIES[i].name, seed)];
+                if (slot >= 0) {
+                    return false;
+                }
+                slot = static_cast<std::int8_t>(i);
+            }
+            return true;
+        }
+
+        // Searches the first seed that maps every key into a distinct slot
+        constexpr inline Table build() {
+            Table table;
+            for (std::uint32_t seed = 0; seed < 4096; ++seed) {
+                if (tryBuild(seed, table)) {
+                    return table;
+                }
+            }
+            table.seed = ~0u;
+            return table;
+        }
+
+        constexpr const Table TABLE = build();
+        static_assert(TABLE.seed != ~0u, "No perfect hash seed for the note keys");
+
+    }
+
+    // Resolves a note section key with one hash and at most one string comparison
+    constexpr inline NoteKey noteKeyOf(const std::string_view &key) {
+        auto index = NoteKeyHash::TABLE.slots[NoteKeyHash::hash(key, NoteKeyHash::TABLE.seed)];
+        if (index < 0) {
+            return NoteKey::Unknown;
+        }
+        const auto &entry = NOTE_KEY_ENTRIES[index];
+        return entry.name == key ? entry.key : NoteKey::Unknown;
+    }
+
+    static_assert(noteKeyOf(KEY_NAME_MODURATION) == NoteKey::Modulation);
+    static_assert(noteKeyOf(KEY_NAME_CACHE_READONLY) == NoteKey::CacheRO);
+    static_assert(noteKeyOf(KEY_NAME_LABEL) == NoteKey::Unknown);
+
+}
+
+#endif // USTKEYS_P_H
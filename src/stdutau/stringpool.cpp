@@ -0,0 +1,105 @@
+#include "stringpool.h"
+
+#include <cstring>
+#include <utility>
+
+namespace Utau {
+
+    /*!
+        \class StringPool
+        \brief Append-only set of unique strings with integer ids.
+
+        Every distinct string is stored once and gets the next id, interning the same content
+        again returns the same id, so two interned strings are equal if and only if their ids are
+        equal. The characters live in fixed blocks that are never moved, the views returned by
+        at() stay valid until clear() or the destruction of the pool.
+
+        All memory of the pool comes from its memory resource. The pool is not copyable, share
+        it with a \c std::shared_ptr instead. It is not thread-safe for concurrent interning.
+    */
+
+    /*!
+        Constructs a pool that only contains the empty string, the memory is allocated from
+        \a resource.
+    */
+    StringPool::StringPool(std::pmr::memory_resource *resource)
+        : m_resource(resource), m_blocks(resource), m_blockUsed(0), m_byteCount(0),
+          m_strings(resource), m_ids(resource) {
+        clear();
+    }
+
+    /*!
+        Destructor.
+    */
+    StringPool::~StringPool() {
+        releaseBlocks();
+    }
+
+    /*!
+        Returns the id of the string, adds a copy of it if it's new.
+    */
+    StringPool::Id StringPool::intern(const std::string_view &s) {
+        auto it = m_ids.find(s);
+        if (it != m_ids.end()) {
+            return it->second;
+        }
+
+        char *data;
+        if (s.size() > BLOCK_SIZE / 4) {
+            // A long string takes its own block, the current block stays open
+            data = allocateBlock(s.size());
+            std::swap(m_blocks[m_blocks.size() - 2], m_blocks.back());
+        } else {
+            if (m_blockUsed + s.size() > BLOCK_SIZE) {
+                allocateBlock(BLOCK_SIZE);
+                m_blockUsed = 0;
+            }
+            data = m_blocks.back().data + m_blockUsed;
+            m_blockUsed += s.size();
+        }
+        std::memcpy(data, s.data(), s.size());
+        m_byteCount += s.size();
+
+        Id id = size();
+        std::string_view view(data, s.size());
+        m_strings.push_back(view);
+        m_ids.emplace(view, id);
+        return id;
+    }
+
+    /*!
+        Returns the id of the string, or -1 if it's not interned.
+    */
+    StringPool::Id StringPool::find(const std::string_view &s) const {
+        auto it = m_ids.find(s);
+        return it == m_ids.end() ? -1 : it->second;
+    }
+
+    /*!
+        Removes all strings except the empty string, the views and ids become invalid.
+    */
+    void StringPool::clear() {
+        releaseBlocks();
+        allocateBlock(BLOCK_SIZE);
+        m_blockUsed = 0;
+        m_byteCount = 0;
+
+        m_strings.assign(1, std::string_view(m_blocks.back().data, 0));
+        m_ids.clear();
+        m_ids.emplace(m_strings.front(), EMPTY_ID);
+    }
+
+    char *StringPool::allocateBlock(std::size_t size) {
+        auto data = static_cast<char *>(m_resource->allocate(size, 1));
+        m_blocks.push_back({data, size});
+        return data;
+    }
+
+    void StringPool::releaseBlocks() {
+        for (const auto &block : m_blocks) {
+            m_resource->deallocate(block.data, block.size, 1);
+        }
+        m_blocks.clear();
+    }
+
+}
@@ -0,0 +1,76 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <stdutau/utaglobal.h>
+
+namespace Utau {
+
+    class STDUTAU_EXPORT StringPool {
+    public:
+        using Id = int;
+
+        explicit StringPool(
+            std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+        ~StringPool();
+
+        StringPool(const StringPool &) = delete;
+        StringPool &operator=(const StringPool &) = delete;
+
+        inline std::pmr::memory_resource *resource() const;
+
+        Id intern(const std::string_view &s);
+        Id find(const std::string_view &s) const;
+
+        inline std::string_view at(Id id) const;
+        inline int size() const;
+        inline std::size_t byteCount() const;
+
+        void clear();
+
+        // Id of the empty string, which is always interned
+        static constexpr const Id EMPTY_ID = 0;
+        static constexpr const std::size_t BLOCK_SIZE = 4096;
+
+    protected:
+        struct Block {
+            char *data;
+            std::size_t size;
+        };
+
+        std::pmr::memory_resource *m_resource;
+        std::pmr::vector<Block> m_blocks; // The last one is being filled
+        std::size_t m_blockUsed;
+        std::size_t m_byteCount;
+
+        std::pmr::vector<std::string_view> m_strings; // Indexed by id, the views point into blocks
+        std::pmr::unordered_map<std::string_view, Id> m_ids;
+
+        char *allocateBlock(std::size_t size);
+        void releaseBlocks();
+    };
+
+    inline std::pmr::memory_resource *StringPool::resource() const {
+        return m_resource;
+    }
+
+    inline std::string_view StringPool::at(Id id) const {
+        return m_strings[id];
+    }
+
+    inline int StringPool::size() const {
+        return static_cast<int>(m_strings.size());
+    }
+
+    inline std::size_t StringPool::byteCount() const {
+        return m_byteCount;
+    }
+
+}
+
+#endif // STRINGPOOL_H
@@ -3,7 +3,12 @@
 #include <cmath>
 #include <cstdint>
 
+#include "pitchcodec.h"
+#include "tempomap.h"
 #include "utautils.h"
+#include "private/parallel_p.h"
+#include "private/pitchcurve_p.h"
+#include "private/synth_p.h"
 
 namespace Utau {
 
@@ -28,172 +33,14 @@ namespace Utau {
 
         static constexpr const double PI = 3.1415926;
 
-        static constexpr const char Base64EncodeMap[] =
-            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=";
-
-        static inline double f_x(double x1, double y1, double x2, double y2, double x) {
-            if (x1 == x2) {
-                return y1;
-            }
-            return (y1 - y2) / 2 * std::cos(PI * (x - x1) / (x2 - x1)) + (y1 + y2) / 2;
-        }
-
-
-        static inline double f_r(double x1, double y1, double x2, double y2, double x) {
-            if (x1 == x2) {
-                return y1;
-            }
-            return (y2 - y1) * std::cos(PI / 2 / (x2 - x1) * (x - x2)) + y1;
-        }
-
-
-        static inline double f_j(double x1, double y1, double x2, double y2, double x) {
-            if (x1 == x2) {
-                return y1;
-            }
-            return (y1 - y2) * std::cos(PI / 2 / (x2 - x1) * (x - x1)) + y2;
-        }
-
-
-        static inline constexpr double f_s(double x1, double y1, double x2, double y2, double x) {
-            if (x1 == x2) {
-                return y1;
-            }
-            return (y2 - y1) / (x2 - x1) * (x - x1) + y1;
-        }
-
-        static inline double f_type(const Point::Type &ptype, double x1, double y1, double x2,
-                                    double y2, double x) {
-            int impact;
-            switch (ptype) {
-                case Point::linearJoin:
-                    impact = int(f_s(x1, y1, x2, y2, x));
-                    break;
-                case Point::jJoin:
-                    impact = int(f_j(x1, y1, x2, y2, x));
-                    break;
-                case Point::rJoin:
-                    impact = int(f_r(x1, y1, x2, y2, x));
-                    break;
-                default:
-                    impact = int(f_x(x1, y1, x2, y2, x));
-                    break;
-            }
-            return impact;
-        }
-
-        static int find_impact(const std::vector<Point> &portamento, int &startIndex, int curTick,
-                               double PositiveTempo, double NegativeTempo,
-                               const std::vector<double> &vibrato, int length) {
-
-            // portamento: Mode2 Pitch curve points
-            // startIndex: search from index
-            // curTick: current tick
-            // PositiveTempo: tempo used when ticks is positive
-            // NegativeTempo: tempo used when ticks is negative (necessary when tempo changed)
-            // vibrato: The vibrato sequence, which can be absent
-
-            if (startIndex < 0) {
-                return 0;
-            }
-
-            int basePitch;
-            int &i = startIndex; // Self counter
-            double x1, y1, x2, y2;
-            bool tooLeft;
-
-            basePitch = 0;
-
-            // Search portatmento
-            if (!portamento.empty()) {
-                tooLeft = false;
-
-                while (i < portamento.size() - 1) {
-                    // Last point
-                    x1 = portamento[i].x * ((portamento[i].x < 0) ? NegativeTempo : PositiveTempo) /
-                         60 * 480 / 1000;
-
-                    if (curTick < x1) {
-                        if (i > 0) {
-                            i--; // startIndex is incorrect, need to search forward
-                            continue;
-                        } else if (i == 0) {
-                            tooLeft = true;
-                            break;
-                        }
-                    }
-
-                    y1 = portamento[i].y * 10;
-
-                    // Next point
-                    x2 = portamento[i + 1].x *
-                         ((portamento[i + 1].x < 0) ? NegativeTempo : PositiveTempo) / 60 * 480 /
-                         1000;
-
-                    y2 = portamento[i + 1].y * 10;
-
-                    auto ptype = portamento[i + 1].type;
-
-                    if (curTick > x2) {
-                        i++;
-                        continue;
-                    }
-                    basePitch = int(f_type(ptype, x1, y1, x2, y2, curTick));
-                    break;
-                }
-                if (tooLeft) {
-                    basePitch = int(portamento[0].y * 10); // haven't reached the first point yet
-                }
-            }
-
-            // Search vibrato
-            if (vibrato.size() >= 8 && length > 0) {
-                double proportion = vibrato[0];
-                double period = vibrato[1];
-                double amplitude = vibrato[2];
-                double easeIn = vibrato[3];
-                double easeOut = vibrato[4];
-                double phase = vibrato[5];
-                double offset = vibrato[6];
-
-                proportion /= 100.0;
-
-                double tick_time = period * PositiveTempo / 60 * 480 / 1000;
-                double tick_length = proportion * length;
-                double tick_start = (1 - proportion) * length; // ticks time relative to start
-
-                double ratio;
-                double x, k, p, y;
-
-                k = 1 / tick_time * 2 * PI;                    // Circular frequency
-                p = phase / 100.0 * 2 * PI;                    // Initial phase
-
-                easeIn = easeIn / 100.0 * tick_length;         // Fade in time
-                easeOut = (1 - easeOut / 100.0) * tick_length; // Fade out time
-                offset /= 100.0;
-
-                x = curTick - tick_start;       // tick x
-                y = amplitude * sin(k * x - p); // original vibrato
-
-                if (x > 0 && x < tick_length) {
-                    ratio = 1;
-                    // Add offset
-                    y += offset * amplitude;
-                    // Calculate envelope
-                    if (x < easeIn) {
-                        ratio *= x / easeIn;
-                    }
-                    if (x > easeOut) {
-                        ratio *= 1 - (x - easeOut) / (tick_length - easeOut);
-                    }
-                    // Add envelope
-                    y = ratio * y;
-                    // Add influence
-                    basePitch += int(y);
-                }
-            }
-
-            return basePitch;
+        // Adds the pitch of a note's curve and vibrato at the ascending ticks to out
+        static void rasterize_note(PitchCurve &curve, VibratoOscillator &osc,
+                                   const std::vector<double> &vibrato, int length,
+                                   double PositiveTempo, const int *ticks, int count,
+                                   bool stopAtLastPoint, int *out, std::vector<int> &buffer) {
+            count = curve.addTo(ticks, count, stopAtLastPoint, out, buffer);
+            osc.build(vibrato, length, PositiveTempo);
+            osc.addTo(ticks, count, out);
         }
 
         static std::vector<int> convert_from_vector_point(
@@ -215,8 +62,6 @@ namespace Utau {
 
             std::vector<int> PitchBend;
             double duration, nextStart, pbstart;
-            int basePitch, prevImpact, nextImpact;
-            int i, j, k; // Self, successor, precursor counter
 
             double tick;
 
@@ -230,39 +75,61 @@ namespace Utau {
                             ? (curLength + nextNote[0].x * curTempo / 60 * 480 / 1000)
                             : INFINITY;
 
-            i = 0;
-            j = 0;
-            k = 0;
-
             // Set the starting point on the previous note (- PBStart = STP + pre)
             pbstart = -(curPre + curStp) * prevTempo / 60 * 480 / 1000;
-            tick = pbstart;
-
-            while (tick < duration) {
-                prevImpact = 0;
-                nextImpact = 0;
-
-                basePitch =
-                    find_impact(curNote, i, int(tick), curTempo, prevTempo, curVBR, curLength);
-
-                // The part influenced by the next note
-                if (tick >= nextStart) {
-                    if (j < nextNote.size() - 1) {
-                        nextImpact = find_impact(nextNote, j, int(tick) - curLength, curTempo,
-                                                 curTempo, nextVBR, nextLength);
-                    }
-                    nextImpact += -int(nextNote[0].y * 10);
-                }
 
-                // The part influenced by the previous note
+            // Sample every 5 ticks, the samples up to tick 0 are influenced by the previous note
+            // and the samples from the next note's start by the next note
+            std::vector<int> ticks;
+            int prevCount = 0;
+            int nextIndex = -1;
+            for (tick = pbstart; tick < duration; tick = tick + 5) {
                 if (tick <= 0) {
-                    prevImpact = find_impact(prevNote, k, int(tick) + prevLength, prevTempo,
-                                             prevTempo, prevVBR, prevLength);
+                    prevCount++;
+                }
+                if (nextIndex < 0 && tick >= nextStart) {
+                    nextIndex = int(ticks.size());
                 }
+                ticks.push_back(int(tick));
+            }
 
-                // Add the influence of the pitch line before and after the note
-                PitchBend.push_back(basePitch + prevImpact + nextImpact);
-                tick = tick + 5;
+            int count = int(ticks.size());
+            PitchBend.assign(count, 0);
+
+            std::vector<int> buffer;
+            std::vector<int> shifted;
+            PitchCurve curve(curNote, curTempo, prevTempo);
+            VibratoOscillator osc;
+            rasterize_note(curve, osc, curVBR, curLength, curTempo, ticks.data(), count, false,
+                           PitchBend.data(), buffer);
+
+            // The part influenced by the previous note
+            if (prevCount > 0) {
+                shifted.resize(prevCount);
+                for (int s = 0; s < prevCount; ++s) {
+                    shifted[s] = ticks[s] + prevLength;
+                }
+                curve.build(prevNote, prevTempo, prevTempo);
+                rasterize_note(curve, osc, prevVBR, prevLength, prevTempo, shifted.data(),
+                               prevCount, false, PitchBend.data(), buffer);
+            }
+
+            // The part influenced by the next note
+            if (nextIndex >= 0) {
+                int nextCount = count - nextIndex;
+                shifted.resize(nextCount);
+                for (int s = 0; s < nextCount; ++s) {
+                    shifted[s] = ticks[nextIndex + s] - curLength;
+                }
+                int *out = PitchBend.data() + nextIndex;
+                curve.build(nextNote, curTempo, curTempo);
+                rasterize_note(curve, osc, nextVBR, nextLength, curTempo, shifted.data(),
+                               nextCount, true, out, buffer);
+
+                int nextBase = -int(nextNote[0].y * 10);
+                for (int s = 0; s < nextCount; ++s) {
+                    out[s] += nextBase;
+                }
             }
 
             // Delete the redundant 0
@@ -273,61 +140,6 @@ namespace Utau {
             return PitchBend;
         }
 
-        static std::string encode_single_num(int n) {
-            // If the value is negative, the 12-bit binary is inverted
-            if (n < 0) {
-                n += 4096;
-            }
-
-            char x = Base64EncodeMap[int(n / 64)];
-            char y = Base64EncodeMap[n % 64];
-
-            std::string result;
-            result.push_back(x);
-            result.push_back(y);
-            return result;
-        }
-
-        static std::string encode_from_vector(const std::vector<int> &pitchBend) {
-            int pos = 0;
-            int count = 0;
-            int curInt;
-            int prevInt = INT32_MIN;
-            std::string result;
-
-            while (pos < pitchBend.size()) {
-                pos++;
-                curInt = (pitchBend[pos - 1] == NODEF_INT) ? 0 : pitchBend[pos - 1];
-
-                if (curInt == prevInt) {
-                    ++count;
-                    // Final process
-                    if (pos == pitchBend.size()) {
-                        if (count >= 2) {
-                            result += "#" + to_string(count) + "#";
-                        } else {
-                            result += encode_single_num(prevInt);
-                        }
-                    }
-                } else {
-                    if (count != 0) {
-                        // Use n-1 to replace the rest when appear repeatedly
-                        if (count >= 2) {
-                            result += "#" + to_string(count) + "#";
-                        } else {
-                            result += encode_single_num(prevInt);
-                        }
-                        count = 0;
-                    }
-                    result += encode_single_num(curInt);
-                }
-
-                prevInt = curInt;
-            }
-
-            return result;
-        }
-
     }
 
     namespace UtaTranslator {
@@ -528,7 +340,7 @@ namespace Utau {
 
         if (toBase64) {
             list << "!" + to_string(tempo);
-            list << UtaPitchCurves::encode_from_vector(pitchCurves);
+            list << PitchCodec::encode(pitchCurves);
         } else {
             // No using Base 64
             if (pitchCurves.empty()) {
@@ -625,13 +437,102 @@ namespace Utau {
         \brief Synthesis calculation helper class.
     */
 
+    // Calculates the notes in [left, right] into out, noteAt(i) and genonAt(i) return references
+    // that stay valid during the call
+    template <class NoteAt, class GenonAt>
+    static void calcSynthRange(const std::pair<int, int> &rangeLimits, int left, int right,
+                               double currentTempo, double prevDuration, bool prevIsRest,
+                               const std::string &globalFlags, const NoteAt &noteAt,
+                               const GenonAt &genonAt, Synth::SynthParams::value_type *out) {
+        const GenonSettings *nextGenon = nullptr;
+        for (int i = left; i <= right; ++i) {
+            const Note &note = noteAt(i);
+            const GenonSettings &genon = nextGenon ? *nextGenon : genonAt(i);
+
+            bool hasNext = i < rangeLimits.second;
+            nextGenon = hasNext ? &genonAt(i + 1) : nullptr;
+
+            if (note.hasTempo()) {
+                currentTempo = note.tempo;
+            }
+
+            SynthNoteInput input;
+            input.index = i;
+            input.note = &note;
+            input.prev = (i > rangeLimits.first) ? &noteAt(i - 1) : nullptr;
+            input.prevPrev = (i > rangeLimits.first + 1) ? &noteAt(i - 2) : nullptr;
+            input.next = hasNext ? &noteAt(i + 1) : nullptr;
+            input.genon = &genon;
+            input.nextGenon = nextGenon;
+            input.tempo = currentTempo;
+            input.prevDuration = prevDuration;
+            input.prevIsRest = prevIsRest;
+
+            auto &item = out[i - left];
+            calcSynthNote(input, globalFlags, item.first, item.second);
+
+            prevDuration = Note::duration(note.length, currentTempo);
+            prevIsRest = isRestLyric(note.lyric);
+        }
+    }
+
+    // Same as calcSynthRange(), with threadCount other than 1 the range is split into chunks that
+    // are calculated concurrently, tempoAt(i) returns the effective tempo carried into each chunk
+    template <class NoteAt, class GenonAt, class TempoAt>
+    static void calcSynthRange(const std::pair<int, int> &rangeLimits, int left, int right,
+                               double currentTempo, double prevDuration, bool prevIsRest,
+                               const std::string &globalFlags, const NoteAt &noteAt,
+                               const GenonAt &genonAt, const TempoAt &tempoAt,
+                               Synth::SynthParams::value_type *out, int threadCount) {
+        static constexpr const int GRAIN = 64;
+
+        int count = right - left + 1;
+        if (threadCount == 1 || count <= GRAIN) {
+            calcSynthRange(rangeLimits, left, right, currentTempo, prevDuration, prevIsRest,
+                           globalFlags, noteAt, genonAt, out);
+            return;
+        }
+
+        parallelFor(count, threadCount, GRAIN, [&](int begin, int end) {
+            double tempo = currentTempo;
+            double duration = prevDuration;
+            bool isRest = prevIsRest;
+            if (begin > 0) {
+                const Note &prevNote = noteAt(left + begin - 1);
+                tempo = tempoAt(left + begin - 1);
+                duration = Note::duration(prevNote.length, tempo);
+                isRest = isRestLyric(prevNote.lyric);
+            }
+            calcSynthRange(rangeLimits, left + begin, left + end - 1, tempo, duration, isRest,
+                           globalFlags, noteAt, genonAt, out + begin);
+        });
+    }
+
     /*!
-        Calculates the synthesis arguments for the wavtool and resampler.
+        \overload
+
+        Calculates the synthesis arguments for the wavtool and resampler on the calling thread.
     */
     Synth::SynthParams Synth::calc(const std::pair<int, int> &rangeLimits,
                                    const std::pair<int, int> &range, double initialTempo,
                                    const std::string &globalFlags, const NoteGetter &noteGetter,
                                    const GenonSettingsGetter &genonSettingsGetter) {
+        return calc(rangeLimits, range, initialTempo, globalFlags, noteGetter,
+                    genonSettingsGetter, 1);
+    }
+
+    /*!
+        Calculates the synthesis arguments for the wavtool and resampler.
+
+        Every note in the range and its neighbours is fetched once, prefer the overload that takes
+        the notes directly if they're already stored in memory. The getters are always called on
+        the calling thread, \a threadCount only applies to the calculation.
+    */
+    Synth::SynthParams Synth::calc(const std::pair<int, int> &rangeLimits,
+                                   const std::pair<int, int> &range, double initialTempo,
+                                   const std::string &globalFlags, const NoteGetter &noteGetter,
+                                   const GenonSettingsGetter &genonSettingsGetter,
+                                   int threadCount) {
 
         int left = std::max(rangeLimits.first, range.first);
         int right = std::min(rangeLimits.second, range.second);
@@ -642,12 +543,7 @@ namespace Utau {
         double currentTempo = initialTempo;
         double prevDuration = 0;
         bool prevIsRest = false;
-        if (left == 0) {
-            const auto &note = noteGetter(0);
-            if (note.hasTempo()) {
-                currentTempo = note.tempo;
-            }
-        } else {
+        if (left > 0) {
             for (int i = left - 1; i >= 0; --i) {
                 const auto &note = noteGetter(i);
                 if (!note.hasTempo()) {
@@ -660,180 +556,295 @@ namespace Utau {
             const auto &prevNote = noteGetter(left - 1);
             prevDuration = Note::duration(prevNote.length, currentTempo);
             prevIsRest = isRestLyric(prevNote.lyric);
+        }
 
-            const auto &note = noteGetter(left);
-            if (note.hasTempo()) {
-                currentTempo = note.tempo;
-            }
+        if (left > right) {
+            return {};
         }
 
-        SynthParams args;
-        for (int i = left; i <= right; ++i) {
-            const auto &aNote = noteGetter(i);
-            const auto &aNextNote = noteGetter(i + 1);
+        // Fetch the notes the range depends on, then calculate over the copies
+        int first = std::max(rangeLimits.first, left - 2);
+        int last = std::min(rangeLimits.second, right + 1);
 
-            int aNoteNum = aNote.noteNum;
-            int aLength = aNote.length;
+        std::vector<Note> notes;
+        notes.reserve(last - first + 1);
+        for (int i = first; i <= last; ++i) {
+            notes.push_back(noteGetter(i));
+        }
 
-            const auto &aFlags = aNote.flags;
-            const auto &aLyric = aNote.lyric;
+        std::vector<GenonSettings> genons;
+        genons.reserve(last - left + 1);
+        for (int i = left; i <= last; ++i) {
+            genons.push_back(genonSettingsGetter(notes[i - first]));
+        }
 
-            double aTempo;
-            if (aNote.hasTempo()) {
-                aTempo = aNote.tempo;
-                currentTempo = aTempo;
-            } else {
-                aTempo = currentTempo;
-            }
+        TempoMap tempoMap;
+        if (threadCount != 1) {
+            tempoMap.build(notes.data() + (left - first), right - left + 1, currentTempo);
+        }
 
-            double aIntensity = aNote.realIntensity();
-            double aModulation = aNote.realModulation();
-            double aVelocity = aNote.realVelocity();
-            const auto &aGenon = genonSettingsGetter(aNote);
-
-            double duration = Note::duration(aLength, aTempo);
-            auto aCorrect = getCorrectGenonSettings(
-                aNote.hasPreUtterance() ? aNote.preUttr : aGenon.preUtterance,
-                aNote.hasVoiceOverlap() ? aNote.overlap : aGenon.voiceOverlap,
-                aNote.realStartPoint(), aVelocity, duration, prevDuration, prevIsRest);
-            prevDuration = duration;
-            prevIsRest = isRestLyric(aLyric);
-
-            double aPreUttr = aCorrect.PreUtterance;
-            double aOverlap = aCorrect.VoiceOverlap;
-            double aStartPoint = aCorrect.StartPoint;
-
-            std::vector<Point> aPitch;
-            std::vector<Point> aEnvelope;
-            std::vector<double> aVibrato;
-
-            // Compute Mode2 Pitch Bend
-            std::vector<Point> aPrevPitch;
-            std::vector<double> aPrevVibrato;
-            std::string aPrevLyric;
-
-            int aPrevLength = 480;
-            int aPrevNoteNum = aNoteNum;
-
-            // Previous Note
-            if (i > rangeLimits.first) {
-                auto aPrevNote = noteGetter(i - 1);
-                aPrevLength = aPrevNote.length;
-                aPrevLyric = aPrevNote.lyric;
-                aPrevNoteNum = aPrevNote.noteNum;
-                aPrevPitch = aPrevNote.portamento;               // Mode2 Pitch Control Points
-                aPrevVibrato = getRawVibrato(aPrevNote.vibrato); // Mode2 Vibrato
-
-                if (!aPrevPitch.empty() && i > rangeLimits.first + 1) {
-                    const auto &noteBeforePrev = noteGetter(i - 2);
-                    UtaTranslator::getCorrectPBSY(noteBeforePrev.noteNum, noteBeforePrev.lyric,
-                                                  aPrevNoteNum, aPrevPitch.front());
-                }
-            }
+        SynthParams args(right - left + 1);
+        calcSynthRange(
+            rangeLimits, left, right, currentTempo, prevDuration, prevIsRest, globalFlags,
+            [&](int i) -> const Note & { return notes[i - first]; },
+            [&](int i) -> const GenonSettings & { return genons[i - left]; },
+            [&](int i) { return tempoMap.tempoAt(i - left); }, args.data(), threadCount);
+        return args;
+    }
 
-            // Current Note
-            aPitch = aNote.portamento;                  // Mode2 Mode2 Pitch Control Points
-            aEnvelope = getRawEnvelope(aNote.envelope); // Envelope
-            aVibrato = getRawVibrato(aNote.vibrato);    // Mode2 Vibrato
+    /*!
+        \overload
 
-            // Correct the y coordinate of first point
-            if (!aPitch.empty()) {
-                UtaTranslator::getCorrectPBSY(aPrevNoteNum, aPrevLyric, aNoteNum, aPitch.front());
-            }
+        Calculates the synthesis arguments of the notes stored in a contiguous array on the
+        calling thread.
+    */
+    Synth::SynthParams Synth::calc(const std::pair<int, int> &range, double initialTempo,
+                                   const std::string &globalFlags, const Note *notes, int count,
+                                   const GenonSettingsResolver &genonSettingsResolver) {
+        return calc(range, initialTempo, globalFlags, notes, count, genonSettingsResolver, 1);
+    }
 
-            int aNextLength = 480;
-            double aNextPreUttr = 0;
-            double aNextOverlap = 0;
-            std::vector<Point> aNextPitch;
-            std::vector<double> aNextVibrato;
-
-            // Next Note
-            if (i < rangeLimits.second) {
-                const auto &nextNote = noteGetter(i + 1);
-                const auto &nextGenonSettings = genonSettingsGetter(nextNote);
-                double nextTempo = nextNote.hasTempo() ? nextNote.tempo : currentTempo;
-                auto nextGenon = getCorrectGenonSettings(
-                    nextNote.hasPreUtterance() ? nextNote.preUttr : nextGenonSettings.preUtterance,
-                    nextNote.hasVoiceOverlap() ? nextNote.overlap : nextGenonSettings.voiceOverlap,
-                    nextNote.realStartPoint(), nextNote.realVelocity(),
-                    Note::duration(aNextNote.length, nextTempo), prevDuration, prevIsRest);
-
-                int aNextNoteNum = aNextNote.noteNum;            // Note Num
-                aNextLength = aNextNote.length;                  // Length
-
-                aNextPreUttr = nextGenon.PreUtterance;           // PreUtterance
-                aNextOverlap = nextGenon.VoiceOverlap;           // Overlap
-
-                aNextPitch = aNextNote.portamento;               // Mode2 Pitch Control Points
-                aNextVibrato = getRawVibrato(aNextNote.vibrato); // Mode2 Vibrato
-
-                // Correct the y coordinate of first point
-                if (!aNextPitch.empty()) {
-                    UtaTranslator::getCorrectPBSY(aNoteNum, aLyric, aNextNoteNum,
-                                                  aNextPitch.front());
-                }
-            }
+    /*!
+        Calculates the synthesis arguments of the notes stored in a contiguous array, the note at
+        \a notes[i] has the index \a i and the range limits are all the notes.
+
+        The notes are read in place and the genon settings resolver is called once per note, the
+        pointers it returns must not be null and must stay valid until the function returns.
 
-            if (aPitch.empty()) {
-                aPitch = UtaTranslator::getDefaultPitch(aPrevNoteNum, aPrevLyric, aNoteNum);
+        With \a threadCount other than 1 the notes are split into chunks that are calculated
+        concurrently, non-positive values mean one thread per core. The genon settings are still
+        resolved on the calling thread and the result is identical to the serial calculation.
+    */
+    Synth::SynthParams Synth::calc(const std::pair<int, int> &range, double initialTempo,
+                                   const std::string &globalFlags, const Note *notes, int count,
+                                   const GenonSettingsResolver &genonSettingsResolver,
+                                   int threadCount) {
+        return calc(range, TempoMap(notes, count, initialTempo), globalFlags, notes, count,
+                    genonSettingsResolver, threadCount);
+    }
+
+    /*!
+        \overload
+
+        Uses the tempo map of the notes to find the tempo at the start of the range, build it once
+        to calculate several ranges of the same notes.
+    */
+    Synth::SynthParams Synth::calc(const std::pair<int, int> &range, const TempoMap &tempoMap,
+                                   const std::string &globalFlags, const Note *notes, int count,
+                                   const GenonSettingsResolver &genonSettingsResolver,
+                                   int threadCount) {
+        int left = std::max(0, range.first);
+        int right = std::min(count - 1, range.second);
+        if (left > right)
+            return {};
+
+        // The first note overrides the initial tempo anyway
+        double currentTempo = tempoMap.tempoAt(left - 1);
+        double prevDuration = 0;
+        bool prevIsRest = false;
+        if (left > 0) {
+            const auto &prevNote = notes[left - 1];
+            prevDuration = Note::duration(prevNote.length, currentTempo);
+            prevIsRest = isRestLyric(prevNote.lyric);
+        }
+
+        SynthParams args(right - left + 1);
+        auto noteAt = [notes](int i) -> const Note & { return notes[i]; };
+        auto tempoAt = [&tempoMap](int i) { return tempoMap.tempoAt(i); };
+        if (threadCount == 1) {
+            calcSynthRange(
+                {0, count - 1}, left, right, currentTempo, prevDuration, prevIsRest, globalFlags,
+                noteAt,
+                [&](int i) -> const GenonSettings & { return *genonSettingsResolver(notes[i]); },
+                args.data());
+            return args;
+        }
+
+        // Resolve on the calling thread, the resolver doesn't need to be thread-safe
+        int last = std::min(count - 1, right + 1);
+        std::vector<const GenonSettings *> genons;
+        genons.reserve(last - left + 1);
+        for (int i = left; i <= last; ++i) {
+            genons.push_back(genonSettingsResolver(notes[i]));
+        }
+
+        calcSynthRange(
+            {0, count - 1}, left, right, currentTempo, prevDuration, prevIsRest, globalFlags,
+            noteAt, [&](int i) -> const GenonSettings & { return *genons[i - left]; }, tempoAt,
+            args.data(), threadCount);
+        return args;
+    }
+
+    /*!
+        \internal
+
+        Calculates the arguments of one note, the result only depends on the input.
+    */
+    void calcSynthNote(const SynthNoteInput &input, const std::string &globalFlags,
+                       ResamplerArguments &res, WavtoolArguments &wav) {
+        const auto &aNote = *input.note;
+        const auto &aGenon = *input.genon;
+
+        int i = input.index;
+        int aNoteNum = aNote.noteNum;
+        int aLength = aNote.length;
+
+        const auto &aFlags = aNote.flags;
+        const auto &aLyric = aNote.lyric;
+
+        double aTempo = input.tempo;
+
+        double aIntensity = aNote.realIntensity();
+        double aModulation = aNote.realModulation();
+        double aVelocity = aNote.realVelocity();
+
+        double duration = Note::duration(aLength, aTempo);
+        auto aCorrect = getCorrectGenonSettings(
+            aNote.hasPreUtterance() ? aNote.preUttr : aGenon.preUtterance,
+            aNote.hasVoiceOverlap() ? aNote.overlap : aGenon.voiceOverlap,
+            aNote.realStartPoint(), aVelocity, duration, input.prevDuration, input.prevIsRest);
+        double prevDuration = duration;
+        bool prevIsRest = isRestLyric(aLyric);
+
+        double aPreUttr = aCorrect.PreUtterance;
+        double aOverlap = aCorrect.VoiceOverlap;
+        double aStartPoint = aCorrect.StartPoint;
+
+        std::vector<Point> aPitch;
+        std::vector<Point> aEnvelope;
+        std::vector<double> aVibrato;
+
+        // Compute Mode2 Pitch Bend
+        std::vector<Point> aPrevPitch;
+        std::vector<double> aPrevVibrato;
+        static const std::string NoLyric;
+        const std::string *aPrevLyric = &NoLyric; // Not copied, it's only compared
+
+        int aPrevLength = 480;
+        int aPrevNoteNum = aNoteNum;
+
+        // Previous Note
+        if (input.prev) {
+            const auto &aPrevNote = *input.prev;
+            aPrevLength = aPrevNote.length;
+            aPrevLyric = &aPrevNote.lyric;
+            aPrevNoteNum = aPrevNote.noteNum;
+            aPrevPitch = aPrevNote.portamento;               // Mode2 Pitch Control Points
+            aPrevVibrato = getRawVibrato(aPrevNote.vibrato); // Mode2 Vibrato
+
+            if (!aPrevPitch.empty() && input.prevPrev) {
+                const auto &noteBeforePrev = *input.prevPrev;
+                UtaTranslator::getCorrectPBSY(noteBeforePrev.noteNum, noteBeforePrev.lyric,
+                                              aPrevNoteNum, aPrevPitch.front());
             }
+        }
+
+        // Current Note
+        aPitch = aNote.portamento;                  // Mode2 Mode2 Pitch Control Points
+        aEnvelope = getRawEnvelope(aNote.envelope); // Envelope
+        aVibrato = getRawVibrato(aNote.vibrato);    // Mode2 Vibrato
+
+        // Correct the y coordinate of first point
+        if (!aPitch.empty()) {
+            UtaTranslator::getCorrectPBSY(aPrevNoteNum, *aPrevLyric, aNoteNum, aPitch.front());
+        }
+
+        int aNextLength = 480;
+        double aNextPreUttr = 0;
+        double aNextOverlap = 0;
+        std::vector<Point> aNextPitch;
+        std::vector<double> aNextVibrato;
+
+        // Next Note
+        if (input.next) {
+            const auto &aNextNote = *input.next;
+            const auto &nextGenonSettings = *input.nextGenon;
+            double nextTempo = aNextNote.hasTempo() ? aNextNote.tempo : aTempo;
+            auto nextGenon = getCorrectGenonSettings(
+                aNextNote.hasPreUtterance() ? aNextNote.preUttr : nextGenonSettings.preUtterance,
+                aNextNote.hasVoiceOverlap() ? aNextNote.overlap : nextGenonSettings.voiceOverlap,
+                aNextNote.realStartPoint(), aNextNote.realVelocity(),
+                Note::duration(aNextNote.length, nextTempo), prevDuration, prevIsRest);
+
+            int aNextNoteNum = aNextNote.noteNum;            // Note Num
+            aNextLength = aNextNote.length;                  // Length
+
+            aNextPreUttr = nextGenon.PreUtterance;           // PreUtterance
+            aNextOverlap = nextGenon.VoiceOverlap;           // Overlap
+
+            aNextPitch = aNextNote.portamento;               // Mode2 Pitch Control Points
+            aNextVibrato = getRawVibrato(aNextNote.vibrato); // Mode2 Vibrato
 
-            // Convert Mode2 to Mode1
-            std::vector<int> aPitchValues = UtaPitchCurves::convert_from_vector_point(
-                aTempo, aPitch, aVibrato, aPreUttr, aStartPoint, aLength, aNextPitch, aNextVibrato,
-                aNextPreUttr, aNextOverlap, aNextLength, aPrevPitch, aPrevVibrato, aPrevLength);
-
-            // Real Length
-            double aDuration = (double(aLength) / 480 * 60 / aTempo * 1000); // 由 ticks 换算长度
-            double aDurationFix = aPreUttr - aNextPreUttr + aNextOverlap;
-
-            double aRealLength = aDuration + aDurationFix + aStartPoint + 50;
-            aRealLength = (aRealLength < aGenon.consonant) ? aGenon.consonant : aRealLength;
-            aRealLength = int((aRealLength + 25) / 50) * 50;
-
-            // Cache Name
-            auto aToneName = toneNumToToneName(aNoteNum);
-            auto cacheName = to_string(i) + "_" + UtaTranslator::fixFilename(aLyric) + "_" +
-                             aToneName + "_" + to_string(aLength) + ".wav";
-
-            // COnstruct arguments
-            ResamplerArguments res;
-            res.sequence = i;
-            res.offset = aGenon.offset;
-            res.consonant = aGenon.consonant;
-            res.blank = aGenon.blank;
-            res.toneName = aToneName;
-            res.inFile = aGenon.fileName;
-            res.outFile = cacheName;
-            res.intensity = aIntensity;
-            res.modulation = aModulation;
-            res.velocity = aVelocity;
-            res.flags = UtaTranslator::fixFlags(globalFlags + aFlags);
-            res.tempo = aTempo;
-            res.pitchCurves = aPitchValues;
-            res.realLength = aRealLength;
-            res.correctPreUttr = aCorrect.PreUtterance;
-            res.correctOverlap = aCorrect.VoiceOverlap;
-            res.correctStp = aCorrect.StartPoint;
-
-            WavtoolArguments wav;
-            wav.inFile = cacheName;
-            wav.outFile = {};              // Later
-            wav.startPoint = aStartPoint;
-            wav.length = aLength;          // Out Duration Arg 1
-            wav.tempo = aTempo;            // Out Duration Arg 2
-            wav.correction = aDurationFix; // Out Duration Arg 3
-            wav.voiceOverlap = aOverlap;
-            wav.envelope = aEnvelope;
-
-            if (prevIsRest) {
-                wav.rest = true;
+            // Correct the y coordinate of first point
+            if (!aNextPitch.empty()) {
+                UtaTranslator::getCorrectPBSY(aNoteNum, aLyric, aNextNoteNum, aNextPitch.front());
             }
+        }
 
-            args.emplace_back(res, wav);
+        if (aPitch.empty()) {
+            aPitch = UtaTranslator::getDefaultPitch(aPrevNoteNum, *aPrevLyric, aNoteNum);
         }
 
-        return args;
+        // Convert Mode2 to Mode1
+        std::vector<int> aPitchValues = UtaPitchCurves::convert_from_vector_point(
+            aTempo, aPitch, aVibrato, aPreUttr, aStartPoint, aLength, aNextPitch, aNextVibrato,
+            aNextPreUttr, aNextOverlap, aNextLength, aPrevPitch, aPrevVibrato, aPrevLength);
+
+        // Real Length
+        double aDuration = (double(aLength) / 480 * 60 / aTempo * 1000); // 由 ticks 换算长度
+        double aDurationFix = aPreUttr - aNextPreUttr + aNextOverlap;
+
+        double aRealLength = aDuration + aDurationFix + aStartPoint + 50;
+        aRealLength = (aRealLength < aGenon.consonant) ? aGenon.consonant : aRealLength;
+        aRealLength = int((aRealLength + 25) / 50) * 50;
+
+        // Cache Name
+        auto aToneName = toneNumToToneName(aNoteNum);
+        auto cacheName = synthCacheName(i, aNote);
+
+        // COnstruct arguments
+        res = ResamplerArguments();
+        res.sequence = i;
+        res.offset = aGenon.offset;
+        res.consonant = aGenon.consonant;
+        res.blank = aGenon.blank;
+        res.toneName = aToneName;
+        res.inFile = aGenon.fileName;
+        res.outFile = cacheName;
+        res.intensity = aIntensity;
+        res.modulation = aModulation;
+        res.velocity = aVelocity;
+        res.flags = UtaTranslator::fixFlags(globalFlags + aFlags);
+        res.tempo = aTempo;
+        res.pitchCurves = std::move(aPitchValues);
+        res.realLength = aRealLength;
+        res.correctPreUttr = aCorrect.PreUtterance;
+        res.correctOverlap = aCorrect.VoiceOverlap;
+        res.correctStp = aCorrect.StartPoint;
+
+        wav = WavtoolArguments();
+        wav.inFile = cacheName;
+        wav.outFile = {};              // Later
+        wav.startPoint = aStartPoint;
+        wav.length = aLength;          // Out Duration Arg 1
+        wav.tempo = aTempo;            // Out Duration Arg 2
+        wav.correction = aDurationFix; // Out Duration Arg 3
+        wav.voiceOverlap = aOverlap;
+        wav.envelope = std::move(aEnvelope);
+
+        if (prevIsRest) {
+            wav.rest = true;
+        }
+    }
+
+    /*!
+        \internal
+
+        Returns the name of the resampler output of the note at \a index.
+    */
+    std::string synthCacheName(int index, const Note &note) {
+        return to_string(index) + "_" + UtaTranslator::fixFilename(note.lyric) + "_" +
+               toneNumToToneName(note.noteNum) + "_" + to_string(note.length) + ".wav";
     }
 
-}
\ No newline at end of file
+}
@@ -10,6 +10,8 @@
 
 namespace Utau {
 
+    class TempoMap;
+
     // resampler.exe <input wavfile> <output file> <pitch_percent> <velocity> [<flags> [<offset>
     // <length_require> [<fixed length> [<end_blank> [<volume> [<modulation> [<pich bend>...]]]]]]]
 
@@ -88,14 +90,59 @@ namespace Utau {
     struct STDUTAU_EXPORT Synth {
         using NoteGetter = std::function<Note(int)>;
         using GenonSettingsGetter = std::function<GenonSettings(const Note &)>;
+        using GenonSettingsResolver = std::function<const GenonSettings *(const Note &)>;
         using SynthParams = std::vector<std::pair<ResamplerArguments, WavtoolArguments>>;
 
         static SynthParams calc(const std::pair<int, int> &rangeLimits,
                                 const std::pair<int, int> &range, double initialTempo,
                                 const std::string &globalFlags, const NoteGetter &noteGetter,
                                 const GenonSettingsGetter &genonSettingsGetter);
+        static SynthParams calc(const std::pair<int, int> &rangeLimits,
+                                const std::pair<int, int> &range, double initialTempo,
+                                const std::string &globalFlags, const NoteGetter &noteGetter,
+                                const GenonSettingsGetter &genonSettingsGetter, int threadCount);
+
+        static SynthParams calc(const std::pair<int, int> &range, double initialTempo,
+                                const std::string &globalFlags, const Note *notes, int count,
+                                const GenonSettingsResolver &genonSettingsResolver);
+        static SynthParams calc(const std::pair<int, int> &range, double initialTempo,
+                                const std::string &globalFlags, const Note *notes, int count,
+                                const GenonSettingsResolver &genonSettingsResolver,
+                                int threadCount);
+        static SynthParams calc(const std::pair<int, int> &range, const TempoMap &tempoMap,
+                                const std::string &globalFlags, const Note *notes, int count,
+                                const GenonSettingsResolver &genonSettingsResolver,
+                                int threadCount = 1);
+        static inline SynthParams calc(const std::pair<int, int> &range, double initialTempo,
+                                       const std::string &globalFlags,
+                                       const std::vector<Note> &notes,
+                                       const GenonSettingsResolver &genonSettingsResolver,
+                                       int threadCount = 1);
+        static inline SynthParams calc(const std::pair<int, int> &range,
+                                       const TempoMap &tempoMap, const std::string &globalFlags,
+                                       const std::vector<Note> &notes,
+                                       const GenonSettingsResolver &genonSettingsResolver,
+                                       int threadCount = 1);
     };
 
+    inline Synth::SynthParams Synth::calc(const std::pair<int, int> &range, double initialTempo,
+                                          const std::string &globalFlags,
+                                          const std::vector<Note> &notes,
+                                          const GenonSettingsResolver &genonSettingsResolver,
+                                          int threadCount) {
+        return calc(range, initialTempo, globalFlags, notes.data(),
+                    static_cast<int>(notes.size()), genonSettingsResolver, threadCount);
+    }
+
+    inline Synth::SynthParams Synth::calc(const std::pair<int, int> &range,
+                                          const TempoMap &tempoMap, const std::string &globalFlags,
+                                          const std::vector<Note> &notes,
+                                          const GenonSettingsResolver &genonSettingsResolver,
+                                          int threadCount) {
+        return calc(range, tempoMap, globalFlags, notes.data(), static_cast<int>(notes.size()),
+                    genonSettingsResolver, threadCount);
+    }
+
 }
 
 #endif // SYNTH_H
@@ -0,0 +1,225 @@
+#include "synthplanner.h"
+
+#include <algorithm>
+#include <climits>
+#include <limits>
+
+#include "utautils.h"
+#include "private/synth_p.h"
+
+namespace Utau {
+
+    static constexpr const double UNKNOWN_TEMPO = std::numeric_limits<double>::quiet_NaN();
+
+    /*!
+        \class SynthPlanner
+        \brief Stateful synthesis calculation that only recalculates the edited notes.
+
+        The planner owns the notes and caches the arguments and genon settings of every note. The
+        arguments of a note depend on the previous two notes, the next note and the effective
+        tempo, so an edit only marks its neighbourhood dirty, and a changed tempo marks the notes
+        whose effective tempo has changed. Notes that only moved because of an insertion or removal
+        get their sequence numbers and cache names updated without recalculation.
+
+        The result is the same as Synth::calc() over all notes.
+
+        The editing functions do nothing if the index is out of range.
+    */
+
+    /*!
+        Constructor.
+    */
+    SynthPlanner::SynthPlanner()
+        : m_initialTempo(DEFAULT_VALUE_TEMPO), m_firstRenumbered(INT_MAX), m_lastUpdateCount(0) {
+    }
+
+    /*!
+        Constructor with the genon settings getter.
+    */
+    SynthPlanner::SynthPlanner(const Synth::GenonSettingsGetter &genonSettingsGetter)
+        : SynthPlanner() {
+        m_genonSettingsGetter = genonSettingsGetter;
+    }
+
+    /*!
+        Sets the tempo used before the first note with a tempo.
+    */
+    void SynthPlanner::setInitialTempo(double tempo) {
+        // The tempo propagation of the next update finds the affected notes
+        m_initialTempo = tempo;
+    }
+
+    /*!
+        Sets the flags prepended to the flags of every note.
+    */
+    void SynthPlanner::setGlobalFlags(const std::string &flags) {
+        if (flags == m_globalFlags) {
+            return;
+        }
+        m_globalFlags = flags;
+        markDirty(0, size() - 1);
+    }
+
+    /*!
+        Sets the genon settings getter, the cached genon settings are dropped.
+    */
+    void SynthPlanner::setGenonSettingsGetter(
+        const Synth::GenonSettingsGetter &genonSettingsGetter) {
+        m_genonSettingsGetter = genonSettingsGetter;
+        invalidate();
+    }
+
+    /*!
+        Replaces all notes.
+    */
+    void SynthPlanner::setNotes(const std::vector<Note> &notes) {
+        m_notes = notes;
+        m_states.assign(notes.size(), NoteState{UNKNOWN_TEMPO, true, false, {}});
+        m_params.assign(notes.size(), {});
+        m_firstRenumbered = INT_MAX;
+    }
+
+    /*!
+        Replaces the note at \a index.
+    */
+    void SynthPlanner::setNote(int index, const Note &note) {
+        if (index < 0 || index >= size()) {
+            return;
+        }
+        m_notes[index] = note;
+        m_states[index].genonValid = false;
+        markDirty(index - 1, index + 2);
+    }
+
+    /*!
+        Inserts a note before \a index.
+    */
+    void SynthPlanner::insertNote(int index, const Note &note) {
+        if (index < 0 || index > size()) {
+            return;
+        }
+        m_notes.insert(m_notes.begin() + index, note);
+        m_states.insert(m_states.begin() + index, NoteState{UNKNOWN_TEMPO, true, false, {}});
+        m_params.insert(m_params.begin() + index, Synth::SynthParams::value_type());
+        markDirty(index - 1, index + 2);
+        m_firstRenumbered = std::min(m_firstRenumbered, index + 1);
+    }
+
+    /*!
+        Removes the note at \a index.
+    */
+    void SynthPlanner::removeNote(int index) {
+        if (index < 0 || index >= size()) {
+            return;
+        }
+        m_notes.erase(m_notes.begin() + index);
+        m_states.erase(m_states.begin() + index);
+        m_params.erase(m_params.begin() + index);
+        markDirty(index - 1, index + 1);
+        m_firstRenumbered = std::min(m_firstRenumbered, index);
+    }
+
+    /*!
+        Marks all notes to be recalculated and drops the cached genon settings, call it after the
+        voicebank has changed.
+    */
+    void SynthPlanner::invalidate() {
+        for (auto &state : m_states) {
+            state.genonValid = false;
+        }
+        markDirty(0, size() - 1);
+    }
+
+    /*!
+        Recalculates the dirty notes.
+    */
+    void SynthPlanner::update() {
+        int count = size();
+        m_lastUpdateCount = 0;
+
+        // Tempo propagation, a note depends on its own tempo, the tempo of the previous note
+        // through its duration and the tempo of the next note
+        double tempo = m_initialTempo;
+        for (int i = 0; i < count; ++i) {
+            const auto &note = m_notes[i];
+            if (note.hasTempo()) {
+                tempo = note.tempo;
+            }
+            if (!(m_states[i].tempo == tempo)) {
+                m_states[i].tempo = tempo;
+                markDirty(i - 1, i + 1);
+            }
+        }
+
+        for (int i = 0; i < count; ++i) {
+            auto &state = m_states[i];
+            auto &item = m_params[i];
+            if (!state.dirty) {
+                if (i >= m_firstRenumbered) {
+                    auto cacheName = synthCacheName(i, m_notes[i]);
+                    item.first.sequence = i;
+                    item.first.outFile = cacheName;
+                    item.second.inFile = std::move(cacheName);
+                }
+                continue;
+            }
+
+            SynthNoteInput input;
+            input.index = i;
+            input.note = &m_notes[i];
+            input.genon = &genonAt(i);
+            input.tempo = state.tempo;
+            if (i > 0) {
+                const auto &prevNote = m_notes[i - 1];
+                input.prev = &prevNote;
+                input.prevDuration = Note::duration(prevNote.length, m_states[i - 1].tempo);
+                input.prevIsRest = isRestLyric(prevNote.lyric);
+            }
+            if (i > 1) {
+                input.prevPrev = &m_notes[i - 2];
+            }
+            if (i < count - 1) {
+                input.next = &m_notes[i + 1];
+                input.nextGenon = &genonAt(i + 1);
+            }
+            calcSynthNote(input, m_globalFlags, item.first, item.second);
+
+            state.dirty = false;
+            m_lastUpdateCount++;
+        }
+        m_firstRenumbered = INT_MAX;
+    }
+
+    /*!
+        Returns the arguments of all notes, the dirty notes are recalculated first.
+    */
+    const Synth::SynthParams &SynthPlanner::params() {
+        update();
+        return m_params;
+    }
+
+    /*!
+        \fn int SynthPlanner::lastUpdateCount() const
+
+        Returns the number of notes recalculated by the last update.
+    */
+
+    void SynthPlanner::markDirty(int first, int last) {
+        first = std::max(first, 0);
+        last = std::min(last, size() - 1);
+        for (int i = first; i <= last; ++i) {
+            m_states[i].dirty = true;
+        }
+    }
+
+    const GenonSettings &SynthPlanner::genonAt(int index) {
+        auto &state = m_states[index];
+        if (!state.genonValid) {
+            state.genon = m_genonSettingsGetter ? m_genonSettingsGetter(m_notes[index])
+                                                : GenonSettings();
+            state.genonValid = true;
+        }
+        return state.genon;
+    }
+
+}
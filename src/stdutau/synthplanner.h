@@ -0,0 +1,83 @@
+#ifndef SYNTHPLANNER_H
+#define SYNTHPLANNER_H
+
+#include <string>
+#include <vector>
+
+#include <stdutau/synth.h>
+
+namespace Utau {
+
+    class STDUTAU_EXPORT SynthPlanner {
+    public:
+        SynthPlanner();
+        explicit SynthPlanner(const Synth::GenonSettingsGetter &genonSettingsGetter);
+
+        inline double initialTempo() const;
+        void setInitialTempo(double tempo);
+
+        inline const std::string &globalFlags() const;
+        void setGlobalFlags(const std::string &flags);
+
+        void setGenonSettingsGetter(const Synth::GenonSettingsGetter &genonSettingsGetter);
+
+        inline const std::vector<Note> &notes() const;
+        inline int size() const;
+
+        void setNotes(const std::vector<Note> &notes);
+        void setNote(int index, const Note &note);
+        void insertNote(int index, const Note &note);
+        void removeNote(int index);
+
+        void invalidate();
+        void update();
+        const Synth::SynthParams &params();
+
+        inline int lastUpdateCount() const;
+
+    protected:
+        struct NoteState {
+            double tempo; // Effective tempo at the last update
+            bool dirty;   // Arguments need to be recalculated
+            bool genonValid;
+            GenonSettings genon;
+        };
+
+        std::vector<Note> m_notes;
+        std::vector<NoteState> m_states;
+        Synth::SynthParams m_params;
+
+        double m_initialTempo;
+        std::string m_globalFlags;
+        Synth::GenonSettingsGetter m_genonSettingsGetter;
+
+        int m_firstRenumbered; // Notes after it have moved, their sequence numbers are stale
+        int m_lastUpdateCount;
+
+        void markDirty(int first, int last);
+        const GenonSettings &genonAt(int index);
+    };
+
+    inline double SynthPlanner::initialTempo() const {
+        return m_initialTempo;
+    }
+
+    inline const std::string &SynthPlanner::globalFlags() const {
+        return m_globalFlags;
+    }
+
+    inline const std::vector<Note> &SynthPlanner::notes() const {
+        return m_notes;
+    }
+
+    inline int SynthPlanner::size() const {
+        return static_cast<int>(m_notes.size());
+    }
+
+    inline int SynthPlanner::lastUpdateCount() const {
+        return m_lastUpdateCount;
+    }
+
+}
+
+#endif // SYNTHPLANNER_H
@@ -0,0 +1,136 @@
+#include "tempomap.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Utau {
+
+    /*!
+        \class TempoMap
+        \brief Tempo segments of a note sequence for tick and time conversion.
+
+        The map is built once from the notes, every tempo change starts a new segment that
+        stores its first note, tick and time in milliseconds. Queries by note index, tick or time
+        are binary searches over the segments, and ticks out of the notes are extrapolated with
+        the tempo of the nearest segment.
+    */
+
+    /*!
+        Constructs an empty map with the default tempo.
+    */
+    TempoMap::TempoMap() {
+        clear();
+    }
+
+    /*!
+        Constructs the map of the notes, \a initialTempo is the tempo before the first note.
+    */
+    TempoMap::TempoMap(const Note *notes, int count, double initialTempo) {
+        build(notes, count, initialTempo);
+    }
+
+    /*!
+        Rebuilds the map from the notes, \a initialTempo is the tempo before the first note.
+    */
+    void TempoMap::build(const Note *notes, int count, double initialTempo) {
+        m_initialTempo = initialTempo;
+        m_segments.clear();
+        m_segments.push_back({0, 0, 0, initialTempo});
+
+        count = std::max(0, count);
+        m_noteTicks.resize(count + 1);
+
+        int tick = 0;
+        for (int i = 0; i < count; ++i) {
+            const auto &note = notes[i];
+            if (note.hasTempo() && note.tempo != m_segments.back().tempo) {
+                const auto &last = m_segments.back();
+                if (last.note == i) {
+                    // The first note replaces the initial tempo
+                    m_segments.back().tempo = note.tempo;
+                } else {
+                    m_segments.push_back({i, tick, last.time + Note::duration(tick - last.tick,
+                                                                              last.tempo),
+                                          note.tempo});
+                }
+            }
+            m_noteTicks[i] = tick;
+            tick += note.length;
+        }
+        m_noteTicks[count] = tick;
+    }
+
+    /*!
+        Removes all notes and resets the tempo to the default.
+    */
+    void TempoMap::clear() {
+        m_initialTempo = DEFAULT_VALUE_TEMPO;
+        m_segments.assign(1, {0, 0, 0, DEFAULT_VALUE_TEMPO});
+        m_noteTicks.assign(1, 0);
+    }
+
+    /*!
+        Returns the effective tempo of the note, which is the last tempo set at or before it.
+
+        A negative index gives the initial tempo, even if the first note replaces it.
+    */
+    double TempoMap::tempoAt(int noteIndex) const {
+        return noteIndex < 0 ? m_initialTempo : segmentAtNote(noteIndex).tempo;
+    }
+
+    /*!
+        Returns the tempo at the tick.
+    */
+    double TempoMap::tempoAtTick(int tick) const {
+        return segmentAtTick(tick).tempo;
+    }
+
+    /*!
+        Returns the index of the note that is played at the tick, or -1 if the tick is out of the
+        notes.
+    */
+    int TempoMap::noteAtTick(int tick) const {
+        if (tick < 0 || tick >= m_noteTicks.back()) {
+            return -1;
+        }
+        auto it = std::upper_bound(m_noteTicks.begin(), m_noteTicks.end(), tick);
+        return static_cast<int>(it - m_noteTicks.begin()) - 1;
+    }
+
+    /*!
+        Converts the absolute tick to milliseconds.
+    */
+    double TempoMap::tickToTime(int tick) const {
+        const auto &seg = segmentAtTick(tick);
+        return seg.time + Note::duration(tick - seg.tick, seg.tempo);
+    }
+
+    /*!
+        Converts the milliseconds to the absolute tick, rounded down to a whole tick.
+    */
+    int TempoMap::timeToTick(double time) const {
+        auto it = std::upper_bound(
+            m_segments.begin() + 1, m_segments.end(), time,
+            [](double time, const Segment &seg) -> bool { return time < seg.time; });
+        const auto &seg = *(it - 1);
+
+        // Tolerate the rounding error of a round trip through tickToTime()
+        double ticks = (time - seg.time) * seg.tempo / 125.0;
+        return seg.tick + static_cast<int>(std::floor(ticks + 1e-6));
+    }
+
+    const TempoMap::Segment &TempoMap::segmentAtNote(int noteIndex) const {
+        auto it = std::upper_bound(
+            m_segments.begin() + 1, m_segments.end(), noteIndex,
+            [](int noteIndex, const Segment &seg) -> bool { return noteIndex < seg.note; });
+        return *(it - 1);
+    }
+
+    const TempoMap::Segment &TempoMap::segmentAtTick(int tick) const {
+        auto it = std::upper_bound(
+            m_segments.begin() + 1, m_segments.end(), tick,
+            [](int tick, const Segment &seg) -> bool { return tick < seg.tick; });
+        return *(it - 1);
+    }
+
+}
@@ -0,0 +1,86 @@
+#ifndef TEMPOMAP_H
+#define TEMPOMAP_H
+
+#include <vector>
+
+#include <stdutau/note.h>
+
+namespace Utau {
+
+    class STDUTAU_EXPORT TempoMap {
+    public:
+        TempoMap();
+        TempoMap(const Note *notes, int count, double initialTempo);
+        inline TempoMap(const std::vector<Note> &notes, double initialTempo);
+
+        void build(const Note *notes, int count, double initialTempo);
+        inline void build(const std::vector<Note> &notes, double initialTempo);
+        void clear();
+
+        inline int noteCount() const;
+        inline int segmentCount() const;
+
+        double tempoAt(int noteIndex) const;
+        double tempoAtTick(int tick) const;
+
+        inline int noteTick(int noteIndex) const;
+        inline double noteTime(int noteIndex) const;
+        int noteAtTick(int tick) const;
+        inline int totalTicks() const;
+        inline double totalTime() const;
+
+        double tickToTime(int tick) const;
+        int timeToTick(double time) const;
+
+    protected:
+        // A run of notes sharing the same tempo
+        struct Segment {
+            int note; // First note
+            int tick;
+            double time;
+            double tempo;
+        };
+
+        double m_initialTempo; // Tempo before the first note, which it may replace
+        std::vector<Segment> m_segments;
+        std::vector<int> m_noteTicks; // Start tick of every note and the end tick
+
+        const Segment &segmentAtNote(int noteIndex) const;
+        const Segment &segmentAtTick(int tick) const;
+    };
+
+    inline TempoMap::TempoMap(const std::vector<Note> &notes, double initialTempo)
+        : TempoMap(notes.data(), static_cast<int>(notes.size()), initialTempo) {
+    }
+
+    inline void TempoMap::build(const std::vector<Note> &notes, double initialTempo) {
+        build(notes.data(), static_cast<int>(notes.size()), initialTempo);
+    }
+
+    inline int TempoMap::noteCount() const {
+        return static_cast<int>(m_noteTicks.size()) - 1;
+    }
+
+    inline int TempoMap::segmentCount() const {
+        return static_cast<int>(m_segments.size());
+    }
+
+    inline int TempoMap::noteTick(int noteIndex) const {
+        return m_noteTicks[noteIndex];
+    }
+
+    inline double TempoMap::noteTime(int noteIndex) const {
+        return tickToTime(m_noteTicks[noteIndex]);
+    }
+
+    inline int TempoMap::totalTicks() const {
+        return m_noteTicks.back();
+    }
+
+    inline double TempoMap::totalTime() const {
+        return tickToTime(m_noteTicks.back());
+    }
+
+}
+
+#endif // TEMPOMAP_H
@@ -2,9 +2,14 @@
 
 #include <fstream>
 #include <algorithm>
+#include <stdexcept>
+#include <utility>
 
 #include "utautils.h"
 #include "private/usthelper_p.h"
+#include "private/mappedfile_p.h"
+#include "private/parallel_p.h"
+#include "private/sharedhelper_p.h"
 
 namespace Utau {
 
@@ -19,6 +24,104 @@ namespace Utau {
         return note;
     }
 
+    static inline std::pmr::memory_resource *resourceOf(const UstReadOptions &options) {
+        return options.memoryResource ? options.memoryResource : std::pmr::get_default_resource();
+    }
+
+    // Parses the version and settings sections, and collects the note sections for a later pass
+    static void scanNoteSections(const std::string_view &data, bool stripCR, UstVersion &version,
+                                 UstSettings &settings,
+                                 std::pmr::vector<std::string_view> &lines,
+                                 std::pmr::vector<SectionSpan> &sections,
+                                 std::pmr::vector<const SectionSpan *> &noteSections) {
+        scanSections(data, stripCR, lines, sections);
+        for (const auto &section : std::as_const(sections)) {
+            SectionView sectionList(lines.data() + section.first, lines.data() + section.last);
+            if (section.name == SECTION_NAME_VERSION) {
+                parseSectionVersion(sectionList, version);
+            } else if (section.name == SECTION_NAME_SETTING) {
+                parseSectionSettings(sectionList, settings);
+            } else if (isNoteSectionName(section.name)) {
+                noteSections.push_back(&section);
+            }
+        }
+    }
+
+    // Writes the version and settings sections, the notes written by writeNote(index, out) and
+    // the end sign
+    template <class WriteNote>
+    static bool writeSections(std::ostream &os, const UstVersion &version,
+                              const UstSettings &settings, int count, WriteNote &&writeNote) {
+        TextBuffer out;
+        out.reserve(TextBuffer::BLOCK_SIZE + 4096);
+
+        writeSectionVersion(version, out);   // Write Version
+        writeSectionSettings(settings, out); // Write Global Settings
+
+        if (!out.flushBlock(os))
+            return false;
+
+        // Write Notes
+        for (int i = 0; i < count; ++i) {
+            writeNote(i, out);
+            if (!out.flushBlock(os))
+                return false;
+        }
+
+        writeSectionName(SECTION_NAME_TRACKEND, out); // Write End Sign
+        if (!out.flush(os))
+            return false;
+        return true;
+    }
+
+    // Parses the version and settings sections, and each note section into a copy of the
+    // initial slot with parseNote(sectionList, slot), then passes the slots to addSlot(slot) in
+    // file order. The note sections are parsed concurrently if the thread count is not 1.
+    template <class Slot, class ParseNote, class AddSlot>
+    static void parseSections(const std::string_view &data, bool stripCR,
+                              const UstReadOptions &options, UstVersion &version,
+                              UstSettings &settings, const Slot &initialSlot,
+                              ParseNote &&parseNote, AddSlot &&addSlot) {
+        auto resource = resourceOf(options);
+        if (options.threadCount == 1) {
+            readSections(data, stripCR, [&](const std::string_view &sectionName,
+                                            const SectionView &sectionList) {
+                if (sectionName == SECTION_NAME_VERSION) {
+                    // Parse Version Sequence
+                    parseSectionVersion(sectionList, version);
+                } else if (sectionName == SECTION_NAME_SETTING) {
+                    // Parse global settings
+                    parseSectionSettings(sectionList, settings);
+                } else if (isNoteSectionName(sectionName)) {
+                    // Parse Note (Name should be numeric)
+                    Slot slot = initialSlot;
+                    parseNote(sectionList, slot);
+                    addSlot(slot);
+                }
+            }, resource);
+            return;
+        }
+
+        // Phase 1: find all section boundaries
+        std::pmr::vector<std::string_view> lines(resource);
+        std::pmr::vector<SectionSpan> sections(resource);
+        std::pmr::vector<const SectionSpan *> noteSections(resource);
+        scanNoteSections(data, stripCR, version, settings, lines, sections, noteSections);
+
+        // Phase 2: parse notes into preallocated slots
+        std::pmr::vector<Slot> slots(noteSections.size(), initialSlot, resource);
+        parallelFor(int(noteSections.size()), options.threadCount, 64, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                const auto &section = *noteSections[i];
+                parseNote(SectionView(lines.data() + section.first, lines.data() + section.last),
+                          slots[i]);
+            }
+        });
+        for (auto &slot : slots) {
+            addSlot(slot);
+        }
+    }
+
     /*!
         \struct UstVersion
         \brief Structure that represents the version section in ust file.
@@ -41,6 +144,45 @@ namespace Utau {
 
         The string data in this class is pure bytes, please perform appropriate encoding speculation
         and conversion when accessing.
+
+        The note list always holds every note of the file completely decoded, the lazy and
+        compact pitch read options only apply to LazyUstFile.
+    */
+
+    /*!
+        \class UstReadOptions
+        \brief Options of reading ust files from memory.
+
+        If \c threadCount is not \c 1, the note sections are parsed concurrently after a boundary
+        scan of the whole buffer, a non-positive value uses one thread per hardware thread.
+
+        If \c lazy is \c true, LazyUstFile keeps the Mode1 pitches, Mode2 pitch points, vibrato
+        and envelope of the notes as raw text and decodes them on first access through
+        LazyUstFile::note(). UstFile always decodes them.
+
+        If \c memoryResource is not null, the buffers that only live during the parsing, such as
+        the section lines, are allocated from it. UstFile::read() ignores it for the resulting
+        notes, which always use the default allocator since \c Note has standard containers.
+        Only reading into a NoteTable that is constructed with the same resource keeps the whole
+        project in it, e.g. in a \c std::pmr::monotonic_buffer_resource that is released at
+        once. The same holds for \c oto.ini files with OtoIni::readTable() and OtoTable.
+
+        If \c compactPitches is \c true, LazyUstFile keeps the Mode1 pitches that are integers in
+        range as a PitchArray instead of \c Note::pitches until first access through
+        LazyUstFile::note(), the others are decoded as usual. LazyUstFile::pitches() and
+        LazyUstFile::pitchArray() read them without expanding. UstFile always decodes them.
+
+        If \c unknownKeyHandler is set, it is called with the note and the key and value of each
+        line of a note section that the parser does not know, e.g. to keep the keys of a plugin
+        in \c Note::userData. The note is still being parsed, so the fields of the later lines
+        are not set yet. If \c threadCount is not \c 1, the handler is called concurrently for
+        different notes.
+    */
+
+    /*!
+        \fn inline UstReadOptions::UstReadOptions()
+
+        Constructor.
     */
 
     /*!
@@ -48,87 +190,491 @@ namespace Utau {
     */
     UstFile::UstFile() = default;
 
+    /*!
+        Maps the specific file into memory and reads it without copying lines, returns \c true if
+        success.
+    */
+    bool UstFile::loadMapped(const std::filesystem::path &path, const UstReadOptions &options) {
+        MappedFile file;
+        if (!file.open(path))
+            return false;
+
+#ifdef _WIN32
+        // Keep the same line endings as a text mode file stream
+        parseData(file.data(), true, options);
+#else
+        parseData(file.data(), false, options);
+#endif
+        return true;
+    }
+
     /*!
         Reads \c ust sections from stream, returns \c true if success.
     */
     bool UstFile::read(std::istream &is) {
-        // Read File
-        std::vector<std::string> currentSection;
+        return read(is, {});
+    }
 
-        std::string line;
-        while (std::getline(is, line)) {
-            if (line.empty() && !is.eof()) {
-                continue;
-            }
+    /*!
+        Reads \c ust sections from stream with the given options, returns \c true if success.
+    */
+    bool UstFile::read(std::istream &is, const UstReadOptions &options) {
+        std::pmr::string data(resourceOf(options));
+        if (!readStreamData(is, data))
+            return false;
+        parseData(data, false, options);
+        return true;
+    }
 
-            // Continue to add until meet the start of section or end
-            if (!starts_with(line, SECTION_BEGIN_MARK) && !is.eof()) {
-                currentSection.push_back(line);
-                continue;
-            }
+    /*!
+        Reads \c ust sections from the buffer, returns \c true if success.
+    */
+    bool UstFile::read(const std::string_view &data, const UstReadOptions &options) {
+        parseData(data, false, options);
+        return true;
+    }
 
-            // If meet end, append without continue
-            if (!line.empty() && is.eof()) {
-                currentSection.push_back(line);
-            }
+    void UstFile::parseData(const std::string_view &data, bool stripCR,
+                            const UstReadOptions &options) {
+        const auto &handler = options.unknownKeyHandler;
+        parseSections(
+            data, stripCR, options, version, settings, createInitialNote(),
+            [&handler](const SectionView &sectionList, Note &note) {
+                parseSectionNote(sectionList, note, handler);
+            },
+            [this](Note &note) {
+                // Ignore note whose length is invalid
+                if (note.length > 0) {
+                    notes.push_back(std::move(note));
+                }
+            });
+    }
 
-            // Previous section is empty
-            if (currentSection.size() <= 1) {
-                // ...
-            } else {
-                const auto &sectionHead = currentSection[0];
+    /*!
+        Writes \c ust sections to stream, returns \c true if success.
+    */
+    bool UstFile::write(std::ostream &os) const {
+        return writeSections(os, version, settings, int(notes.size()),
+                             [this](int i, TextBuffer &out) {
+                                 writeSectionNote(i, notes[i], out); // Write Note
+                             });
+    }
 
-                // If Section Name is invalid
-                std::string_view sectionName;
-                if (!parseSectionName(sectionHead, sectionName)) {
-                    currentSection.clear();
-                    continue;
-                }
+    /*!
+        Reads \c ust sections from the buffer, the version and settings are stored in this file
+        and the notes are appended to \a table instead of the note list, returns \c true if
+        success. The unused capacity of the table is released after reading.
+    */
+    bool UstFile::readTable(const std::string_view &data, NoteTable &table,
+                            const UstReadOptions &options) {
+        parseTable(data, false, options, table);
+        return true;
+    }
+
+    /*!
+        \overload
 
+        Reads from stream.
+    */
+    bool UstFile::readTable(std::istream &is, NoteTable &table, const UstReadOptions &options) {
+        std::pmr::string data(resourceOf(options));
+        if (!readStreamData(is, data))
+            return false;
+        parseTable(data, false, options, table);
+        return true;
+    }
+
+    /*!
+        Writes \c ust sections to stream with the version and settings of this file and the notes
+        of \a table, returns \c true if success.
+    */
+    bool UstFile::writeTable(std::ostream &os, const NoteTable &table) const {
+        Note note;
+        return writeSections(os, version, settings, table.size(), [&](int i, TextBuffer &out) {
+            table.toNote(i, note);
+            writeSectionNote(i, note, out);
+        });
+    }
+
+    void UstFile::parseTable(const std::string_view &data, bool stripCR,
+                             const UstReadOptions &options, NoteTable &table) {
+        const auto initialNote = createInitialNote();
+        auto resource = resourceOf(options);
+
+        if (options.threadCount == 1) {
+            Note note; // Reused, the strings and vectors keep their capacity
+            readSections(data, stripCR, [&](const std::string_view &sectionName,
+                                            const SectionView &sectionList) {
                 if (sectionName == SECTION_NAME_VERSION) {
-                    // Parse Version Sequence
-                    parseSectionVersion(currentSection, version);
+                    parseSectionVersion(sectionList, version);
                 } else if (sectionName == SECTION_NAME_SETTING) {
-                    // Parse global settings
-                    parseSectionSettings(currentSection, settings);
-                } else if (std::all_of(sectionName.begin(), sectionName.end(), ::isdigit)) {
-                    // Parse Note (Name should be numeric)
-                    auto note = createInitialNote();
-                    parseSectionNote(currentSection, note);
-                    // Ignore note whose length is invalid
+                    parseSectionSettings(sectionList, settings);
+                } else if (isNoteSectionName(sectionName)) {
+                    note = initialNote;
+                    parseSectionNote(sectionList, note, options.unknownKeyHandler);
                     if (note.length > 0) {
-                        notes.push_back(note);
+                        table.append(note);
                     }
                 }
-            }
+            }, resource);
+            table.squeeze();
+            return;
+        }
+
+        std::pmr::vector<std::string_view> lines(resource);
+        std::pmr::vector<SectionSpan> sections(resource);
+        std::pmr::vector<const SectionSpan *> noteSections(resource);
+        scanNoteSections(data, stripCR, version, settings, lines, sections, noteSections);
 
-            currentSection.clear();
-            currentSection.push_back(line);
+        // Parse the notes block by block, so only one block is held as note objects
+        static constexpr const int BLOCK = 4096;
+        int count = int(noteSections.size());
+        table.reserve(table.size() + count);
+        std::pmr::vector<Note> slots(std::min(count, BLOCK), resource);
+        for (int first = 0; first < count; first += BLOCK) {
+            int blockCount = std::min(BLOCK, count - first);
+            parallelFor(blockCount, options.threadCount, 64, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i) {
+                    const auto &section = *noteSections[first + i];
+                    slots[i] = initialNote;
+                    parseSectionNote(
+                        SectionView(lines.data() + section.first, lines.data() + section.last),
+                        slots[i], options.unknownKeyHandler);
+                }
+            });
+            for (int i = 0; i < blockCount; ++i) {
+                if (slots[i].length > 0) {
+                    table.append(slots[i]);
+                }
+            }
         }
-        return true;
+        table.squeeze();
     }
 
     /*!
-        Writes \c ust sections to stream, returns \c true if success.
+        \class LazyUstFile
+        \brief UTAU sequence text file(*.ust) reader and writer that decodes notes on demand.
+
+        With the lazy or compact pitch read options, the expensive fields of the notes are kept
+        undecoded until a note is accessed through note(), see UstReadOptions. peekNote() reads the
+        cheap fields of a note without decoding it, and write() writes the undecoded fields as
+        they are. The raw text is released once every note is decoded.
+
+        The notes are only reachable through the accessors, use toUstFile() to get a UstFile
+        whose note list holds every note decoded. Copies share the undecoded notes until one of
+        them is modified.
     */
-    bool UstFile::write(std::ostream &os) const {
-        writeSectionVersion(version, os);   // Write Version
-        writeSectionSettings(settings, os); // Write Global Settings
 
-        if (!os.good())
+    struct LazyUstFile::Data {
+        enum : unsigned char {
+            RawFields = 1,      // Pitch points, Mode1 pitches, vibrato and envelope as raw text
+            CompactPitches = 2, // Mode1 pitches as a PitchArray
+        };
+
+        struct Item {
+            inline explicit Item(Note note) : note(std::move(note)) {
+            }
+
+            Note note;
+            NoteRawFields raw;       // Valid if the note has raw fields
+            PitchArray pitches;      // Valid if the note has compact pitches
+            unsigned char flags = 0; // Pending data of the note
+        };
+
+        std::vector<std::shared_ptr<const void>> owners; // Keep the raw text alive
+        std::vector<Item> items;
+        std::size_t pendingCount = 0; // Notes with pending data
+
+        static inline const PitchArray *compactPitches(const Item &item) {
+            return (item.flags & CompactPitches) ? &item.pitches : nullptr;
+        }
+
+        // Decodes the pending data of an item into \a note
+        static void decode(const Item &item, Note &note) {
+            if (item.flags & RawFields) {
+                decodeNoteRawFields(item.raw, note);
+            }
+            if (item.flags & CompactPitches) {
+                item.pitches.toDoubles(note.pitches);
+            }
+        }
+
+        // Decodes the pending data of an item in place
+        void decode(Item &item) {
+            if (!item.flags) {
+                return;
+            }
+            decode(item, item.note);
+            item.raw = {};
+            item.pitches.clear();
+            item.flags = 0;
+            notePendingDone();
+        }
+
+        inline void notePendingDone() {
+            if (--pendingCount == 0) {
+                owners.clear(); // Release the raw text
+            }
+        }
+    };
+
+    /*!
+        Constructor.
+    */
+    LazyUstFile::LazyUstFile() : m_data(std::make_shared<Data>()) {
+    }
+
+    /*!
+        Maps the specific file into memory and reads it, returns \c true if success.
+
+        In lazy mode the mapped bytes are copied, since the raw text must outlive the mapping,
+        e.g. when the file is saved to the same path.
+    */
+    bool LazyUstFile::loadMapped(const std::filesystem::path &path,
+                                 const UstReadOptions &options) {
+        MappedFile file;
+        if (!file.open(path))
             return false;
 
-        // Write Notes
-        for (int i = 0; i < notes.size(); ++i) {
-            writeSectionNote(i, notes.at(i), os);
-            if (!os.good())
-                return false;
+#ifdef _WIN32
+        // Keep the same line endings as a text mode file stream
+        bool stripCR = true;
+#else
+        bool stripCR = false;
+#endif
+        if (options.lazy) {
+            auto copy = std::make_shared<std::string>(file.data());
+            file.close();
+            parseData(*copy, stripCR, options, copy);
+            return true;
         }
+        parseData(file.data(), stripCR, options, {});
+        return true;
+    }
+
+    /*!
+        Reads \c ust sections from stream, returns \c true if success.
+    */
+    bool LazyUstFile::read(std::istream &is) {
+        return read(is, {});
+    }
 
-        writeSectionName(SECTION_NAME_TRACKEND, os); // Write End Sign
-        if (!os.good())
+    /*!
+        Reads \c ust sections from stream with the given options, returns \c true if success.
+    */
+    bool LazyUstFile::read(std::istream &is, const UstReadOptions &options) {
+        auto data = std::make_shared<std::string>();
+        if (!readStreamData(is, *data))
             return false;
+        parseData(*data, false, options, data);
+        return true;
+    }
+
+    /*!
+        Reads \c ust sections from the buffer, returns \c true if success.
+
+        In lazy mode the buffer is copied, since the raw text must outlive the call.
+    */
+    bool LazyUstFile::read(const std::string_view &data, const UstReadOptions &options) {
+        if (options.lazy) {
+            auto copy = std::make_shared<std::string>(data);
+            parseData(*copy, false, options, copy);
+            return true;
+        }
+        parseData(data, false, options, {});
         return true;
     }
 
-}
\ No newline at end of file
+    /*!
+        Writes \c ust sections to stream without decoding the notes, returns \c true if success.
+    */
+    bool LazyUstFile::write(std::ostream &os) const {
+        Note decoded; // Reused
+        return writeSections(os, version, settings, noteCount(), [&](int i, TextBuffer &out) {
+            // Compact pitches are written as they are
+            const auto &item = m_data->items[i];
+            auto pitches = Data::compactPitches(item);
+            if (item.flags & Data::RawFields) {
+                // Decode a copy, the file stays lazy
+                decoded = item.note;
+                decodeNoteRawFields(item.raw, decoded);
+                writeSectionNote(i, decoded, out, pitches);
+            } else {
+                writeSectionNote(i, item.note, out, pitches);
+            }
+        });
+    }
+
+    /*!
+        Returns the number of notes.
+    */
+    int LazyUstFile::noteCount() const {
+        return int(m_data->items.size());
+    }
+
+    /*!
+        Returns the note at the given index, the note is decoded first, after which it is a
+        complete note that may be edited through the reference.
+    */
+    Note &LazyUstFile::note(int index) {
+        m_data->items.at(index); // Check the index
+        detach_shared_ptr(m_data);
+        auto &item = m_data->items[index];
+        m_data->decode(item);
+        return item.note;
+    }
+
+    /*!
+        Returns the note at the given index without decoding it.
+
+        If the note is not decoded yet, its Mode1 pitches, Mode2 pitch points, vibrato and
+        envelope are empty, read them through note() or pitches().
+    */
+    const Note &LazyUstFile::peekNote(int index) const {
+        return m_data->items.at(index).note;
+    }
+
+    /*!
+        Returns the Mode1 pitches of the note at the given index without decoding the note.
+    */
+    std::vector<double> LazyUstFile::pitches(int index) const {
+        const auto &item = m_data->items.at(index);
+        if (auto compact = Data::compactPitches(item)) {
+            return compact->toDoubles();
+        }
+        if ((item.flags & Data::RawFields) && item.raw.pitches.data()) {
+            std::vector<double> res;
+            doublesFromString(item.raw.pitches, res);
+            return res;
+        }
+        return item.note.pitches;
+    }
+
+    /*!
+        Returns the compact Mode1 pitches of the note at the given index, or \c nullptr if the
+        note is decoded or its pitches are not kept compact.
+    */
+    const PitchArray *LazyUstFile::pitchArray(int index) const {
+        return Data::compactPitches(m_data->items.at(index));
+    }
+
+    /*!
+        Returns \c true if the note at the given index has no undecoded data.
+    */
+    bool LazyUstFile::isDecoded(int index) const {
+        return !m_data->items.at(index).flags;
+    }
+
+    /*!
+        Returns \c true if no note has undecoded data.
+    */
+    bool LazyUstFile::isDecoded() const {
+        return m_data->pendingCount == 0;
+    }
+
+    /*!
+        Appends a note after all notes.
+    */
+    void LazyUstFile::appendNote(Note note) {
+        detach_shared_ptr(m_data);
+        m_data->items.emplace_back(std::move(note));
+    }
+
+    /*!
+        Inserts a note before the note at the given index, the index may be noteCount().
+    */
+    void LazyUstFile::insertNote(int index, Note note) {
+        if (index < 0 || index > noteCount()) {
+            throw std::out_of_range("LazyUstFile::insertNote");
+        }
+        detach_shared_ptr(m_data);
+        m_data->items.emplace(m_data->items.begin() + index, std::move(note));
+    }
+
+    /*!
+        Removes the note at the given index.
+    */
+    void LazyUstFile::removeNote(int index) {
+        bool pending = !isDecoded(index); // Check the index
+        detach_shared_ptr(m_data);
+        m_data->items.erase(m_data->items.begin() + index);
+        if (pending) {
+            m_data->notePendingDone();
+        }
+    }
+
+    /*!
+        Decodes all notes and releases the raw text.
+    */
+    void LazyUstFile::decode() {
+        if (isDecoded()) {
+            return;
+        }
+        detach_shared_ptr(m_data);
+        for (auto &item : m_data->items) {
+            m_data->decode(item);
+        }
+    }
+
+    /*!
+        Returns a file with the same version and settings whose note list holds every note
+        decoded, this file is not modified.
+    */
+    UstFile LazyUstFile::toUstFile() const {
+        UstFile res;
+        res.version = version;
+        res.settings = settings;
+        res.notes.reserve(m_data->items.size());
+        for (const auto &item : m_data->items) {
+            res.notes.push_back(item.note);
+            Data::decode(item, res.notes.back());
+        }
+        return res;
+    }
+
+    void LazyUstFile::parseData(const std::string_view &data, bool stripCR,
+                                const UstReadOptions &options,
+                                const std::shared_ptr<const void> &owner) {
+        bool lazy = options.lazy && owner;
+        bool compact = options.compactPitches;
+        detach_shared_ptr(m_data);
+        if (lazy) {
+            m_data->owners.push_back(owner);
+        }
+
+        Data::Item initialItem(createInitialNote());
+        const auto &handler = options.unknownKeyHandler;
+        parseSections(
+            data, stripCR, options, version, settings, initialItem,
+            [lazy, compact, &handler](const SectionView &sectionList, Data::Item &item) {
+                parseSectionNoteRaw(sectionList, item.note, item.raw, handler);
+                if (compact && item.raw.pitches.data() && item.pitches.parse(item.raw.pitches)) {
+                    item.raw.pitches = {};
+                    if (!item.pitches.empty()) {
+                        item.flags |= Data::CompactPitches;
+                    }
+                }
+                if (lazy) {
+                    item.flags |= Data::RawFields;
+                } else {
+                    decodeNoteRawFields(item.raw, item.note);
+                    item.raw = {};
+                }
+            },
+            [this](Data::Item &item) {
+                // Ignore note whose length is invalid
+                if (item.note.length <= 0) {
+                    return;
+                }
+                if (item.flags) {
+                    m_data->pendingCount++;
+                }
+                m_data->items.push_back(std::move(item));
+            });
+
+        if (m_data->pendingCount == 0) {
+            m_data->owners.clear();
+        }
+    }
+
+}
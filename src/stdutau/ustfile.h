@@ -4,12 +4,18 @@
 #include <array>
 #include <map>
 #include <string>
+#include <string_view>
 #include <optional>
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <vector>
 #include <filesystem>
 
 #include <stdutau/utafilebase.h>
 #include <stdutau/note.h>
+#include <stdutau/pitcharray.h>
+#include <stdutau/notetable.h>
 
 namespace Utau {
 
@@ -43,17 +49,96 @@ namespace Utau {
     inline UstSettings::UstSettings() : tempo(DEFAULT_VALUE_TEMPO), isMode2(false) {
     }
 
+    // Called with the note being parsed and each key of its section that the parser does not know
+    using UnknownKeyHandler =
+        std::function<void(Note &note, const std::string_view &key, const std::string_view &value)>;
+
+    class UstReadOptions {
+    public:
+        inline UstReadOptions();
+
+    public:
+        int threadCount; // 1 for sequential, non-positive for one per hardware thread
+        bool lazy;       // LazyUstFile only, decode pitch, vibrato and envelope on first access
+        bool compactPitches; // LazyUstFile only, keep Mode1 pitches as 16-bit integers
+
+        // Resource of the temporary parsing buffers, null for the default resource, read() still
+        // allocates the notes from the default resource, readTable() uses the table's resource
+        std::pmr::memory_resource *memoryResource;
+
+        UnknownKeyHandler unknownKeyHandler;
+    };
+
+    inline UstReadOptions::UstReadOptions()
+        : threadCount(1), lazy(false), compactPitches(false), memoryResource(nullptr) {
+    }
+
     class STDUTAU_EXPORT UstFile : public UtaFileBase {
     public:
         UstFile();
 
+        bool loadMapped(const std::filesystem::path &path,
+                        const UstReadOptions &options = UstReadOptions());
+
         bool read(std::istream &is) override;
+        bool read(std::istream &is, const UstReadOptions &options);
+        bool read(const std::string_view &data, const UstReadOptions &options = UstReadOptions());
         bool write(std::ostream &os) const override;
 
+        bool readTable(const std::string_view &data, NoteTable &table,
+                       const UstReadOptions &options = UstReadOptions());
+        bool readTable(std::istream &is, NoteTable &table,
+                       const UstReadOptions &options = UstReadOptions());
+        bool writeTable(std::ostream &os, const NoteTable &table) const;
+
     public:
         UstVersion version;
         UstSettings settings;
         std::vector<Note> notes;
+
+    protected:
+        void parseData(const std::string_view &data, bool stripCR, const UstReadOptions &options);
+        void parseTable(const std::string_view &data, bool stripCR, const UstReadOptions &options,
+                        NoteTable &table);
+    };
+
+    class STDUTAU_EXPORT LazyUstFile : public UtaFileBase {
+    public:
+        LazyUstFile();
+
+        bool loadMapped(const std::filesystem::path &path,
+                        const UstReadOptions &options = UstReadOptions());
+
+        bool read(std::istream &is) override;
+        bool read(std::istream &is, const UstReadOptions &options);
+        bool read(const std::string_view &data, const UstReadOptions &options = UstReadOptions());
+        bool write(std::ostream &os) const override;
+
+        int noteCount() const;
+        Note &note(int index);
+        const Note &peekNote(int index) const;
+        std::vector<double> pitches(int index) const;
+        const PitchArray *pitchArray(int index) const;
+        bool isDecoded(int index) const;
+        bool isDecoded() const;
+
+        void appendNote(Note note);
+        void insertNote(int index, Note note);
+        void removeNote(int index);
+
+        void decode();
+        UstFile toUstFile() const;
+
+    public:
+        UstVersion version;
+        UstSettings settings;
+
+    protected:
+        struct Data;
+        std::shared_ptr<Data> m_data;
+
+        void parseData(const std::string_view &data, bool stripCR, const UstReadOptions &options,
+                       const std::shared_ptr<const void> &owner);
     };
 
 }
@@ -0,0 +1,169 @@
+#include "ustreader.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "private/usthelper_p.h"
+
+namespace Utau {
+
+    /*!
+        \class UstReader
+        \brief Event driven UTAU sequence text file(*.ust) reader.
+
+        Reimplement the event handlers to consume the sections as they are read. Only the lines of
+        the current section and one note buffer are kept, so the memory usage does not grow with
+        the file size.
+    */
+
+    /*!
+        Constructor.
+    */
+    UstReader::UstReader() = default;
+
+    /*!
+        Destructor.
+    */
+    UstReader::~UstReader() = default;
+
+    /*!
+        Reads the specific file, returns \c true if success.
+    */
+    bool UstReader::load(const std::filesystem::path &path) {
+        std::ifstream fs(path);
+        if (!fs.is_open())
+            return false;
+        return read(fs);
+    }
+
+    /*!
+        Reads \c ust sections from stream and calls the event handlers, returns \c true if success.
+
+        The rules of splitting sections and skipping notes are the same as UstFile::read().
+    */
+    bool UstReader::read(std::istream &is) {
+        std::vector<std::string> lines; // Line buffers, reused between sections
+        std::vector<std::string_view> views;
+        std::size_t count = 0;
+
+        std::string line;
+        auto pushLine = [&](bool keepLine) {
+            if (count == lines.size()) {
+                lines.emplace_back();
+            }
+            if (keepLine) {
+                lines[count].assign(line);
+            } else {
+                lines[count].swap(line); // Hand the old buffer to the next std::getline
+            }
+            count++;
+        };
+
+        const auto initialNote = [] {
+            Note note;
+            note.intensity = NODEF_DOUBLE;
+            note.modulation = NODEF_DOUBLE;
+            return note;
+        }();
+
+        Note note;
+        int index = 0;
+        bool trackPending = false;
+
+        while (std::getline(is, line)) {
+            bool eof = is.eof();
+            if (line.empty() && !eof) {
+                continue;
+            }
+
+            // Continue to add until meet the start of section or end
+            if (!starts_with(line, SECTION_BEGIN_MARK) && !eof) {
+                pushLine(false);
+                continue;
+            }
+
+            // If meet end, append without continue
+            if (!line.empty() && eof) {
+                pushLine(true);
+            }
+
+            // Previous section is empty
+            if (count > 1) {
+                // If Section Name is invalid
+                std::string_view sectionName;
+                if (!parseSectionName(lines.front(), sectionName)) {
+                    count = 0;
+                    continue;
+                }
+
+                views.assign(lines.begin(), lines.begin() + count);
+                SectionView sectionList(views);
+                if (sectionName == SECTION_NAME_VERSION) {
+                    UstVersion version;
+                    parseSectionVersion(sectionList, version);
+                    onVersion(version);
+                    trackPending = true;
+                } else if (sectionName == SECTION_NAME_SETTING) {
+                    UstSettings settings;
+                    parseSectionSettings(sectionList, settings);
+                    onSettings(settings);
+                    trackPending = true;
+                } else if (isNoteSectionName(sectionName)) {
+                    note = initialNote; // Keeps the allocated buffers of the note
+                    parseSectionNote(sectionList, note);
+                    // Ignore note whose length is invalid
+                    if (note.length > 0) {
+                        onNote(index++, note);
+                    }
+                    trackPending = true;
+                }
+            }
+
+            count = 0;
+            pushLine(false);
+
+            std::string_view sectionName;
+            if (parseSectionName(lines.front(), sectionName) &&
+                sectionName == SECTION_NAME_TRACKEND) {
+                onTrackEnd();
+                index = 0;
+                trackPending = false;
+            }
+        }
+
+        if (trackPending) {
+            onTrackEnd();
+        }
+        return !is.bad();
+    }
+
+    /*!
+        Called when the version section is read.
+    */
+    void UstReader::onVersion(const UstVersion &/*version*/) {
+    }
+
+    /*!
+        Called when the settings section is read.
+    */
+    void UstReader::onSettings(const UstSettings &/*settings*/) {
+    }
+
+    /*!
+        Called when a note section is read, the \a index is the position of the note in the
+        current track. Notes whose length is not positive are skipped like UstFile does.
+
+        The note is a buffer shared by all note sections, copy it if it needs to outlive the call.
+    */
+    void UstReader::onNote(int /*index*/, const Note &/*note*/) {
+    }
+
+    /*!
+        Called when the track end section is met, or at the end of the input if the last track
+        has no end mark. The note index restarts from zero after it.
+    */
+    void UstReader::onTrackEnd() {
+    }
+
+}
@@ -0,0 +1,28 @@
+#ifndef USTREADER_H
+#define USTREADER_H
+
+#include <iostream>
+#include <filesystem>
+
+#include <stdutau/ustfile.h>
+
+namespace Utau {
+
+    class STDUTAU_EXPORT UstReader {
+    public:
+        UstReader();
+        virtual ~UstReader();
+
+        bool load(const std::filesystem::path &path);
+        bool read(std::istream &is);
+
+    protected:
+        virtual void onVersion(const UstVersion &version);
+        virtual void onSettings(const UstSettings &settings);
+        virtual void onNote(int index, const Note &note);
+        virtual void onTrackEnd();
+    };
+
+}
+
+#endif // USTREADER_H
@@ -88,6 +88,10 @@ namespace Utau {
     constexpr const double VALUE_TEMPO_MIN = 10;
     constexpr const double VALUE_TEMPO_MAX = 512;
 
+    // Voicebank
+    constexpr const char OTO_INI_FILE_NAME[] = "oto.ini";
+    constexpr const char OTO_CACHE_FILE_NAME[] = "oto.stdutau-cache";
+
     // Utils
     constexpr const char TONE_NAMES[] = "CCDDEFFGGAAB";
     constexpr const char TONE_NAME_SHARP = '#';
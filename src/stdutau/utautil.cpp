@@ -1,8 +1,15 @@
 #include "utautils.h"
 
-#include <sstream>
 #include <string>
 #include <charconv>
+#include <cerrno>
+#include <cfloat>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
 
 #include "utaconst.h"
 
@@ -13,6 +20,121 @@
 
 namespace Utau {
 
+    namespace {
+
+        // Powers of ten that are exactly representable as double
+        constexpr const double EXACT_POWERS_OF_TEN[] = {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+        };
+
+        constexpr const int MAX_EXACT_POWER = 22;
+        constexpr const std::uint64_t MAX_EXACT_MANTISSA = std::uint64_t(1) << 53;
+
+        // Digits that fit into the 64-bit mantissa of the fast path
+        constexpr const int MAX_MANTISSA_DIGITS = 19;
+
+        // Halfway points between doubles have at most 767 significant digits, any digits after
+        // them only matter as a sticky non-zero digit
+        constexpr const int MAX_SLOW_PATH_DIGITS = 780;
+
+        inline bool isDigit(char ch) {
+            return ch >= '0' && ch <= '9';
+        }
+
+        // Matches a case-insensitive lower-case word at the beginning of the range
+        inline bool matchWord(const char *first, const char *last, const std::string_view &word) {
+            if (last - first < static_cast<std::ptrdiff_t>(word.size())) {
+                return false;
+            }
+            for (char ch : word) {
+                if ((*first >= 'A' && *first <= 'Z' ? *first - 'A' + 'a' : *first) != ch) {
+                    return false;
+                }
+                ++first;
+            }
+            return true;
+        }
+
+        // Parses "inf", "infinity", "nan" and "nan(chars)"
+        const char *parseSpecial(const char *first, const char *last, bool negative,
+                                 double &num) {
+            if (matchWord(first, last, "inf")) {
+                first += matchWord(first, last, "infinity") ? 8 : 3;
+                num = negative ? -std::numeric_limits<double>::infinity()
+                               : std::numeric_limits<double>::infinity();
+                return first;
+            }
+            if (matchWord(first, last, "nan")) {
+                first += 3;
+                if (first != last && *first == '(') {
+                    const char *p = first + 1;
+                    while (p != last && (isDigit(*p) || (*p >= 'a' && *p <= 'z') ||
+                                         (*p >= 'A' && *p <= 'Z') || *p == '_')) {
+                        ++p;
+                    }
+                    if (p != last && *p == ')') {
+                        first = p + 1;
+                    }
+                }
+                num = negative ? -std::numeric_limits<double>::quiet_NaN()
+                               : std::numeric_limits<double>::quiet_NaN();
+                return first;
+            }
+            return nullptr;
+        }
+
+        // Rounds the decimal digits in [first, last) ignoring the decimal point, multiplied by
+        // 10^exponent, with the C library which is correctly rounded. The text passed to strtod
+        // contains neither a decimal point nor a sign of the current locale.
+        bool slowPath(const char *first, const char *last, std::int64_t exponent, bool negative,
+                      double &num) {
+            char buf[MAX_SLOW_PATH_DIGITS + 32];
+            char *out = buf;
+            if (negative) {
+                *out++ = '-';
+            }
+
+            int digits = 0;
+            bool sticky = false;
+            for (const char *p = first; p != last; ++p) {
+                if (!isDigit(*p)) {
+                    continue; // Decimal point
+                }
+                if (digits == 0 && *p == '0') {
+                    continue; // Leading zeros
+                }
+                if (digits < MAX_SLOW_PATH_DIGITS) {
+                    *out++ = *p;
+                    digits++;
+                } else {
+                    sticky |= *p != '0';
+                    exponent++;
+                }
+            }
+            if (sticky) {
+                *out++ = '1';
+                exponent--;
+            }
+
+            *out++ = 'e';
+            out = std::to_chars(out, buf + sizeof(buf) - 1, exponent).ptr;
+            *out = '\0';
+
+            int savedErrno = errno;
+            double res = std::strtod(buf, nullptr);
+            errno = savedErrno;
+
+            // Results that round to zero or infinity are out of range, same as std::from_chars
+            if (res == 0 || std::isinf(res)) {
+                return false;
+            }
+            num = res;
+            return true;
+        }
+
+    }
+
     std::vector<std::string_view> split(const std::string_view &s,
                                         const std::string_view &delimiter) {
         std::vector<std::string_view> tokens;
@@ -73,44 +195,156 @@ namespace Utau {
     }
 
     double stod2(const std::string_view &s, double defaultValue) {
-#ifdef __clang__
-        // Clang does not support floating point numbers in std::from_chars, so std::stod is used instead.
-
-        // Note:
-        // This implementation creates a temporary std::string from std::string_view
-        // since std::stod does not support std::string_view, so there is some overhead.
-
-        double result;
-        std::size_t count;
-        try {
-            result = std::stod(std::string(s), &count);
-            if (count == 0) {
-                result = defaultValue;
+        from_chars2(s.data(), s.data() + s.size(), defaultValue);
+        return defaultValue;
+    }
+
+    /*!
+        Parses a decimal floating point number in the same way as \c std::from_chars with the
+        general format, that is, an optional minus sign, digits with an optional decimal point
+        and exponent, or \c inf and \c nan. Leading whitespace and plus signs are not accepted.
+
+        Returns the pointer past the parsed characters, or \c nullptr if no number is found or
+        the number is out of range, in which case \a num is left unmodified. The function
+        neither allocates nor throws.
+    */
+    const char *from_chars2(const char *first, const char *last, double &num) {
+        const char *p = first;
+        bool negative = false;
+        if (p != last && *p == '-') {
+            negative = true;
+            ++p;
+        }
+        if (p == last) {
+            return nullptr;
+        }
+        if (!isDigit(*p) && *p != '.') {
+            return parseSpecial(p, last, negative, num);
+        }
+
+        // Mantissa, the first 19 significant digits are accumulated
+        const char *digitsBegin = p;
+        std::uint64_t mantissa = 0;
+        int mantissaDigits = 0;
+        std::int64_t exponent = 0;
+        bool truncated = false;
+        bool hasDigits = false;
+        bool fraction = false;
+        std::int64_t fractionDigits = 0;
+        for (; p != last; ++p) {
+            char ch = *p;
+            if (ch == '.') {
+                if (fraction) {
+                    break;
+                }
+                fraction = true;
+                continue;
+            }
+            if (!isDigit(ch)) {
+                break;
+            }
+            hasDigits = true;
+            fractionDigits += fraction;
+            if (mantissaDigits == 0 && ch == '0') {
+                exponent -= fraction;
+                continue;
+            }
+            if (mantissaDigits < MAX_MANTISSA_DIGITS) {
+                mantissa = mantissa * 10 + (ch - '0');
+                mantissaDigits++;
+                exponent -= fraction;
+            } else {
+                truncated |= ch != '0';
+                exponent += !fraction;
             }
         }
-        catch (const std::invalid_argument &e) {
-            result = defaultValue;
+        if (!hasDigits) {
+            return nullptr;
         }
-        catch (const std::out_of_range &e) {
-            result = defaultValue;
+        const char *digitsEnd = p;
+
+        // Exponent, it's ignored if no digit follows
+        std::int64_t explicitExponent = 0;
+        if (p != last && (*p == 'e' || *p == 'E')) {
+            const char *q = p + 1;
+            bool negativeExp = false;
+            if (q != last && (*q == '-' || *q == '+')) {
+                negativeExp = *q == '-';
+                ++q;
+            }
+            if (q != last && isDigit(*q)) {
+                std::int64_t exp = 0;
+                for (; q != last && isDigit(*q); ++q) {
+                    if (exp < 100000) {
+                        exp = exp * 10 + (*q - '0');
+                    }
+                }
+                explicitExponent = negativeExp ? -exp : exp;
+                exponent += explicitExponent;
+                p = q;
+            }
+        }
+
+        if (mantissa == 0) {
+            num = negative ? -0.0 : 0.0;
+            return p;
+        }
+
+        // Clinger's fast path, both operands and the result of one operation are exact
+#if !defined(FLT_EVAL_METHOD) || FLT_EVAL_METHOD == 0
+        if (!truncated && mantissa <= MAX_EXACT_MANTISSA && exponent >= -MAX_EXACT_POWER &&
+            exponent <= MAX_EXACT_POWER) {
+            double res = static_cast<double>(mantissa);
+            if (exponent < 0) {
+                res /= EXACT_POWERS_OF_TEN[-exponent];
+            } else {
+                res *= EXACT_POWERS_OF_TEN[exponent];
+            }
+            num = negative ? -res : res;
+            return p;
         }
-        return result;
-#else
-        std::from_chars(s.data(), s.data() + s.size(), defaultValue);
-        return defaultValue;
 #endif
+
+        // The exponent of the slow path applies to all digits without the decimal point
+        if (!slowPath(digitsBegin, digitsEnd, explicitExponent - fractionDigits, negative, num)) {
+            return nullptr;
+        }
+        return p;
     }
 
     std::string to_string(double num) {
-        std::ostringstream ss;
-        ss << num;
-        return ss.str();
+        char buf[NUMBER_BUFFER_SIZE];
+        return {buf, to_chars2(buf, buf + sizeof(buf), num)};
     }
 
     std::string to_string(int num) {
-        std::ostringstream ss;
-        ss << num;
-        return ss.str();
+        char buf[NUMBER_BUFFER_SIZE];
+        return {buf, to_chars2(buf, buf + sizeof(buf), num)};
+    }
+
+    char *to_chars2(char *first, char *last, double num) {
+        // Same as the default formatting of std::ostream, that is, "%g" with precision 6
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        auto res = std::to_chars(first, last, num, std::chars_format::general, 6);
+        return res.ec == std::errc() ? res.ptr : nullptr;
+#else
+        // Floating point std::to_chars is unavailable, use the C library with "C" decimal point
+        char buf[NUMBER_BUFFER_SIZE];
+        int count = std::snprintf(buf, sizeof(buf), "%g", num);
+        if (count < 0 || count > last - first) {
+            return nullptr;
+        }
+        char point = std::localeconv()->decimal_point[0];
+        for (int i = 0; i < count; ++i) {
+            first[i] = (buf[i] == point) ? '.' : buf[i];
+        }
+        return first + count;
+#endif
+    }
+
+    char *to_chars2(char *first, char *last, int num) {
+        auto res = std::to_chars(first, last, num);
+        return res.ec == std::errc() ? res.ptr : nullptr;
     }
 
     std::vector<double> stringsToDoubles(const std::vector<std::string> &strs) {
@@ -188,8 +422,16 @@ namespace Utau {
     }
 
     bool isRestLyric(const std::string &lyric) {
-        std::string lrc = trim(lyric);
-        return lrc.empty() || lrc == "R" || lrc == "r";
+        // Same as checking trim(lyric) without the copy
+        std::size_t first = 0;
+        std::size_t last = lyric.size();
+        while (first < last && std::isspace(static_cast<unsigned char>(lyric[first]))) {
+            first++;
+        }
+        while (last > first && std::isspace(static_cast<unsigned char>(lyric[last - 1]))) {
+            last--;
+        }
+        return first == last || (last - first == 1 && (lyric[first] == 'R' || lyric[first] == 'r'));
     }
 
 }
\ No newline at end of file
@@ -39,6 +39,13 @@ namespace Utau {
     STDUTAU_EXPORT std::string to_string(double num);
     STDUTAU_EXPORT std::string to_string(int num);
 
+    constexpr const int NUMBER_BUFFER_SIZE = 32;
+
+    STDUTAU_EXPORT char *to_chars2(char *first, char *last, double num);
+    STDUTAU_EXPORT char *to_chars2(char *first, char *last, int num);
+
+    STDUTAU_EXPORT const char *from_chars2(const char *first, const char *last, double &num);
+
     STDUTAU_EXPORT std::vector<double> stringsToDoubles(const std::vector<std::string> &strs);
     STDUTAU_EXPORT std::vector<double> stringsToDoubles(const std::vector<std::string_view> &strs);
     STDUTAU_EXPORT std::vector<std::string> doublesToStrings(const std::vector<double> &nums);
@@ -0,0 +1,328 @@
+#include "voicebank.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+
+#include "otocache.h"
+#include "utaconst.h"
+#include "private/mappedfile_p.h"
+#include "private/parallel_p.h"
+#include "private/pathhelper_p.h"
+
+namespace fs = std::filesystem;
+
+namespace Utau {
+
+    using Clock = std::chrono::steady_clock;
+
+    static inline double elapsedMilliseconds(const Clock::time_point &start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    static bool isOtoIniFile(const fs::path &path) {
+        // The file systems of UTAU are case insensitive, the native characters are compared
+        // since a name in any other code page than the system one can't be converted
+        auto fileName = path.filename();
+        const auto &name = fileName.native();
+        std::string_view expected(OTO_INI_FILE_NAME);
+        return std::equal(name.begin(), name.end(), expected.begin(), expected.end(),
+                          [](fs::path::value_type a, char b) {
+                              return (a >= 'A' && a <= 'Z' ? a - 'A' + 'a' : a) == b;
+                          });
+    }
+
+    // Prefix of the file names of an oto.ini in the subdirectory
+    static std::string fileNamePrefix(const fs::path &subdirectory) {
+        if (subdirectory.empty()) {
+            return {};
+        }
+        return pathToUtf8(subdirectory) + char(fs::path::preferred_separator);
+    }
+
+    static std::vector<fs::path> findOtoIniFiles(const fs::path &root, bool recursive) {
+        std::vector<fs::path> files;
+        auto add = [&](const fs::directory_entry &entry) {
+            std::error_code ec;
+            if (entry.is_regular_file(ec) && isOtoIniFile(entry.path())) {
+                files.push_back(entry.path().lexically_relative(root));
+            }
+        };
+
+        std::error_code ec;
+        if (recursive) {
+            fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied,
+                                                ec);
+            for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+                add(*it);
+            }
+        } else {
+            fs::directory_iterator it(root, ec);
+            for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+                add(*it);
+            }
+        }
+
+        // The file of the root goes first, the subdirectories follow in path order
+        std::sort(files.begin(), files.end(), [](const fs::path &a, const fs::path &b) {
+            bool aRoot = !a.has_parent_path();
+            bool bRoot = !b.has_parent_path();
+            return aRoot != bRoot ? aRoot : a < b;
+        });
+        return files;
+    }
+
+    // Records the next entry read from the file of the report
+    static void addLineRun(OtoFileReport &report, const std::string_view &fileName) {
+        auto &runs = report.lineRuns;
+        if (!runs.empty() && runs.back().first == fileName) {
+            runs.back().second++;
+        } else {
+            runs.emplace_back(fileName, 1);
+        }
+    }
+
+    static void loadOtoIniFile(const fs::path &root, OtoFileReport &report,
+                               std::vector<GenonSettings> &genons) {
+        auto start = Clock::now();
+        try {
+            MappedFile file;
+            if (file.open(root / report.path)) {
+                OtoIni::readEntries(file.data(), genons);
+                report.success = true;
+            } else {
+                report.errorString = file.error().message();
+            }
+        } catch (const std::exception &e) {
+            report.errorString = e.what();
+        }
+
+        // Qualify the file names while the entries are still in the worker
+        auto prefix = fileNamePrefix(report.subdirectory);
+        if (!prefix.empty()) {
+            for (auto &genon : genons) {
+                genon.fileName.insert(0, prefix);
+            }
+        }
+        for (const auto &genon : genons) {
+            addLineRun(report, genon.fileName);
+        }
+        report.entryCount = static_cast<int>(genons.size());
+        report.milliseconds = elapsedMilliseconds(start);
+    }
+
+    /*!
+        \class Voicebank
+        \brief Voicebank wide \c oto.ini loader.
+
+        The \c oto.ini files of the root and its subdirectories are parsed in parallel and merged
+        into one OtoIni, the file name of an entry from a subdirectory is qualified with the
+        relative path of the subdirectory, so it's always relative to the voicebank root. The
+        qualifying path is in UTF-8, whatever the code page of the system.
+
+        If an alias is defined by several files, the entry of the root, and then of the first
+        subdirectory in path order wins.
+    */
+
+    /*!
+        Constructor.
+    */
+    Voicebank::Voicebank() : milliseconds(0) {
+    }
+
+    /*!
+        Loads all \c oto.ini files of the voicebank, returns \c true if the root directory exists.
+
+        A file that fails to load doesn't fail the whole voicebank, check \a reports for the
+        result of each file.
+    */
+    bool Voicebank::load(const std::filesystem::path &root, const VoicebankLoadOptions &options) {
+        clear();
+
+        auto start = Clock::now();
+        std::error_code ec;
+        if (!fs::is_directory(root, ec)) {
+            return false;
+        }
+        this->root = root;
+
+        auto files = findOtoIniFiles(root, options.recursive);
+
+        reports.resize(files.size());
+        for (size_t i = 0; i < files.size(); ++i) {
+            auto &report = reports[i];
+            report.path = files[i];
+            report.subdirectory = files[i].parent_path();
+        }
+
+        // Each file is parsed into a plain list without an index, the lists are moved into the
+        // voicebank in the sorted order and in the line order of each file
+        std::vector<std::vector<GenonSettings>> parts(files.size());
+        parallelFor(static_cast<int>(files.size()), options.threadCount, 1,
+                    [&](int begin, int end) {
+                        for (int i = begin; i < end; ++i) {
+                            loadOtoIniFile(root, reports[i], parts[i]);
+                        }
+                    });
+
+        for (auto &part : parts) {
+            oto.add(std::move(part));
+            part.shrink_to_fit();
+        }
+
+        milliseconds = elapsedMilliseconds(start);
+        return true;
+    }
+
+    /*!
+        Restores the voicebank from the snapshot at \a cachePath if it's still valid and was
+        built with the same \a options, otherwise loads the voicebank and writes a new snapshot,
+        returns \c true if the root directory exists.
+
+        Failing to write the snapshot doesn't fail the load. The reports of a restored voicebank
+        have no timing.
+
+        \sa OtoCache::defaultPath()
+    */
+    bool Voicebank::loadCached(const std::filesystem::path &root,
+                               const std::filesystem::path &cachePath,
+                               const VoicebankLoadOptions &options) {
+        auto start = Clock::now();
+        {
+            OtoCache cache;
+            if (cache.open(cachePath) && cache.isValid(root, options)) {
+                cache.restore(root, *this);
+                milliseconds = elapsedMilliseconds(start);
+                return true;
+            }
+        }
+
+        if (!load(root, options)) {
+            return false;
+        }
+        OtoCache::build(*this, cachePath, options);
+        return true;
+    }
+
+    /*!
+        Writes the entries back to the \c oto.ini files they were loaded from, the subdirectory
+        prefix is removed from the file names. The files are written in parallel with up to
+        \a threadCount workers, returns \c true if all files are written.
+
+        The file of each entry is taken from the line runs of the reports, which follow the
+        lines of each file in the same way as OtoIni::entries(). An entry that was not read from
+        any file, e.g. one added after loading, is written to the \c oto.ini of the deepest
+        loaded subdirectory that its file name starts with, or to the \c oto.ini of the root with
+        its qualified file name.
+
+        A file whose report failed is never written, since its entries were not read, and
+        \c false is returned. The other files are still written.
+    */
+    bool Voicebank::save(const OtoWriteOptions &options, int threadCount) const {
+        if (root.empty()) {
+            return false;
+        }
+
+        // The file of the root may not exist yet, a failed file keeps its part so that its
+        // subdirectory still takes the entries, but the part is never written
+        std::vector<fs::path> paths;
+        std::vector<std::size_t> prefixSizes;
+        std::vector<bool> writable;
+        std::map<std::string, int> subdirectories;
+        for (const auto &report : reports) {
+            subdirectories.emplace(pathToUtf8(report.subdirectory), static_cast<int>(paths.size()));
+            paths.push_back(report.path);
+            prefixSizes.push_back(fileNamePrefix(report.subdirectory).size());
+            writable.push_back(report.success);
+        }
+        if (subdirectories.emplace(std::string(), static_cast<int>(paths.size())).second) {
+            paths.emplace_back(OTO_INI_FILE_NAME);
+            prefixSizes.push_back(0);
+            writable.push_back(true);
+        }
+
+        // The entries read from each file, a file name shared by several files has its lines
+        // taken in the order of the files
+        std::unordered_map<const GenonSettings *, int> partOf;
+        std::map<std::string_view, std::size_t> taken;
+        for (std::size_t i = 0; i < reports.size(); ++i) {
+            for (const auto &run : reports[i].lineRuns) {
+                auto it = oto.contents.find(run.first);
+                if (it == oto.contents.end()) {
+                    continue;
+                }
+                const auto &list = it->second;
+                auto &begin = taken[it->first];
+                auto end = std::min(list.size(), begin + run.second);
+                for (; begin < end; ++begin) {
+                    partOf.emplace(&list[begin], static_cast<int>(i));
+                }
+            }
+        }
+
+        // Split in the line order
+        std::vector<OtoIni> parts(paths.size());
+        int rootPart = subdirectories[std::string()];
+        for (const auto &genon : oto.entries(true)) {
+            int part = rootPart;
+            std::size_t prefixSize = 0;
+            auto it = partOf.find(genon);
+            if (it != partOf.end()) {
+                part = it->second;
+                prefixSize = std::min(prefixSizes[part], genon->fileName.size());
+            } else {
+                // The deepest subdirectory matching the file name wins
+                std::string_view dir = genon->fileName;
+                while (true) {
+                    auto slash = dir.find_last_of("/\\");
+                    if (slash == std::string_view::npos) {
+                        break;
+                    }
+                    dir = dir.substr(0, slash);
+                    auto subdir = subdirectories.find(std::string(dir));
+                    if (subdir != subdirectories.end()) {
+                        part = subdir->second;
+                        prefixSize = slash + 1;
+                        break;
+                    }
+                }
+            }
+
+            GenonSettings copy = *genon;
+            copy.fileName.erase(0, prefixSize);
+            parts[part].add(std::move(copy));
+        }
+
+        std::atomic<bool> success(true);
+        parallelFor(static_cast<int>(parts.size()), threadCount, 1, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                if (!writable[i]) {
+                    success = false;
+                    continue;
+                }
+                if (parts[i].contents.empty() && !fs::exists(root / paths[i])) {
+                    continue; // Don't create an empty file of the root
+                }
+                if (!parts[i].save(root / paths[i], options)) {
+                    success = false;
+                }
+            }
+        });
+        return success;
+    }
+
+    /*!
+        Removes all entries and reports.
+    */
+    void Voicebank::clear() {
+        root.clear();
+        oto = OtoIni();
+        reports.clear();
+        milliseconds = 0;
+    }
+
+}
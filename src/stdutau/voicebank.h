@@ -0,0 +1,64 @@
+#ifndef VOICEBANK_H
+#define VOICEBANK_H
+
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdutau/otoini.h>
+
+namespace Utau {
+
+    class VoicebankLoadOptions {
+    public:
+        inline VoicebankLoadOptions();
+
+    public:
+        int threadCount; // 1 for sequential, non-positive for one per hardware thread
+        bool recursive;  // Search the subdirectories of the root
+    };
+
+    inline VoicebankLoadOptions::VoicebankLoadOptions() : threadCount(0), recursive(true) {
+    }
+
+    class OtoFileReport {
+    public:
+        inline OtoFileReport();
+
+    public:
+        std::filesystem::path path;         // Relative to the voicebank root
+        std::filesystem::path subdirectory; // Directory of the file, empty for the root
+        bool success;
+        std::string errorString;
+        int entryCount;
+        double milliseconds;
+
+        // Qualified file names and counts of the consecutive entries read from the file
+        std::vector<std::pair<std::string, int>> lineRuns;
+    };
+
+    inline OtoFileReport::OtoFileReport() : success(false), entryCount(0), milliseconds(0) {
+    }
+
+    class STDUTAU_EXPORT Voicebank {
+    public:
+        Voicebank();
+
+        bool load(const std::filesystem::path &root,
+                  const VoicebankLoadOptions &options = VoicebankLoadOptions());
+        bool loadCached(const std::filesystem::path &root, const std::filesystem::path &cachePath,
+                        const VoicebankLoadOptions &options = VoicebankLoadOptions());
+        bool save(const OtoWriteOptions &options = OtoWriteOptions(), int threadCount = 0) const;
+        void clear();
+
+    public:
+        std::filesystem::path root;
+        OtoIni oto;
+        std::vector<OtoFileReport> reports;
+        double milliseconds;
+    };
+
+}
+
+#endif // VOICEBANK_H
@@ -0,0 +1,165 @@
+#ifndef TESTUTIL_H
+#define TESTUTIL_H
+
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+
+#include <stdutau/synth.h>
+#include <stdutau/ustfile.h>
+
+// Helpers shared by the tests, each test directory has this one on its include path
+
+inline int failed = 0;
+
+inline void expect(bool ok, const std::string &what) {
+    if (!ok) {
+        std::cout << "Failed: " << what << std::endl;
+        ++failed;
+    }
+}
+
+// Prints the result of the test, returns the exit code of main()
+inline int testResult() {
+    if (failed > 0) {
+        std::cout << failed << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
+
+// Lyrics of the random notes of the synth tests
+inline const char *const SYNTH_LYRICS[] = {"a", "ka", "sa", "R", "i"};
+
+// Genon settings of each lyric, a test may change them like a reloaded voicebank
+inline std::map<std::string, Utau::GenonSettings> synthVoicebank = [] {
+    std::map<std::string, Utau::GenonSettings> genons;
+    for (std::string lyric : SYNTH_LYRICS) {
+        auto &genon = genons[lyric];
+        genon.fileName = lyric + ".wav";
+        genon.alias = lyric;
+        genon.offset = double(lyric.size() * 10);
+        genon.preUtterance = 40 + double(lyric.size() * 15);
+        genon.voiceOverlap = 20;
+    }
+    return genons;
+}();
+
+inline Utau::GenonSettings synthGenonOf(const Utau::Note &note) {
+    auto it = synthVoicebank.find(note.lyric);
+    return it == synthVoicebank.end() ? Utau::GenonSettings() : it->second;
+}
+
+inline void randomizeSynthVoicebank(std::mt19937 &gen) {
+    for (auto &pair : synthVoicebank) {
+        auto &genon = pair.second;
+        genon.offset = gen() % 100;
+        genon.consonant = gen() % 150;
+        genon.blank = -double(gen() % 50);
+        genon.preUtterance = gen() % 120;
+        genon.voiceOverlap = gen() % 60;
+    }
+}
+
+// A note of one of the lyrics, a tenth of them is empty and others are at least minLength long,
+// one in tempoOdds changes the tempo
+inline Utau::Note randomSynthNote(std::mt19937 &gen, int minLength, unsigned tempoOdds) {
+    Utau::Note note(40 + gen() % 40, (gen() % 10 == 0) ? 0 : minLength + gen() % 960,
+                    SYNTH_LYRICS[gen() % 5]);
+    if (gen() % tempoOdds == 0) {
+        note.tempo = 60 + gen() % 200;
+    }
+    if (gen() % 2 == 0) {
+        note.portamento = {{-40.0 - gen() % 40, -double(gen() % 30)}, {0, 0}};
+    }
+    if (gen() % 4 == 0) {
+        note.preUttr = gen() % 200;
+    }
+    if (gen() % 4 == 0) {
+        note.overlap = gen() % 100;
+    }
+    return note;
+}
+
+inline bool sameParams(const Utau::Synth::SynthParams &a, const Utau::Synth::SynthParams &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        if (a[i].first.sequence != b[i].first.sequence ||
+            a[i].first.arguments() != b[i].first.arguments() ||
+            a[i].first.pitchCurves != b[i].first.pitchCurves ||
+            a[i].second.arguments() != b[i].second.arguments()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Choices of the random projects, the defaults only set the fields every reader handles
+struct RandomProjectOptions {
+    unsigned maxNoteCount = 100;
+    bool zeroLengths = false; // A tenth of the notes have no length
+    bool noteFields = false;  // Flags, intensity, pre-utterance and region
+};
+
+// A project of random notes for UstFile to write, so every field has a value that it can read
+inline Utau::UstFile randomUst(unsigned seed, const RandomProjectOptions &options = {}) {
+    std::mt19937 gen(seed);
+    auto number = [&gen](int range) { return int(gen() % (2 * range + 1)) - range; };
+
+    Utau::UstFile ust;
+    ust.settings.projectName = "random";
+    ust.settings.isMode2 = (seed % 2 == 0);
+    ust.notes.resize(gen() % options.maxNoteCount);
+    const char *lyrics[] = {"a", "ka", "R", "sa", ""};
+    for (auto &note : ust.notes) {
+        note.noteNum = 24 + gen() % 72;
+        note.length = (options.zeroLengths && gen() % 10 == 0) ? 0 : 15 * (1 + gen() % 128);
+        note.lyric = lyrics[gen() % 5];
+        if (options.noteFields) {
+            if (gen() % 3 == 0) {
+                note.flags = "g" + std::to_string(number(20));
+            }
+            if (gen() % 4 == 0) {
+                note.intensity = number(200);
+            }
+            if (gen() % 4 == 0) {
+                note.preUttr = number(3000) / 10.0;
+            }
+            if (gen() % 5 == 0) {
+                note.region = "A";
+            }
+        }
+        if (gen() % 8 == 0) {
+            note.tempo = 60 + gen() % 180;
+        }
+        if (gen() % 3 == 0) {
+            for (int i = 0, n = gen() % 6; i < n; ++i) {
+                note.portamento.emplace_back(number(3000) / 10.0, number(400) / 10.0,
+                                             static_cast<Utau::Point::Type>(gen() % 4));
+            }
+            note.pbstart = number(1000) / 10.0;
+        }
+        if (gen() % 3 == 0) {
+            // Integers fit the compact pitches, the others are decoded as usual
+            note.pitches.resize(gen() % 40);
+            for (auto &value : note.pitches) {
+                value = (gen() % 4 == 0) ? number(2000) / 10.0 : number(200);
+            }
+        }
+        if (gen() % 4 == 0) {
+            note.vibrato = Utau::Vibrato();
+            note.vibrato->amplitude = gen() % 100;
+        }
+        if (gen() % 4 == 0) {
+            note.envelope = Utau::Envelope();
+            note.envelope->anchors[1].y = gen() % 200;
+        }
+    }
+    return ust;
+}
+
+#endif // TESTUTIL_H
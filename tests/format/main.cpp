@@ -0,0 +1,103 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <stdutau/utautils.h>
+
+// Compares the number formatting of stdutau with the default formatting of std::ostream
+
+template <class T>
+static std::string streamString(T num) {
+    std::ostringstream ss;
+    ss << num;
+    return ss.str();
+}
+
+template <class T>
+static bool check(T num) {
+    auto expected = streamString(num);
+    auto actual = Utau::to_string(num);
+
+    char buf[Utau::NUMBER_BUFFER_SIZE];
+    auto end = Utau::to_chars2(buf, buf + sizeof(buf), num);
+    if (actual == expected && end && std::string(buf, end) == expected) {
+        return true;
+    }
+    std::cout << "Mismatch: expected \"" << expected << "\", got \"" << actual << "\"" << std::endl;
+    return false;
+}
+
+int main() {
+    int failed = 0;
+
+    const double doubles[] = {
+        0.0,
+        -0.0,
+        1.0,
+        -1.0,
+        0.1,
+        0.5,
+        1.5,
+        100.0,
+        120.0,
+        480.0,
+        -4096.0,
+        12345.6789,
+        123456.0,
+        999999.0,
+        999999.5,
+        1000000.0,
+        1234567.0,
+        0.0001,
+        0.00001,
+        0.000123456789,
+        1e-300,
+        1e300,
+        std::numeric_limits<double>::min(),
+        std::numeric_limits<double>::denorm_min(),
+        std::numeric_limits<double>::max(),
+        std::numeric_limits<double>::lowest(),
+        std::numeric_limits<double>::epsilon(),
+        std::numeric_limits<double>::infinity(),
+        -std::numeric_limits<double>::infinity(),
+        std::numeric_limits<double>::quiet_NaN(),
+    };
+    for (double num : doubles) {
+        failed += !check(num);
+    }
+
+    const int ints[] = {
+        0, 1, -1, 60, 480, -4096, 4095, std::numeric_limits<int>::max(),
+        std::numeric_limits<int>::min(),
+    };
+    for (int num : ints) {
+        failed += !check(num);
+    }
+
+    // Random values in the ranges that appear in UST and oto.ini files
+    std::mt19937_64 gen(20240101);
+    std::uniform_real_distribution<double> small(-1000.0, 1000.0);
+    std::uniform_int_distribution<int> exponent(-20, 20);
+    std::uniform_int_distribution<int> integer(std::numeric_limits<int>::min(),
+                                               std::numeric_limits<int>::max());
+    for (int i = 0; i < 200000; ++i) {
+        double num = small(gen);
+        failed += !check(num);
+        failed += !check(std::round(num * 1000) / 1000);
+        failed += !check(std::ldexp(num, exponent(gen)));
+        failed += !check(integer(gen));
+        if (failed > 20) {
+            break;
+        }
+    }
+
+    if (failed > 0) {
+        std::cout << failed << " mismatches" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
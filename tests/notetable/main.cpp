@@ -0,0 +1,170 @@
+#include <iostream>
+#include <memory_resource>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#include <stdutau/notetable.h>
+#include <stdutau/ustfile.h>
+
+#include "testutil.h"
+
+// Reads and writes ust files through NoteTable and compares them with UstFile::read() and
+// UstFile::write()
+
+static_assert(!std::is_copy_constructible_v<Utau::NoteTable> &&
+                  !std::is_copy_assignable_v<Utau::NoteTable>,
+              "A copy would share the string pool");
+
+static const char SAMPLE[] = "[#VERSION]\n"
+                             "UST Version1.2\n"
+                             "Charset=UTF-8\n"
+                             "[#SETTING]\n"
+                             "Tempo=125.5\n"
+                             "Tracks=1\n"
+                             "ProjectName=test\n"
+                             "VoiceDir=%VOICE%uta\n"
+                             "OutFile=out.wav\n"
+                             "CacheDir=cache\n"
+                             "Tool1=wavtool.exe\n"
+                             "Tool2=resampler.exe\n"
+                             "Mode2=True\n"
+                             "Flags=g-5\n"
+                             "[#0000]\n"
+                             "Length=1920\n"
+                             "Lyric=u\n"
+                             "NoteNum=71\n"
+                             "VoiceOverlap=63.360\n"
+                             "Intensity=-184.954\n"
+                             "VBR=76,-290.912,1.60241e+07,5,-281.393,60,252.094,172.865\n"
+                             "\n"
+                             "[#0001]\n"
+                             "Length=120\n"
+                             "Lyric=o\n"
+                             "NoteNum=79\n"
+                             "PreUtterance=\n"
+                             "VoiceOverlap=73\n"
+                             "Velocity=abc\n"
+                             "Envelope=237,8.72894e+07,429,3.78427e+07,30.511,35,299.105,%\n"
+                             "$region=A\n"
+                             "[#0002]\n"
+                             "Length=480\n"
+                             "Lyric=ka\n"
+                             "NoteNum=70\n"
+                             "Velocity=80.5\n"
+                             "Modulation=94.1\n"
+                             "PBS=110;-293.126\n"
+                             "PBW=-287.968,6.0,107.569\n"
+                             "PBY=-138,,76.782\n"
+                             "PBM=x,r,s\n"
+                             "PBType=5\n"
+                             "PBStart=94.9\n"
+                             "Piches=21,0.000218802,605,-185.518,,,626,,58.9,209.983\n"
+                             "Label=lab\n"
+                             "[#0003]\n"
+                             "Length=0\n"
+                             "Lyric=ka\n"
+                             "NoteNum=67\n"
+                             "Tempo=77.77\n"
+                             "Flags=B50\n"
+                             "PitchBend=0,-5,-12,,7\n"
+                             "Envelope=-46.210,165.899,-144\n"
+                             "$direct=true\n"
+                             "@patch=p\n"
+                             "[#TRACKEND]\n";
+
+static std::string writeNotes(const Utau::UstFile &ust) {
+    std::ostringstream ss;
+    ust.write(ss);
+    return ss.str();
+}
+
+static std::string writeTable(const Utau::UstFile &ust, const Utau::NoteTable &table) {
+    std::ostringstream ss;
+    ust.writeTable(ss, table);
+    return ss.str();
+}
+
+// A project of random notes written by UstFile
+static std::string randomProject(unsigned seed) {
+    RandomProjectOptions options;
+    options.maxNoteCount = 200;
+    options.zeroLengths = true;
+    options.noteFields = true;
+    return writeNotes(randomUst(seed, options));
+}
+
+static bool check(const std::string &data, const std::string &name) {
+    Utau::UstFile expected;
+    expected.read(std::string_view(data));
+    auto expectedData = writeNotes(expected);
+
+    bool ok = true;
+    auto fail = [&](const std::string &what) {
+        std::cout << "Mismatch: " << name << ", " << what << std::endl;
+        ok = false;
+    };
+
+    // Default resource and one arena for the table, serial and concurrent
+    for (int threadCount : {1, 4}) {
+        Utau::UstReadOptions options;
+        options.threadCount = threadCount;
+        auto at = " with " + std::to_string(threadCount) + " threads";
+        {
+            Utau::UstFile ust;
+            Utau::NoteTable table;
+            ust.readTable(data, table, options);
+            if (table.size() != int(expected.notes.size()) ||
+                writeTable(ust, table) != expectedData) {
+                fail("default resource" + at);
+            }
+        }
+        {
+            std::pmr::monotonic_buffer_resource arena;
+            options.memoryResource = &arena;
+            Utau::UstFile ust;
+            Utau::NoteTable table(&arena);
+            ust.readTable(data, table, options);
+            if (writeTable(ust, table) != expectedData) {
+                fail("arena" + at);
+            }
+            if (table.pitches.pool.get_allocator().resource() != &arena ||
+                table.userData.get_allocator().resource() != &arena) {
+                fail("columns out of the arena" + at);
+            }
+
+            // The notes of the table write the same as the notes read directly
+            Utau::UstFile copy;
+            copy.version = ust.version;
+            copy.settings = ust.settings;
+            copy.notes = table.toNotes();
+            if (writeNotes(copy) != expectedData) {
+                fail("notes of the table" + at);
+            }
+
+            // A moved table keeps the resource
+            Utau::NoteTable moved(std::move(table));
+            if (moved.resource() != &arena || writeTable(ust, moved) != expectedData) {
+                fail("moved table" + at);
+            }
+        }
+    }
+    return ok;
+}
+
+int main() {
+    int failed = 0;
+
+    failed += !check(SAMPLE, "sample");
+    for (unsigned seed = 0; seed < 100; ++seed) {
+        failed += !check(randomProject(seed), "seed " + std::to_string(seed));
+    }
+
+    if (failed > 0) {
+        std::cout << failed << " mismatches" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
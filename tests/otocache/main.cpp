@@ -0,0 +1,179 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include <stdutau/otocache.h>
+#include <stdutau/voicebank.h>
+
+#include "testutil.h"
+
+// Builds the snapshot of a small voicebank in a temporary directory, compares its lookups with
+// OtoIndex and checks that changed sources and damaged files are rejected
+
+namespace fs = std::filesystem;
+
+static const char ROOT_OTO[] = "a.wav=- a,100,200,-300,50,20\n"
+                               "a.wav=a i,1100,200,-300,50,20\n"
+                               "ka.wav=,90,250,-300,80,30\n"
+                               "ka.wav=- a,500,250,-300,80,30\n";
+
+static const char SUB_OTO[] = "sa.wav=- sa,100,150,400,60,10\n"
+                              "sa.wav=a i,200,150,400,60,10\n"
+                              "ta.wav=,300,150,400,60,10\n";
+
+static void writeFile(const fs::path &path, const std::string &data) {
+    std::ofstream fs(path, std::ios::binary | std::ios::trunc);
+    fs.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+static std::string readFile(const fs::path &path) {
+    std::ifstream fs(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+}
+
+static bool sameEntry(const Utau::OtoCacheEntry &entry, const Utau::GenonSettings &genon) {
+    auto copy = entry.toGenonSettings();
+    return copy.fileName == genon.fileName && copy.alias == genon.alias &&
+           copy.offset == genon.offset && copy.consonant == genon.consonant &&
+           copy.blank == genon.blank && copy.preUtterance == genon.preUtterance &&
+           copy.voiceOverlap == genon.voiceOverlap;
+}
+
+static bool sameEntry(const Utau::OtoCacheEntry &entry, const Utau::OtoIndexEntry &found) {
+    return sameEntry(entry, found.toGenonSettings());
+}
+
+// Loads the voicebank, writes the snapshot and checks that it's valid and finds what the index
+// finds
+static bool buildAndCompare(const fs::path &root, const fs::path &cachePath) {
+    Utau::VoicebankLoadOptions options;
+    Utau::Voicebank vb;
+    if (!vb.load(root, options) || !Utau::OtoCache::build(vb, cachePath, options)) {
+        return false;
+    }
+
+    Utau::OtoCache cache;
+    if (!cache.open(cachePath) || !cache.isValid(root)) {
+        return false;
+    }
+
+    auto entries = vb.oto.entries(true);
+    if (cache.size() != int(entries.size())) {
+        return false;
+    }
+    for (int i = 0; i < cache.size(); ++i) {
+        if (!sameEntry(cache.entry(i), *entries[i])) {
+            return false;
+        }
+    }
+
+    const auto &index = vb.oto.index();
+    for (int i = 0; i < index.size(); ++i) {
+        const auto &genon = index.at(i);
+        Utau::OtoCacheEntry entry;
+        auto found = index.find(Utau::OtoIndex::aliasOf(genon));
+        if (!cache.find(Utau::OtoIndex::aliasOf(genon), entry) || !found ||
+            !sameEntry(entry, *found)) {
+            return false;
+        }
+    }
+    Utau::OtoCacheEntry entry;
+    return !cache.find("missing", entry) && !index.find("missing");
+}
+
+static bool isValid(const fs::path &root, const fs::path &cachePath) {
+    Utau::OtoCache cache;
+    return cache.open(cachePath) && cache.isValid(root);
+}
+
+static bool opens(const fs::path &cachePath) {
+    Utau::OtoCache cache;
+    return cache.open(cachePath);
+}
+
+int main() {
+    std::mt19937 gen(std::random_device{}());
+    auto root = fs::temp_directory_path() / ("tst_otocache_" + std::to_string(gen()));
+    fs::create_directories(root / "sub");
+    writeFile(root / "oto.ini", ROOT_OTO);
+    writeFile(root / "sub" / "oto.ini", SUB_OTO);
+    auto cachePath = Utau::OtoCache::defaultPath(root);
+    auto subOto = root / "sub" / "oto.ini";
+
+    expect(buildAndCompare(root, cachePath), "lookups");
+
+    // The cache in another directory than the voicebank
+    auto outsidePath = root.string() + ".cache";
+    expect(buildAndCompare(root, outsidePath), "lookups, cache outside");
+    fs::remove(outsidePath);
+
+    // Same size, later modification time
+    {
+        auto time = fs::last_write_time(subOto);
+        writeFile(subOto, SUB_OTO);
+        fs::last_write_time(subOto, time + std::chrono::hours(1));
+        expect(!isValid(root, cachePath), "stale after a modification time change");
+        expect(buildAndCompare(root, cachePath), "rebuilt after a modification time change");
+    }
+
+    // Same modification time, other size
+    {
+        auto time = fs::last_write_time(subOto);
+        writeFile(subOto, std::string(SUB_OTO) + "na.wav=- na,1,2,3,4,5\n");
+        fs::last_write_time(subOto, time);
+        expect(!isValid(root, cachePath), "stale after a size change");
+        expect(buildAndCompare(root, cachePath), "rebuilt after a size change");
+    }
+
+    // A new file in a searched directory, and a removed one
+    {
+        fs::create_directories(root / "sub2");
+        writeFile(root / "sub2" / "oto.ini", "ha.wav=- ha,1,2,3,4,5\n");
+        expect(!isValid(root, cachePath), "stale after adding a file");
+        expect(buildAndCompare(root, cachePath), "rebuilt after adding a file");
+        fs::remove(subOto);
+        expect(!isValid(root, cachePath), "stale after removing a file");
+        writeFile(subOto, SUB_OTO);
+        expect(buildAndCompare(root, cachePath), "rebuilt after removing a file");
+    }
+
+    // Damaged files
+    {
+        auto data = readFile(cachePath);
+        auto damagedPath = root / "damaged.cache";
+        for (std::size_t size = 0; size < data.size(); size += 1 + size / 8) {
+            writeFile(damagedPath, data.substr(0, size));
+            expect(!opens(damagedPath), "truncated to " + std::to_string(size));
+        }
+        writeFile(damagedPath, data + '\0');
+        expect(!opens(damagedPath), "trailing byte");
+
+        auto damaged = data;
+        damaged[0] ^= 0x20;
+        writeFile(damagedPath, damaged);
+        expect(!opens(damagedPath), "magic");
+
+        damaged = data;
+        damaged[8] ^= 0x7f;
+        writeFile(damagedPath, damaged);
+        expect(!opens(damagedPath), "version");
+
+        for (int i = 0; i < 20; ++i) {
+            damaged = data;
+            for (auto &c : damaged) {
+                c = static_cast<char>(gen());
+            }
+            writeFile(damagedPath, damaged);
+            expect(!opens(damagedPath), "random bytes");
+        }
+
+        writeFile(damagedPath, data);
+        expect(opens(damagedPath), "intact copy");
+    }
+
+    fs::remove_all(root);
+
+    return testResult();
+}
@@ -0,0 +1,89 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <stdutau/otoini.h>
+
+#include "testutil.h"
+
+// Looks up aliases in the index of OtoIni while its contents are modified, the entries found
+// must stay readable
+
+static const char SAMPLE[] = "a.wav=- a,100,200,-300,50,20\n"
+                             "a.wav=a i,1100,200,-300,50,20\n"
+                             "ka.wav=- ka,100,250,-300,80,30\n"
+                             "ka.wav=,90,250,-300,80,30\n"
+                             "sub\\sa.wav=- sa,100,150,400,60,10\n"
+                             "ka.wav=- ka,500,250,-300,80,30\n";
+
+static Utau::GenonSettings makeGenon(const std::string &fileName, const std::string &alias,
+                                     double offset) {
+    Utau::GenonSettings genon;
+    genon.fileName = fileName;
+    genon.alias = alias;
+    genon.offset = offset;
+    return genon;
+}
+
+int main() {
+    Utau::OtoIni oto;
+    expect(oto.read(std::string_view(SAMPLE)), "read");
+    expect(oto.index().size() == 5, "index size");
+
+    // The first line of an alias wins, an empty alias is the name of the file
+    auto ka = oto.index().find("- ka");
+    expect(ka && ka->offset == 100, "first line wins");
+    auto bare = oto.index().find("ka");
+    expect(bare && bare->fileName == "ka.wav" && bare->offset == 90, "empty alias");
+    expect(oto.index().contains("- sa"), "sub directory");
+
+    // The file names are interned once for the index and the line order
+    expect(ka->fileName.data() == bare->fileName.data(), "interned file name");
+    expect(oto.index().strings()->size() == 8, "pool size");
+
+    // Erase a file name, add to it again and look up, the old entries are still in the index
+    oto.contents.erase("ka.wav");
+    oto.add(makeGenon("ka.wav", "- ko", 700));
+    oto.add(makeGenon("ka.wav", "- ke", 800));
+    expect(ka->alias == "- ka" && ka->offset == 100, "entry found before erasing");
+    ka = oto.index().find("- ka");
+    expect(ka && ka->offset == 100, "erased entry until rebuilt");
+    auto ko = oto.index().find("- ko");
+    expect(ko && ko->offset == 700, "added entry");
+
+    // A pointer found before adding to the same file name stays valid
+    auto ai = oto.index().find("a i");
+    for (int i = 0; i < 1000; ++i) {
+        oto.add(makeGenon("a.wav", "a " + std::to_string(i), i));
+    }
+    expect(ai->alias == "a i" && ai->offset == 1100, "entry found before adding");
+    expect(ko->alias == "- ko" && ko->offset == 700, "entry found before growing");
+    auto last = oto.index().find("a 999");
+    expect(last && last->offset == 999, "entry added last");
+
+    // Rebuilding drops the erased entries and their strings
+    auto poolSize = oto.index().strings()->size();
+    oto.rebuildIndex();
+    expect(oto.index().strings()->size() < poolSize, "rebuilt pool");
+    expect(!oto.index().contains("- ka") && !oto.index().contains("ka"), "rebuilt erase");
+    expect(oto.index().size() == 1005, "rebuilt size");
+    ko = oto.index().find("- ko");
+    expect(ko && ko->offset == 700, "rebuilt entry");
+
+    // A copy has its own index and keeps the line order
+    Utau::OtoIni copy = oto;
+    std::ostringstream lines, copiedLines;
+    Utau::OtoWriteOptions lineOrder;
+    lineOrder.keepLineOrder = true;
+    oto.write(lines, lineOrder);
+    copy.write(copiedLines, lineOrder);
+    expect(copy.index().strings() != oto.index().strings() && lines.str() == copiedLines.str(),
+           "copied line order");
+    oto.contents.clear();
+    oto.rebuildIndex();
+    expect(oto.index().empty(), "cleared");
+    auto copied = copy.index().find("a 500");
+    expect(copied && copied->offset == 500, "copied index");
+
+    return testResult();
+}
@@ -0,0 +1,250 @@
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdutau/synth.h>
+#include <stdutau/tempomap.h>
+
+// Compares the Mode2 pitch bend arrays of Synth::calc with the results of the original
+// implementation, on small songs of every join type and on random songs of fixed seeds
+
+static Utau::GenonSettings genonOf(const Utau::Note &) {
+    Utau::GenonSettings genon;
+    genon.preUtterance = 50;
+    genon.voiceOverlap = 20;
+    return genon;
+}
+
+static Utau::Synth::SynthParams calc(const std::vector<Utau::Note> &notes) {
+    int n = static_cast<int>(notes.size());
+    return Utau::Synth::calc(
+        {0, n - 1}, {0, n - 1}, 120, "",
+        [&notes, n](int i) { return (i < 0 || i >= n) ? Utau::Note() : notes[i]; }, genonOf);
+}
+
+// Tempo and pitch bend parameters of every resampler call
+static std::vector<std::string> pitchParams(const Utau::Synth::SynthParams &params) {
+    std::vector<std::string> res;
+    for (const auto &item : params) {
+        auto list = item.first.params();
+        res.push_back(list[2] + " " + list[3]);
+    }
+    return res;
+}
+
+static std::vector<Utau::Note> joinSong(Utau::Point::Type type) {
+    std::vector<Utau::Note> notes{{60, 480, "a"}, {64, 480, "i"}, {62, 480, "u"}};
+    notes[1].portamento = {{-40, -40, type}, {20, 0, type}, {120, 10, type}, {200, -15, type}};
+    notes[2].portamento = {{-30, 20, type}, {40, 0, type}};
+    return notes;
+}
+
+static std::vector<Utau::Note> vibratoSong() {
+    std::vector<Utau::Note> notes{{60, 480, "a"}, {67, 960, "i"}, {65, 240, "u"}};
+    notes[1].portamento = {{-60, -70}, {0, 0}};
+    notes[1].vibrato = Utau::Vibrato();
+    notes[1].vibrato->offset = 30;
+    notes[2].vibrato = Utau::Vibrato();
+    notes[2].vibrato->length = 100;
+    notes[2].vibrato->phase = 40;
+    return notes;
+}
+
+static std::vector<Utau::Note> tempoSong() {
+    std::vector<Utau::Note> notes{{60, 480, "a"}, {62, 240, "i"}, {64, 120, "u"}, {65, 480, "R"},
+                                  {67, 480, "e"}};
+    notes[0].tempo = 90;
+    notes[1].tempo = 200;
+    notes[1].portamento = {{-50, -20, Utau::Point::linearJoin}, {30, 0}};
+    notes[2].portamento = {{-20, -20, Utau::Point::rJoin}, {10, 0, Utau::Point::jJoin}};
+    notes[4].tempo = 60;
+    notes[4].portamento = {{-80, -50}, {0, 0}};
+    return notes;
+}
+
+static std::vector<Utau::Note> unsortedSong() {
+    std::vector<Utau::Note> notes{{60, 480, "a"}, {65, 0, "i"}, {63, 480, "u"}, {58, 480, "e"}};
+    notes[2].portamento = {{40, 30, Utau::Point::jJoin}, {-50, -20, Utau::Point::rJoin},
+                           {10, 10}, {10, -10, Utau::Point::linearJoin}, {150, 0}};
+    notes[3].portamento = {{-10, 5}, {-10, -5}, {-40, 0}};
+    return notes;
+}
+
+// Not std::uniform_real_distribution, whose results differ between standard libraries
+static double uniform(std::mt19937 &gen, double min, double max) {
+    return min + (max - min) * (gen() / 4294967296.0);
+}
+
+static std::vector<Utau::Note> randomSong(unsigned seed) {
+    std::mt19937 gen(seed);
+    std::vector<Utau::Note> notes(2 + gen() % 30);
+    for (auto &note : notes) {
+        note.noteNum = 48 + gen() % 24;
+        note.length = (gen() % 8 == 0) ? 0 : 30 + gen() % 1900;
+        note.lyric = (gen() % 6 == 0) ? "R" : "a";
+        if (gen() % 4 == 0) {
+            note.tempo = uniform(gen, 40, 250);
+        }
+        if (gen() % 5 != 0) {
+            int count = gen() % 7;
+            double x = uniform(gen, -300, 50);
+            for (int i = 0; i < count; ++i) {
+                note.portamento.emplace_back(x, uniform(gen, -40, 40),
+                                             static_cast<Utau::Point::Type>(gen() % 4));
+                // Some points go back or repeat the previous position
+                switch (gen() % 10) {
+                    case 0:
+                        x -= uniform(gen, 0, 100);
+                        break;
+                    case 1:
+                        break;
+                    default:
+                        x += uniform(gen, 0, 400);
+                        break;
+                }
+            }
+        }
+        if (gen() % 2 != 0) {
+            Utau::Vibrato vibrato;
+            vibrato.length = uniform(gen, 0, 100);
+            vibrato.period = uniform(gen, 30, 300);
+            vibrato.amplitude = uniform(gen, 0, 100);
+            vibrato.attack = uniform(gen, 0, 100);
+            vibrato.release = uniform(gen, 0, 100);
+            vibrato.phase = uniform(gen, 0, 100);
+            vibrato.offset = uniform(gen, -100, 100);
+            note.vibrato = vibrato;
+        }
+        if (gen() % 3 == 0) {
+            note.preUttr = uniform(gen, 0, 300);
+        }
+        if (gen() % 3 == 0) {
+            note.overlap = uniform(gen, -50, 200);
+        }
+    }
+    return notes;
+}
+
+struct Case {
+    const char *name;
+    std::vector<Utau::Note> notes;
+    std::vector<std::string> expected;
+};
+
+int main() {
+    int failed = 0;
+
+    std::vector<Case> cases = {
+        {"sJoin",
+         joinSong(Utau::Point::sJoin),
+         {"!120 AA#97#ABAJ",
+          "!120 5w5w5x556Q6z7g8U9K9/+v/W/x//AAABAEAIANATAaAhApAxA5BBBJBQBWBbBfBiBjBjBfBVBHA"
+          "1AgAI/w/W+9+m+S+B919t9r",
+          "!120 DI#3#DHDEC7CtCcCHBxBZBCAuAbANAE"}},
+        {"linearJoin",
+         joinSong(Utau::Point::linearJoin),
+         {"!120 AA#97#ADAm",
+          "!120 5w5w5z6W657b7+8h9E9m+J+s/P/xACAIANASAXAcAiAnAsAxA3A8BBBGBLBRBWBbBgBeBNA9AtA"
+          "dAM/9/t/c/M+8+s+b+L979q",
+          "!120 DI#3#DFC2CnCYCKB7BsBdBOA/AwAhATAE"}},
+        {"rJoin",
+         joinSong(Utau::Point::rJoin),
+         {"!120 AA#97#AFA7",
+          "!120 5w5w516r7g8U9E9w+X+5/V/r/5AAAEAMAUAcAkArAzA5BABGBMBRBVBZBcBfBhBjBjBaBBAoAP/"
+          "5/i/N+6+o+Y+K9/929w9s9q",
+          "!120 DI#3#DECsCWB/BqBWBEAzAkAYAOAHAC"}},
+        {"jJoin",
+         joinSong(Utau::Point::jJoin),
+         {"!120 AA#97#ABAF",
+          "!120 5w5w5x516A6T6t7N7y8d9M9++y/pAAAAACAEAGAKAOASAXAdAjApAwA3A+BGBOBWBeBjBhBcBVB"
+          "LA/AwAgAO/6/l/O+2+d+E9r",
+          "!120 DI#3#DHDGDBC6CwCkCWCFBzBfBKA0AdAG"}},
+        {"vibrato",
+         vibratoSong(),
+         {"!120 AA#94#ALAvBqC2EP",
+          "!120 1z2u365T6y8P9l+s/g/8AA#68#ACADAFAIAKAMAOAQAS#3#AQAOALAHAD///7/2/y/u/q/o/o/p"
+          "/r/u/y/3/8ABAIAOAUAaAgAkAoArAsAtAsArAoAkAgAaAUAOAIAB/8/3/y/u/r/p/o/o/q/s/w/0/5//"
+          "AEALARAXAdAiAmApAsAtAtAsAqAmAiAdAYASALAFAA/6/1/w/t/q/o/o/p/r/u/y/2/8ABAGALAPATAW"
+          "AYAZAZAYAWAUASAPAMAJAH",
+          "!120 DXDUDRDPDMDKDJDI#2#AA/9/5/1/x/t/q/o/n/o/s/y/4/+ADAJAPAVAZAdAgAi#2#AgAeAaAVA"
+          "QAKAE///4/y/t/o/k/h/f/h/l/q/u/z/4/8/+"}},
+        {"tempo",
+         tempoSong(),
+         {"!90 AA#96#AEAP",
+          "!200 8485878/9E9L9S9b9l9w97+H+T+f+r+3/D/O/Y/h/q/x/3/7//",
+          "!200 84#9#858+9I9X9q+C+c+6/Z/6",
+          "!200 +c#16#AA#69#ABAFANAZAnA5BOBmB/CbC4DWD0ETExFP",
+          "!60 6n8L9u/A/zAA"}},
+        {"unsorted",
+         unsortedSong(),
+         {"!120 AA#5#",
+          "!120 4M#3#",
+          "!120 DI#17#+q+u+z+4++/D/J/P/V/a/g/l/q/v/z/3/6/9//",
+          "!120 H0#7#"}},
+    };
+    for (const auto &item : cases) {
+        auto actual = pitchParams(calc(item.notes));
+        if (actual != item.expected) {
+            std::cout << "Mismatch: " << item.name << std::endl;
+            for (const auto &s : actual) {
+                std::cout << "    \"" << s << "\"," << std::endl;
+            }
+            ++failed;
+        }
+    }
+
+    // Hash of all pitch bend values of the random songs
+    std::uint64_t hash = 14695981039346656037ull;
+    std::size_t count = 0;
+    for (unsigned seed = 0; seed < 500; ++seed) {
+        auto notes = randomSong(seed);
+        auto params = calc(notes);
+        for (const auto &item : params) {
+            for (int value : item.first.pitchCurves) {
+                hash = (hash ^ static_cast<std::uint32_t>(value)) * 1099511628211ull;
+                ++count;
+            }
+        }
+
+        // The overloads over note arrays and the concurrent calculation give the same result
+        int n = static_cast<int>(notes.size());
+        auto resolver = [](const Utau::Note &note) {
+            static const auto genon = genonOf(note); // The same for all notes
+            return &genon;
+        };
+        auto same = [&params](const Utau::Synth::SynthParams &other) {
+            if (other.size() != params.size()) {
+                return false;
+            }
+            for (std::size_t i = 0; i < params.size(); ++i) {
+                if (other[i].first.pitchCurves != params[i].first.pitchCurves ||
+                    other[i].first.params() != params[i].first.params()) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        if (!same(Utau::Synth::calc({0, n - 1}, 120, "", notes, resolver)) ||
+            !same(Utau::Synth::calc({0, n - 1}, Utau::TempoMap(notes, 120), "", notes, resolver,
+                                    4))) {
+            std::cout << "Overloads differ: seed " << seed << std::endl;
+            ++failed;
+        }
+    }
+    if (hash != 0x8738c9532b6537ecull || count != 1201461) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(hash));
+        std::cout << "Random songs mismatch: " << buf << " " << count << std::endl;
+        ++failed;
+    }
+
+    if (failed > 0) {
+        std::cout << failed << " mismatches" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdutau/pitchcodec.h>
+
+// Encodes and decodes pitch bend arrays of the resampler
+
+static bool check(const std::vector<int> &values, const std::string &expected = {}) {
+    auto encoded = Utau::PitchCodec::encode(values);
+    if (!expected.empty() && encoded != expected) {
+        std::cout << "Mismatch: expected \"" << expected << "\", got \"" << encoded << "\""
+                  << std::endl;
+        return false;
+    }
+
+    std::vector<int> decoded;
+    if (!Utau::PitchCodec::decode(encoded, decoded) || decoded != values) {
+        std::cout << "Round trip failed: \"" << encoded << "\"" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool checkInvalid(const std::string &s, std::size_t pos) {
+    std::vector<int> values;
+    std::size_t errorPos = 0;
+    if (Utau::PitchCodec::decode(s, values, &errorPos) || errorPos != pos) {
+        std::cout << "Invalid string accepted: \"" << s << "\"" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    int failed = 0;
+
+    failed += !check({}, "");
+    failed += !check({0}, "AA");
+    failed += !check({1, -1}, "AB//");
+    failed += !check({2047, -2048}, "f/gA");
+    failed += !check({5, 5}, "AFAF");
+    failed += !check({5, 5, 5}, "AF#2#");
+    failed += !check({0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 64}, "AA#11#BA");
+    failed += !check({-10, -10, -10, 7, 7, 7, 7}, "/2#2#AH#3#");
+
+    failed += !checkInvalid("A", 0);
+    failed += !checkInvalid("#2#", 0);
+    failed += !checkInvalid("AA#2", 2);
+    failed += !checkInvalid("AA##", 2);
+    failed += !checkInvalid("AA#x#", 3);
+    failed += !checkInvalid("AA*A", 2);
+
+    // Runs beyond the size limit
+    failed += !check(std::vector<int>(Utau::PitchCodec::DECODED_SIZE_MAX, 3));
+    failed += !checkInvalid("AA#1048576#", 9);
+    failed += !checkInvalid("AA#2000000000#", 9);
+    failed += !checkInvalid("AAAA#1048575#", 11);
+
+    // Random curves with runs of repeated values
+    std::mt19937 gen(20240101);
+    std::uniform_int_distribution<int> value(Utau::PitchCodec::VALUE_MIN,
+                                             Utau::PitchCodec::VALUE_MAX);
+    std::uniform_int_distribution<int> run(1, 40);
+    for (int i = 0; i < 2000 && failed <= 20; ++i) {
+        std::vector<int> values;
+        int count = run(gen) * 4;
+        while (int(values.size()) < count) {
+            values.insert(values.end(), run(gen) % 5 == 0 ? run(gen) : 1, value(gen));
+        }
+        failed += !check(values);
+    }
+
+    if (failed > 0) {
+        std::cout << failed << " mismatches" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <stdutau/prefixmap.h>
+#include <stdutau/utautils.h>
+
+#include "testutil.h"
+
+// Reads and writes prefix maps over the whole tone range, compares the output with the writer of
+// the former map-based items and resolves prefixed lyrics into an arena
+
+static const int FIRST_TONE = Utau::TONE_NUMBER_BASE;                                  // C1
+static const int LAST_TONE = Utau::TONE_NUMBER_BASE + Utau::PrefixMap::TONE_COUNT - 1; // B7
+
+// The writer of the items kept in a std::map by note number
+static std::string writeMap(const std::map<int, Utau::PrefixMap::Item> &map) {
+    std::ostringstream ss;
+    for (const auto &pair : map) {
+        ss << Utau::toneNumToToneName(pair.first) << "\t" << pair.second.prefix << "\t"
+           << pair.second.suffix << std::endl;
+    }
+    return ss.str();
+}
+
+static std::string writePrefixMap(const Utau::PrefixMap &prefixMap) {
+    std::ostringstream ss;
+    prefixMap.write(ss);
+    return ss.str();
+}
+
+static void checkBounds() {
+    expect(Utau::toneNumToToneName(FIRST_TONE) == "C1" &&
+               Utau::toneNumToToneName(LAST_TONE) == "B7",
+           "tone range");
+
+    std::istringstream ss("C1\tfirst\t_C1\n"
+                          "B7\t\tlast\n"
+                          "A4\tonly two tokens\n"
+                          "\n");
+    Utau::PrefixMap prefixMap;
+    expect(prefixMap.read(ss), "read");
+
+    auto first = prefixMap.find(FIRST_TONE);
+    expect(first && first->prefix == "first" && first->suffix == "_C1", "C1");
+    auto last = prefixMap.find(LAST_TONE);
+    expect(last && last->prefix.empty() && last->suffix == "last", "B7");
+
+    int count = 0;
+    for (const auto &item : prefixMap.items) {
+        count += item.has_value();
+    }
+    expect(count == 2, "incomplete lines skipped");
+
+    // Out of range note numbers are not found
+    prefixMap.items.front()->prefix = "low";
+    prefixMap.items.back()->suffix = "high";
+    for (int noteNum : {FIRST_TONE - 1, LAST_TONE + 1, -1, 0, 1000, 69}) {
+        expect(!prefixMap.find(noteNum), "not found: " + std::to_string(noteNum));
+        expect(prefixMap.prefixedLyric(noteNum, "a") == "a",
+               "unchanged lyric: " + std::to_string(noteNum));
+    }
+    expect(prefixMap.prefixedLyric(FIRST_TONE, "a") == "lowa_C1", "prefixed C1");
+    expect(prefixMap.prefixedLyric(LAST_TONE, "a") == "ahigh", "prefixed B7");
+}
+
+static void checkWrite(unsigned seed) {
+    std::mt19937 gen(seed);
+    auto at = "seed " + std::to_string(seed);
+
+    std::map<int, Utau::PrefixMap::Item> map;
+    Utau::PrefixMap prefixMap;
+    for (int i = 0, n = gen() % 100; i < n; ++i) {
+        int noteNum = FIRST_TONE + gen() % Utau::PrefixMap::TONE_COUNT;
+        Utau::PrefixMap::Item item{
+            gen() % 2 ? "p" + std::to_string(gen() % 10) : "",
+            gen() % 2 ? "_" + Utau::toneNumToToneName(noteNum) : "",
+        };
+        map[noteNum] = item;
+        prefixMap.items[noteNum - FIRST_TONE] = item;
+    }
+
+    auto written = writePrefixMap(prefixMap);
+    expect(written == writeMap(map), at + ": write order");
+
+    // Written items read back the same
+    std::istringstream ss(written);
+    Utau::PrefixMap readBack;
+    readBack.read(ss);
+    expect(writePrefixMap(readBack) == written, at + ": read back");
+}
+
+static void checkLyrics(unsigned seed) {
+    std::mt19937 gen(seed);
+    auto at = "seed " + std::to_string(seed);
+
+    Utau::PrefixMap prefixMap;
+    for (int i = 0; i < Utau::PrefixMap::TONE_COUNT; ++i) {
+        if (gen() % 3 != 0) {
+            prefixMap.items[i] = Utau::PrefixMap::Item{std::string(gen() % 3, 'p'),
+                                                       std::string(gen() % 4, 's')};
+        }
+    }
+
+    // Note numbers around the range, lyrics of any length including empty ones
+    std::vector<Utau::Note> notes(gen() % 200);
+    for (auto &note : notes) {
+        note.noteNum = FIRST_TONE - 4 + int(gen() % (Utau::PrefixMap::TONE_COUNT + 8));
+        note.lyric = std::string(gen() % 5, 'a' + char(gen() % 26));
+    }
+
+    std::string arena = "stale contents";
+    auto lyrics = prefixMap.prefixedLyrics(notes, arena);
+    expect(lyrics.size() == notes.size(), at + ": count");
+
+    std::size_t size = 0;
+    bool same = true;
+    bool inArena = true;
+    for (std::size_t i = 0; i < lyrics.size(); ++i) {
+        same = same && lyrics[i] == prefixMap.prefixedLyric(notes[i].noteNum, notes[i].lyric);
+
+        // The views follow each other in the arena
+        inArena = inArena && lyrics[i].data() == arena.data() + size;
+        size += lyrics[i].size();
+    }
+    expect(same, at + ": lyrics");
+    expect(inArena && arena.size() == size, at + ": arena views");
+}
+
+int main() {
+    checkBounds();
+    for (unsigned seed = 0; seed < 50; ++seed) {
+        checkWrite(seed);
+        checkLyrics(seed);
+    }
+
+    // No notes, the arena is still cleared
+    Utau::PrefixMap prefixMap;
+    std::string arena = "stale";
+    expect(prefixMap.prefixedLyrics({}, arena).empty() && arena.empty(), "empty notes");
+
+    return testResult();
+}
@@ -0,0 +1,201 @@
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdutau/utautils.h>
+
+// Checks stod2 against std::from_chars and the round trip of printf, run with "--benchmark" to
+// compare the parsing speed with the standard library
+
+static bool sameDouble(double a, double b) {
+    if (std::isnan(a) || std::isnan(b)) {
+        return std::isnan(a) && std::isnan(b) && std::signbit(a) == std::signbit(b);
+    }
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// The implementation used on Clang before
+static double legacyStod(const std::string_view &s, double defaultValue) {
+    double result;
+    std::size_t count;
+    try {
+        result = std::stod(std::string(s), &count);
+        if (count == 0) {
+            result = defaultValue;
+        }
+    } catch (const std::invalid_argument &) {
+        result = defaultValue;
+    } catch (const std::out_of_range &) {
+        result = defaultValue;
+    }
+    return result;
+}
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#  define HAS_FLOAT_FROM_CHARS
+
+static double fromChars(const std::string_view &s, double defaultValue) {
+    std::from_chars(s.data(), s.data() + s.size(), defaultValue);
+    return defaultValue;
+}
+#endif
+
+static int failed = 0;
+
+static void check(const std::string &s, double expected) {
+    double actual = Utau::stod2(s, 42);
+    if (!sameDouble(actual, expected)) {
+        std::printf("Mismatch: \"%s\", expected %.17g, got %.17g\n", s.c_str(), expected, actual);
+        failed++;
+    }
+#ifdef HAS_FLOAT_FROM_CHARS
+    double std = fromChars(s, 42);
+    if (!sameDouble(actual, std)) {
+        std::printf("Mismatch with std::from_chars: \"%s\", expected %.17g, got %.17g\n",
+                    s.c_str(), std, actual);
+        failed++;
+    }
+#endif
+}
+
+static void checkRoundTrip(double num) {
+    char buf[64];
+    for (const char *format : {"%.17g", "%.15g", "%.6g", "%.3f", "%.20e"}) {
+        std::snprintf(buf, sizeof(buf), format, num);
+        check(buf, std::strtod(buf, nullptr));
+    }
+}
+
+static std::vector<std::string> benchmarkCorpus() {
+    // Typical values of UST and oto.ini files
+    std::vector<std::string> corpus;
+    std::mt19937_64 gen(7);
+    std::uniform_real_distribution<double> dist(-200.0, 2000.0);
+    char buf[64];
+    for (int i = 0; i < 1000000; ++i) {
+        switch (i % 5) {
+            case 0:
+                std::snprintf(buf, sizeof(buf), "%d", static_cast<int>(dist(gen)));
+                break;
+            case 1:
+                std::snprintf(buf, sizeof(buf), "%.1f", dist(gen));
+                break;
+            case 2:
+                std::snprintf(buf, sizeof(buf), "%.3f", dist(gen));
+                break;
+            case 3:
+                std::snprintf(buf, sizeof(buf), "%g", dist(gen));
+                break;
+            default:
+                std::snprintf(buf, sizeof(buf), "%s", (i % 10 == 4) ? "" : "abc");
+                break;
+        }
+        corpus.emplace_back(buf);
+    }
+    return corpus;
+}
+
+template <class Func>
+static void benchmark(const char *name, const std::vector<std::string> &corpus, Func func) {
+    auto start = std::chrono::steady_clock::now();
+    double sum = 0;
+    for (int i = 0; i < 5; ++i) {
+        for (const auto &s : corpus) {
+            sum += func(s, 0);
+        }
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    std::printf("%-20s %6lld ms (checksum %g)\n", name, static_cast<long long>(ms), sum);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        auto corpus = benchmarkCorpus();
+        std::printf("%d strings x 5\n", static_cast<int>(corpus.size()));
+        benchmark("Utau::stod2", corpus, [](const std::string_view &s, double defaultValue) {
+            return Utau::stod2(s, defaultValue);
+        });
+#ifdef HAS_FLOAT_FROM_CHARS
+        benchmark("std::from_chars", corpus, fromChars);
+#endif
+        benchmark("std::stod", corpus, legacyStod);
+        return 0;
+    }
+
+    const std::pair<const char *, double> cases[] = {
+        {"",                         42                                       },
+        {"-",                        42                                       },
+        {".",                        42                                       },
+        {"-.e1",                     42                                       },
+        {"+1",                       42                                       },
+        {" 1",                       42                                       },
+        {"abc",                      42                                       },
+        {"0",                        0                                        },
+        {"-0",                       -0.0                                     },
+        {"0.000e400",                0                                        },
+        {"1",                        1                                        },
+        {"-20",                      -20                                      },
+        {".5",                       0.5                                      },
+        {"5.",                       5                                        },
+        {"1.5E-2",                   0.015                                    },
+        {"1e",                       1                                        },
+        {"1e+",                      1                                        },
+        {"1e+5x",                    1e5                                      },
+        {"12.5,3",                   12.5                                     },
+        {"1.2.3",                    1.2                                      },
+        {"0x10",                     0                                        },
+        {"inf",                      std::numeric_limits<double>::infinity()  },
+        {"-Infinity",                -std::numeric_limits<double>::infinity() },
+        {"infinit",                  std::numeric_limits<double>::infinity()  },
+        {"nan",                      std::numeric_limits<double>::quiet_NaN() },
+        {"-nan(123)",                -std::numeric_limits<double>::quiet_NaN()},
+        {"1e-400",                   42                                       },
+        {"1e400",                    42                                       },
+        {"2e-324",                   42                                       },
+        {"3e-324",                   std::numeric_limits<double>::denorm_min()},
+        {"1.7976931348623157e308",   std::numeric_limits<double>::max()       },
+        {"1.7976931348623159e308",   42                                       },
+        {"2.2250738585072011e-308",  2.2250738585072011e-308                  },
+        {"9007199254740993",         9007199254740992.0                       },
+        {"123456789012345678901234", 1.2345678901234568e23                    },
+        {"0.1000000000000000055511151231257827021181583404541015625", 0.1    },
+    };
+    for (const auto &item : cases) {
+        check(item.first, item.second);
+    }
+
+    // Exactly between two doubles, the digits after the halfway point decide the rounding
+    std::string halfway = "9007199254740993.";
+    check(halfway + std::string(800, '0'), 9007199254740992.0);
+    check(halfway + std::string(800, '0') + "1", 9007199254740994.0);
+
+    std::mt19937_64 gen(20240101);
+    std::uniform_real_distribution<double> small(-5000.0, 5000.0);
+    std::uniform_int_distribution<std::uint64_t> bits;
+    for (int i = 0; i < 100000 && failed < 20; ++i) {
+        checkRoundTrip(small(gen));
+        double num;
+        auto b = bits(gen);
+        std::memcpy(&num, &b, sizeof(num));
+        if (std::isfinite(num)) {
+            checkRoundTrip(num);
+        }
+    }
+
+    if (failed > 0) {
+        std::cout << failed << " mismatches" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
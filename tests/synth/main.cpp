@@ -0,0 +1,78 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdutau/synth.h>
+#include <stdutau/tempomap.h>
+
+#include "testutil.h"
+
+// Compares the concurrent Synth::calc with the serial overloads on random songs long enough to
+// be split into several chunks, over whole and partial ranges
+
+static std::vector<Utau::Note> randomSong(unsigned seed) {
+    std::mt19937 gen(seed);
+    std::vector<Utau::Note> notes(100 + gen() % 500);
+    for (auto &note : notes) {
+        note = randomSynthNote(gen, 30, 6);
+    }
+    return notes;
+}
+
+int main() {
+    for (unsigned seed = 0; seed < 20; ++seed) {
+        auto notes = randomSong(seed);
+        int n = static_cast<int>(notes.size());
+        std::vector<Utau::GenonSettings> genons;
+        for (const auto &note : notes) {
+            genons.push_back(synthGenonOf(note));
+        }
+        auto noteGetter = [&notes, n](int i) {
+            return (i < 0 || i >= n) ? Utau::Note() : notes[i];
+        };
+        auto resolver = [&notes, &genons](const Utau::Note &note) {
+            return &genons[&note - notes.data()];
+        };
+        Utau::TempoMap tempoMap(notes, 120);
+
+        // Whole song and a range in the middle, also with the limits starting at the range
+        std::mt19937 gen(seed);
+        int first = 1 + gen() % (n / 2);
+        int last = first + gen() % (n - first);
+        std::pair<int, int> ranges[] = {{0, n - 1}, {first, last}};
+
+        for (const auto &range : ranges) {
+            auto at = "seed " + std::to_string(seed) + ", range " + std::to_string(range.first) +
+                      "-" + std::to_string(range.second);
+            auto serial =
+                Utau::Synth::calc({0, n - 1}, range, 120, "g-3", noteGetter, synthGenonOf);
+            auto serialNarrowed = Utau::Synth::calc({range.first, n - 1}, range, 120, "g-3",
+                                                    noteGetter, synthGenonOf);
+            auto serialArray = Utau::Synth::calc(range, 120, "g-3", notes.data(), n, resolver);
+            expect(sameParams(serialArray, serial), at + ", array");
+
+            for (int threadCount : {0, 2, 3, 8}) {
+                auto with = at + ", " + std::to_string(threadCount) + " threads";
+                expect(sameParams(Utau::Synth::calc({0, n - 1}, range, 120, "g-3", noteGetter,
+                                                    synthGenonOf, threadCount),
+                                  serial),
+                       with + ", getters");
+                expect(sameParams(Utau::Synth::calc({range.first, n - 1}, range, 120, "g-3",
+                                                    noteGetter, synthGenonOf, threadCount),
+                                  serialNarrowed),
+                       with + ", narrowed limits");
+                expect(sameParams(Utau::Synth::calc(range, 120, "g-3", notes.data(), n,
+                                                    resolver, threadCount),
+                                  serialArray),
+                       with + ", array");
+                expect(sameParams(Utau::Synth::calc(range, tempoMap, "g-3", notes.data(), n,
+                                                    resolver, threadCount),
+                                  serialArray),
+                       with + ", tempo map");
+            }
+        }
+    }
+
+    return testResult();
+}
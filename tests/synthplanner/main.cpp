@@ -0,0 +1,80 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdutau/synthplanner.h>
+
+#include "testutil.h"
+
+// Edits the notes of a SynthPlanner at random and compares its arguments with Synth::calc()
+// over all notes after every edit
+
+int main() {
+    for (unsigned seed = 0; seed < 50; ++seed) {
+        std::mt19937 gen(seed);
+        randomizeSynthVoicebank(gen);
+
+        std::vector<Utau::Note> notes(gen() % 20);
+        for (auto &note : notes) {
+            note = randomSynthNote(gen, 60, 5);
+        }
+        double tempo = 120;
+        std::string flags;
+
+        Utau::SynthPlanner planner(synthGenonOf);
+        planner.setNotes(notes);
+
+        for (int step = 0; step < 200; ++step) {
+            int n = static_cast<int>(notes.size());
+            int index = n > 0 ? int(gen() % n) : 0;
+            auto op = gen() % 8;
+            if (op == 0 && n > 0) {
+                notes.erase(notes.begin() + index);
+                planner.removeNote(index);
+            } else if (op == 1 || n == 0) {
+                index = gen() % (n + 1);
+                auto note = randomSynthNote(gen, 60, 5);
+                notes.insert(notes.begin() + index, note);
+                planner.insertNote(index, note);
+            } else if (op == 2) {
+                notes[index].tempo = (gen() % 2 == 0) ? Utau::NODEF_DOUBLE : 60 + gen() % 200;
+                planner.setNote(index, notes[index]);
+            } else if (op == 3) {
+                notes[index] = randomSynthNote(gen, 60, 5);
+                planner.setNote(index, notes[index]);
+            } else if (op == 4) {
+                tempo = 80 + gen() % 100;
+                planner.setInitialTempo(tempo);
+            } else if (op == 5) {
+                flags = (gen() % 2 == 0) ? "" : "g" + std::to_string(gen() % 10);
+                planner.setGlobalFlags(flags);
+            } else if (op == 6) {
+                randomizeSynthVoicebank(gen);
+                planner.invalidate();
+            } else {
+                // Out of range edits are ignored
+                auto note = randomSynthNote(gen, 60, 5);
+                planner.setNote(n, note);
+                planner.setNote(-1, note);
+                planner.insertNote(n + 1, note);
+                planner.insertNote(-1, note);
+                planner.removeNote(n);
+                planner.removeNote(-1);
+            }
+
+            n = static_cast<int>(notes.size());
+            auto expected = Utau::Synth::calc(
+                {0, n - 1}, {0, n - 1}, tempo, flags,
+                [&notes, n](int i) { return (i < 0 || i >= n) ? Utau::Note() : notes[i]; },
+                synthGenonOf);
+            if (!sameParams(planner.params(), expected) || planner.notes().size() != notes.size()) {
+                expect(false, "seed " + std::to_string(seed) + ", step " +
+                                  std::to_string(step) + ", edit " + std::to_string(op));
+                break;
+            }
+        }
+    }
+
+    return testResult();
+}
@@ -0,0 +1,123 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdutau/tempomap.h>
+
+#include "testutil.h"
+
+// Checks the tick and time queries of TempoMap against a plain walk over the notes
+
+static bool near(double a, double b) {
+    return std::abs(a - b) <= 1e-9 * std::max(1.0, std::abs(b));
+}
+
+static Utau::Note makeNote(int length, double tempo = Utau::NODEF_DOUBLE) {
+    Utau::Note note(60, length);
+    note.tempo = tempo;
+    return note;
+}
+
+// Every tick converts to a time and back to itself, also out of the notes
+static void checkRoundTrip(const Utau::TempoMap &map, const std::string &name) {
+    for (int tick = -960; tick <= map.totalTicks() + 960; ++tick) {
+        int back = map.timeToTick(map.tickToTime(tick));
+        if (back != tick) {
+            expect(false, name + ": round trip of tick " + std::to_string(tick) + " gives " +
+                              std::to_string(back));
+            return;
+        }
+    }
+}
+
+// Start time and tempo of every note by summing the durations one by one
+static void checkWalk(const Utau::TempoMap &map, const std::vector<Utau::Note> &notes,
+                      double initialTempo, const std::string &name) {
+    double tempo = initialTempo;
+    double time = 0;
+    int tick = 0;
+    for (int i = 0; i < int(notes.size()); ++i) {
+        if (notes[i].hasTempo()) {
+            tempo = notes[i].tempo;
+        }
+        auto at = name + ": note " + std::to_string(i);
+        expect(map.noteTick(i) == tick, at + " tick");
+        expect(near(map.noteTime(i), time), at + " time");
+        expect(map.tempoAt(i) == tempo, at + " tempo");
+        if (notes[i].length > 0) {
+            expect(map.noteAtTick(tick) == i, at + " at its tick");
+            expect(map.tempoAtTick(tick) == tempo, at + " tempo at its tick");
+        }
+        time += Utau::Note::duration(notes[i].length, tempo);
+        tick += notes[i].length;
+    }
+    expect(map.totalTicks() == tick, name + ": total ticks");
+    expect(near(map.totalTime(), time), name + ": total time");
+    expect(map.noteAtTick(tick) == -1 && map.noteAtTick(-1) == -1, name + ": out of the notes");
+}
+
+int main() {
+    // No notes
+    {
+        Utau::TempoMap map;
+        expect(map.noteCount() == 0 && map.totalTicks() == 0, "empty: size");
+        expect(map.tempoAtTick(0) == Utau::DEFAULT_VALUE_TEMPO &&
+                   map.tempoAt(-1) == Utau::DEFAULT_VALUE_TEMPO,
+               "empty: tempo");
+        expect(near(map.tickToTime(480), 500), "empty: extrapolated time");
+        checkRoundTrip(map, "empty");
+    }
+
+    // A tempo on the first note replaces the initial tempo instead of adding a segment
+    {
+        std::vector<Utau::Note> notes{makeNote(480, 150), makeNote(480), makeNote(480, 150)};
+        Utau::TempoMap map(notes, 120);
+        expect(map.segmentCount() == 1, "first tempo: segments");
+        expect(map.tempoAt(0) == 150 && map.tempoAtTick(-1) == 150, "first tempo: tempo");
+        expect(map.tempoAt(-1) == 120, "first tempo: tempo before the notes");
+        expect(near(map.tickToTime(480), 400), "first tempo: time");
+        expect(near(map.tickToTime(-480), -400), "first tempo: time before the notes");
+        checkWalk(map, notes, 120, "first tempo");
+        checkRoundTrip(map, "first tempo");
+    }
+
+    // Zero-length notes change the tempo without taking a tick, the last one wins
+    {
+        std::vector<Utau::Note> notes{makeNote(0, 90), makeNote(480), makeNote(0, 200),
+                                      makeNote(0, 60), makeNote(480), makeNote(0), makeNote(240),
+                                      makeNote(0, 180)};
+        Utau::TempoMap map(notes, 120);
+        expect(map.noteTick(2) == 480 && map.noteTick(3) == 480 && map.noteTick(4) == 480,
+               "zero length: ticks");
+        expect(map.noteAtTick(480) == 4 && map.noteAtTick(960) == 6, "zero length: notes");
+        expect(map.tempoAtTick(480) == 60 && map.tempoAtTick(479) == 90, "zero length: tempo");
+        expect(map.tempoAt(7) == 180 && map.tempoAtTick(1200) == 180, "zero length: last tempo");
+        expect(map.timeToTick(map.tickToTime(480)) == 480, "zero length: boundary");
+        expect(near(map.tickToTime(960), 1000.0 * 480 / 720 + 1000), "zero length: time");
+        checkWalk(map, notes, 120, "zero length");
+        checkRoundTrip(map, "zero length");
+    }
+
+    // Random songs with fractional tempos, not std::uniform_*_distribution, whose results
+    // differ between standard libraries
+    for (unsigned seed = 0; seed < 200 && failed == 0; ++seed) {
+        std::mt19937 gen(seed);
+        std::vector<Utau::Note> notes(1 + gen() % 40);
+        for (auto &note : notes) {
+            note = makeNote((gen() % 5 == 0) ? 0 : 1 + gen() % 1920);
+            if (gen() % 3 == 0) {
+                note.tempo = 20 + (gen() % 100000) / 300.0;
+            }
+        }
+        double initialTempo = 40 + (gen() % 1000) / 7.0;
+        auto name = "seed " + std::to_string(seed);
+        Utau::TempoMap map(notes, initialTempo);
+        expect(map.tempoAt(-1) == initialTempo, name + ": tempo before the notes");
+        checkWalk(map, notes, initialTempo, name);
+        checkRoundTrip(map, name);
+    }
+
+    return testResult();
+}
@@ -0,0 +1,234 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <stdutau/ustfile.h>
+
+#include "testutil.h"
+
+// Reads ust files in the lazy, compact and concurrent modes and compares them with the eager
+// read, before and after decoding, editing and appending the notes
+
+static const char SAMPLE[] = "[#VERSION]\n"
+                             "UST Version1.2\n"
+                             "[#SETTING]\n"
+                             "Tempo=125.5\n"
+                             "ProjectName=test\n"
+                             "Mode2=True\n"
+                             "[#0000]\n"
+                             "Length=1920\n"
+                             "Lyric=u\n"
+                             "NoteNum=71\n"
+                             "VBR=76,-290.912,1.60241e+07,5,-281.393,60,252.094,172.865\n"
+                             "[#0001]\n"
+                             "Length=120\n"
+                             "Lyric=o\n"
+                             "NoteNum=79\n"
+                             "[#0002]\n"
+                             "Length=480\n"
+                             "Lyric=ka\n"
+                             "NoteNum=70\n"
+                             "PBS=110;-293.126\n"
+                             "PBW=-287.968,6.0,107.569\n"
+                             "PBY=-138,,76.782\n"
+                             "PBM=x,r,s\n"
+                             "Piches=21,0.000218802,605,-185.518,,,626,,58.9,209.983\n"
+                             "[#0003]\n"
+                             "Length=240\n"
+                             "Lyric=ka\n"
+                             "NoteNum=67\n"
+                             "PitchBend=0,-5,-12,,7\n"
+                             "Envelope=-46.210,165.899,-144\n"
+                             "[#TRACKEND]\n";
+
+static std::string writeUst(const Utau::UtaFileBase &ust) {
+    std::ostringstream ss;
+    ust.write(ss);
+    return ss.str();
+}
+
+// A project of random notes written by UstFile
+static std::string randomProject(unsigned seed) {
+    RandomProjectOptions options;
+    options.maxNoteCount = 300;
+    return writeUst(randomUst(seed, options));
+}
+
+struct Mode {
+    const char *name;
+    int threadCount;
+    bool lazy;
+    bool compactPitches;
+};
+
+static const Mode MODES[] = {
+    {"lazy", 1, true, false},
+    {"compact", 1, false, true},
+    {"lazy compact", 1, true, true},
+    {"threaded", 4, false, false},
+    {"threaded lazy compact", 4, true, true},
+};
+
+static void check(const std::string &data, const std::string &name) {
+    Utau::UstFile eager;
+    eager.read(std::string_view(data));
+    auto expected = writeUst(eager);
+
+    Utau::Note extra(64, 480, "extra");
+    extra.pitches = {1, 2, 3};
+    Utau::UstFile eagerAppended = eager;
+    eagerAppended.notes.push_back(extra);
+    eagerAppended.notes.push_back(extra);
+    auto expectedAppended = writeUst(eagerAppended);
+
+    for (const auto &mode : MODES) {
+        auto at = name + ", " + mode.name;
+        Utau::UstReadOptions options;
+        options.threadCount = mode.threadCount;
+        options.lazy = mode.lazy;
+        options.compactPitches = mode.compactPitches;
+
+        // UstFile ignores the lazy and compact options, the note list stays complete
+        Utau::UstFile complete;
+        complete.read(std::string_view(data), options);
+        expect(complete.notes.size() == eager.notes.size() && writeUst(complete) == expected,
+               at + ": complete note list");
+
+        Utau::LazyUstFile ust;
+        ust.read(std::string_view(data), options);
+        expect(ust.noteCount() == int(eager.notes.size()), at + ": count");
+        expect(writeUst(ust) == expected, at + ": write");
+        expect(writeUst(ust.toUstFile()) == expected, at + ": to UstFile");
+
+        // A copy shares the pending notes until one of them is decoded
+        Utau::LazyUstFile copy = ust;
+        bool same = true;
+        for (int i = 0; i < copy.noteCount(); ++i) {
+            same = same && copy.pitches(i) == eager.notes[i].pitches &&
+                   copy.note(i).pitches == eager.notes[i].pitches &&
+                   copy.note(i).vibrato.has_value() == eager.notes[i].vibrato.has_value() &&
+                   copy.isDecoded(i);
+        }
+        expect(same, at + ": decoded notes");
+        expect(copy.isDecoded(), at + ": decoded by accessing");
+        expect(writeUst(copy) == expected && writeUst(ust) == expected, at + ": write decoded");
+
+        // Appended notes follow the pending ones, also when decoded
+        ust.appendNote(extra);
+        ust.insertNote(0, extra);
+        ust.removeNote(0);
+        ust.appendNote(extra);
+        expect(writeUst(ust) == expectedAppended, at + ": write appended");
+        auto appended = ust.toUstFile();
+        expect(appended.notes.size() == eagerAppended.notes.size() &&
+                   appended.notes.back().lyric == "extra",
+               at + ": note list");
+        ust.decode();
+        expect(ust.isDecoded() && writeUst(ust) == expectedAppended, at + ": decoded appended");
+    }
+}
+
+// The keys of a note section that the parser does not know reach the handler, including the
+// readonly keys of plugin files, which are not note fields of a project
+static const char UNKNOWN_KEYS[] = "[#SETTING]\n"
+                                   "Tempo=120\n"
+                                   "[#0000]\n"
+                                   "Length=480\n"
+                                   "Lyric=a\n"
+                                   "NoteNum=60\n"
+                                   "PreUtterance=10\n"
+                                   "@preuttr=25\n"
+                                   "@alias=a\n"
+                                   "Label=first\n"
+                                   "PBS=0;0\n"
+                                   "PBW=50\n"
+                                   "$custom=1\n"
+                                   "[#0001]\n"
+                                   "Length=240\n"
+                                   "Lyric=ka\n"
+                                   "NoteNum=62\n"
+                                   "@cache=x.wav\n"
+                                   "[#TRACKEND]\n";
+
+static void checkUnknownKeys() {
+    const std::map<std::string, std::string> expected[] = {
+        {{"@preuttr", "25"}, {"@alias", "a"}, {"Label", "first"}, {"$custom", "1"}},
+        {{"@cache", "x.wav"}},
+    };
+    auto same = [&expected](const Utau::Note &note, int i) {
+        return note.userData == expected[i] && note.preUttr == (i == 0 ? 10 : Utau::NODEF_DOUBLE);
+    };
+
+    for (int threadCount : {1, 4}) {
+        auto at = "unknown keys, " + std::to_string(threadCount) + " threads";
+        Utau::UstReadOptions options;
+        options.threadCount = threadCount;
+        options.unknownKeyHandler = [](Utau::Note &note, const std::string_view &key,
+                                       const std::string_view &value) {
+            note.userData[std::string(key)] = value;
+        };
+
+        Utau::UstFile ust;
+        ust.read(std::string_view(UNKNOWN_KEYS), options);
+        expect(ust.notes.size() == 2 && same(ust.notes[0], 0) && same(ust.notes[1], 1), at);
+
+        options.lazy = true;
+        Utau::LazyUstFile lazy;
+        lazy.read(std::string_view(UNKNOWN_KEYS), options);
+        expect(lazy.noteCount() == 2 && same(lazy.peekNote(0), 0) && same(lazy.peekNote(1), 1),
+               at + ", lazy");
+
+        Utau::NoteTable table;
+        Utau::Note note;
+        ust.readTable(std::string_view(UNKNOWN_KEYS), table, options);
+        bool tableSame = table.size() == 2;
+        for (int i = 0; tableSame && i < 2; ++i) {
+            table.toNote(i, note);
+            tableSame = same(note, i);
+        }
+        expect(tableSame, at + ", table");
+    }
+}
+
+int main() {
+    check(SAMPLE, "sample");
+    for (unsigned seed = 0; seed < 50; ++seed) {
+        check(randomProject(seed), "seed " + std::to_string(seed));
+    }
+    checkUnknownKeys();
+
+    // Mapped from a file, the lazy notes keep a copy of the mapping
+    {
+        std::mt19937 gen(std::random_device{}());
+        auto path = std::filesystem::temp_directory_path() /
+                    ("tst_ustfile_" + std::to_string(gen()) + ".ust");
+        auto data = randomProject(1000);
+        {
+            std::ofstream fs(path, std::ios::binary);
+            fs << data;
+        }
+        Utau::UstFile eager;
+        eager.read(std::string_view(data));
+        for (const auto &mode : MODES) {
+            Utau::UstReadOptions options;
+            options.threadCount = mode.threadCount;
+            options.lazy = mode.lazy;
+            options.compactPitches = mode.compactPitches;
+            Utau::LazyUstFile ust;
+            expect(ust.loadMapped(path, options) && writeUst(ust) == writeUst(eager),
+                   std::string("mapped, ") + mode.name);
+
+            // Saving to the loaded path truncates the file before the pending notes are written
+            Utau::UstFile saved;
+            expect(ust.save(path) && saved.load(path) && writeUst(saved) == writeUst(eager),
+                   std::string("saved to the mapped path, ") + mode.name);
+        }
+        std::filesystem::remove(path);
+    }
+
+    return testResult();
+}
@@ -0,0 +1,167 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdutau/ustreader.h>
+
+#include "testutil.h"
+
+// Collects the events of UstReader into a UstFile and compares it with UstFile::read(), and
+// checks the order of the events around the track end marks
+
+class Collector : public Utau::UstReader {
+public:
+    Utau::UstFile ust;
+    std::string events; // V, S, N<index> and E for the track ends
+    bool indexInOrder = true;
+
+protected:
+    void onVersion(const Utau::UstVersion &version) override {
+        ust.version = version;
+        events += "V ";
+    }
+
+    void onSettings(const Utau::UstSettings &settings) override {
+        ust.settings = settings;
+        events += "S ";
+    }
+
+    void onNote(int index, const Utau::Note &note) override {
+        if (index != m_trackNotes++) {
+            indexInOrder = false;
+        }
+        ust.notes.push_back(note);
+        events += "N" + std::to_string(index) + " ";
+    }
+
+    void onTrackEnd() override {
+        m_trackNotes = 0;
+        events += "E ";
+    }
+
+private:
+    int m_trackNotes = 0;
+};
+
+static std::string writeUst(const Utau::UstFile &ust) {
+    std::ostringstream ss;
+    ust.write(ss);
+    return ss.str();
+}
+
+// Reads the data both ways, returns the events of the reader
+static std::string check(const std::string &data, const std::string &name) {
+    Utau::UstFile expected;
+    std::istringstream expectedStream(data);
+    expect(expected.read(expectedStream), name + ": UstFile");
+
+    Collector reader;
+    std::istringstream stream(data);
+    expect(reader.read(stream), name + ": UstReader");
+    expect(reader.indexInOrder, name + ": note indices");
+    expect(writeUst(reader.ust) == writeUst(expected), name + ": contents");
+    return reader.events;
+}
+
+static const char HEADER[] = "[#VERSION]\n"
+                             "UST Version1.2\n"
+                             "Charset=UTF-8\n"
+                             "[#SETTING]\n"
+                             "Tempo=125.5\n"
+                             "Tracks=1\n"
+                             "ProjectName=test\n"
+                             "VoiceDir=%VOICE%uta\n"
+                             "Mode2=True\n"
+                             "Flags=g-5\n";
+
+// The zero-length note is skipped as UstFile does
+static const char NOTES[] = "[#0000]\n"
+                            "Length=1920\n"
+                            "Lyric=u\n"
+                            "NoteNum=71\n"
+                            "VBR=76,-290.912,1.60241e+07,5,-281.393,60,252.094,172.865\n"
+                            "\n"
+                            "[#0001]\n"
+                            "Length=0\n"
+                            "Lyric=skipped\n"
+                            "NoteNum=79\n"
+                            "[#0002]\n"
+                            "Length=480\n"
+                            "Lyric=ka\n"
+                            "NoteNum=70\n"
+                            "PBS=110;-293.126\n"
+                            "PBW=-287.968,6.0,107.569\n"
+                            "PBY=-138,,76.782\n"
+                            "PBM=x,r,s\n"
+                            "Piches=21,0.000218802,605,-185.518,,,626,,58.9,209.983\n"
+                            "[#0003]\n"
+                            "Length=240\n"
+                            "Lyric=R\n"
+                            "NoteNum=60\n"
+                            "Tempo=77.77\n"
+                            "Envelope=-46.210,165.899,-144\n"
+                            "$direct=true\n";
+
+// A project of random notes written by UstFile
+static std::string randomProject(unsigned seed) {
+    return writeUst(randomUst(seed));
+}
+
+int main() {
+    // One track with its end mark
+    auto events = check(std::string(HEADER) + NOTES + "[#TRACKEND]\n", "one track");
+    expect(events == "V S N0 N1 N2 E ", "one track: events " + events);
+
+    // No end mark, the track ends with the input, whose last section is only read if it
+    // doesn't end with a line break, as UstFile does
+    auto data = std::string(HEADER) + NOTES;
+    events = check(data, "no end mark");
+    expect(events == "V S N0 N1 E ", "no end mark: events " + events);
+    data.pop_back();
+    events = check(data, "no end mark or line break");
+    expect(events == "V S N0 N1 N2 E ", "no end mark or line break: events " + events);
+
+    // Two tracks, the index restarts and UstFile appends the notes of both
+    events = check(std::string(HEADER) + NOTES + "[#TRACKEND]\n" + NOTES + "[#TRACKEND]\n",
+                   "two tracks");
+    expect(events == "V S N0 N1 N2 E N0 N1 N2 E ", "two tracks: events " + events);
+
+    // An invalid section name drops the sections after it, as UstFile does
+    events = check(std::string(HEADER) + NOTES + "[#INVALID\nLength=480\n[#0004]\nLength=480\n",
+                   "invalid section");
+    expect(events == "V S N0 N1 N2 E ", "invalid section: events " + events);
+
+    // Nothing after the end mark but blank lines, and no sections at all
+    events = check(std::string(HEADER) + NOTES + "[#TRACKEND]\n\n\n", "trailing lines");
+    expect(events == "V S N0 N1 N2 E ", "trailing lines: events " + events);
+    events = check("", "empty");
+    expect(events.empty(), "empty: events " + events);
+
+    // Files written by UstFile
+    for (unsigned seed = 0; seed < 100; ++seed) {
+        check(randomProject(seed), "seed " + std::to_string(seed));
+    }
+
+    // Loaded from a file
+    {
+        std::mt19937 gen(std::random_device{}());
+        auto path = std::filesystem::temp_directory_path() /
+                    ("tst_ustreader_" + std::to_string(gen()) + ".ust");
+        {
+            std::ofstream fs(path, std::ios::binary);
+            fs << HEADER << NOTES << "[#TRACKEND]\n" << NOTES << "[#TRACKEND]\n";
+        }
+        Utau::UstFile expected;
+        Collector reader;
+        expect(expected.load(path) && reader.load(path), "file: load");
+        expect(writeUst(reader.ust) == writeUst(expected), "file: contents");
+        expect(reader.events == "V S N0 N1 N2 E N0 N1 N2 E ", "file: events " + reader.events);
+        std::filesystem::remove(path);
+    }
+
+    return testResult();
+}
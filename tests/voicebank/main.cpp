@@ -0,0 +1,219 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <stdutau/otocache.h>
+#include <stdutau/voicebank.h>
+
+#include "testutil.h"
+
+// Loads, caches and saves a small voicebank with nested oto.ini files in a temporary directory
+
+namespace fs = std::filesystem;
+
+static const char ROOT_OTO[] = "a.wav=- a,100,200,-300,50,20\n"
+                               "a.wav=a i,1100,200,-300,50,20\n"
+                               "ka.wav=,90,250,-300,80,30\n";
+
+static const char SUB_OTO[] = "sa.wav=- sa,100,150,400,60,10\n"
+                              "sa.wav=a i,200,150,400,60,10\n"
+                              "sa.wav=sa i,300,150,400,60,10\n";
+
+static const char DEEP_OTO[] = "ta.wav=sa i,1,2,3,4,5\n"
+                               "ta.wav=,6,7,8,9,10\n";
+
+static void writeFile(const fs::path &path, const std::string &data) {
+    std::ofstream fs(path, std::ios::binary | std::ios::trunc);
+    fs.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+static std::string readFile(const fs::path &path) {
+    std::ifstream fs(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+}
+
+// Entries, and what the index finds for each of them
+static std::string dumpEntries(const Utau::Voicebank &vb, bool lineOrder = true) {
+    std::ostringstream ss;
+    for (const auto &genon : vb.oto.entries(lineOrder)) {
+        ss << genon->fileName << "=" << genon->alias << "," << genon->offset << ","
+           << genon->consonant << "," << genon->blank << "," << genon->preUtterance << ","
+           << genon->voiceOverlap;
+        auto found = vb.oto.index().find(Utau::OtoIndex::aliasOf(*genon));
+        ss << " -> " << (found ? found->fileName : "none") << "\n";
+    }
+    return ss.str();
+}
+
+static std::string dump(const Utau::Voicebank &vb) {
+    std::ostringstream ss;
+    ss << dumpEntries(vb);
+    for (const auto &report : vb.reports) {
+        ss << report.path.generic_string() << " " << report.success << " " << report.entryCount
+           << "\n";
+    }
+    return ss.str();
+}
+
+int main() {
+    std::mt19937 gen(std::random_device{}());
+    auto root = fs::temp_directory_path() / ("tst_voicebank_" + std::to_string(gen()));
+    fs::create_directories(root / "sub" / "deep");
+    writeFile(root / "oto.ini", ROOT_OTO);
+    writeFile(root / "sub" / "oto.ini", SUB_OTO);
+    writeFile(root / "sub" / "deep" / "OTO.INI", DEEP_OTO);
+
+    auto sep = std::string(1, char(fs::path::preferred_separator));
+    auto sub = "sub" + sep;
+    auto deep = "sub" + sep + "deep" + sep;
+
+    Utau::VoicebankLoadOptions flat;
+    flat.recursive = false;
+    flat.threadCount = 1;
+
+    // Load, the root and then the files in path order win
+    Utau::Voicebank vb;
+    expect(vb.load(root), "load");
+    expect(vb.reports.size() == 3 && vb.reports[0].path == "oto.ini" &&
+               vb.reports[1].path == fs::path("sub") / "deep" / "OTO.INI" &&
+               vb.reports[2].subdirectory == fs::path("sub"),
+           "reports");
+    expect(vb.oto.index().size() == 6, "index size");
+    auto found = vb.oto.index().find("a i");
+    expect(found && found->fileName == "a.wav", "root wins");
+    found = vb.oto.index().find("sa i");
+    expect(found && found->fileName == deep + "ta.wav", "first file in path order wins");
+    found = vb.oto.index().find("ta");
+    expect(found && found->fileName == deep + "ta.wav" && found->offset == 6, "nested file name");
+    auto expected = dump(vb);
+
+    Utau::Voicebank flatVb;
+    expect(flatVb.load(root, flat), "flat load");
+    expect(flatVb.reports.size() == 1 && flatVb.oto.index().size() == 3, "flat entries");
+    auto expectedFlat = dump(flatVb);
+
+    // Loaded and cached, restored, and not restored with other options
+    {
+        auto cachePath = Utau::OtoCache::defaultPath(root);
+        Utau::Voicebank cached;
+        expect(cached.loadCached(root, cachePath) && dump(cached) == expected, "cache built");
+        expect(fs::exists(cachePath), "cache file");
+        expect(cached.loadCached(root, cachePath) && dump(cached) == expected &&
+                   cached.reports[0].milliseconds == 0,
+               "cache restored");
+        expect(cached.loadCached(root, cachePath, flat) && dump(cached) == expectedFlat,
+               "cache of other options");
+        expect(cached.loadCached(root, cachePath, flat) && dump(cached) == expectedFlat &&
+                   cached.reports[0].milliseconds == 0,
+               "cache of other options restored");
+        expect(cached.loadCached(root, cachePath) && dump(cached) == expected,
+               "cache rebuilt with the first options");
+        fs::remove(cachePath);
+    }
+
+    // Saved back to the files it was loaded from
+    {
+        auto &list = vb.oto.contents[sub + "sa.wav"];
+        list[0].offset = 150;
+        Utau::GenonSettings added;
+        added.fileName = deep + "na.wav";
+        added.alias = "na";
+        added.offset = 42;
+        vb.oto.add(added);
+        vb.oto.rebuildIndex();
+        expected = dumpEntries(vb, false);
+
+        Utau::OtoWriteOptions options;
+        options.keepLineOrder = true;
+        expect(vb.save(options, 2), "save");
+        expect(readFile(root / "oto.ini") == ROOT_OTO, "root file");
+        expect(readFile(root / "sub" / "oto.ini") ==
+                   "sa.wav=- sa,150,150,400,60,10\n"
+                   "sa.wav=a i,200,150,400,60,10\n"
+                   "sa.wav=sa i,300,150,400,60,10\n",
+               "subdirectory file");
+        expect(readFile(root / "sub" / "deep" / "OTO.INI") ==
+                   std::string(DEEP_OTO) + "na.wav=na,42,0,0,0,0\n",
+               "nested file");
+
+        Utau::Voicebank reloaded;
+        expect(reloaded.load(root) && dumpEntries(reloaded, false) == expected, "reloaded");
+    }
+
+    // A file that failed to load is never written, an entry added to its subdirectory isn't
+    // moved into another file
+    {
+        Utau::Voicebank failedVb;
+        expect(failedVb.load(root), "failed load");
+        auto &report = failedVb.reports[1];
+        report.success = false;
+        report.errorString = "mapping failed";
+        report.entryCount = 0;
+        report.lineRuns.clear();
+        failedVb.oto.contents.erase(deep + "ta.wav");
+        failedVb.oto.contents.erase(deep + "na.wav");
+        Utau::GenonSettings added;
+        added.fileName = deep + "ma.wav";
+        added.alias = "ma";
+        failedVb.oto.add(added);
+        failedVb.oto.rebuildIndex();
+
+        auto deepOto = readFile(root / "sub" / "deep" / "OTO.INI");
+        failedVb.oto.contents[sub + "sa.wav"][0].offset = 160;
+
+        Utau::OtoWriteOptions options;
+        options.keepLineOrder = true;
+        expect(!failedVb.save(options, 2), "failed save");
+        expect(readFile(root / "sub" / "deep" / "OTO.INI") == deepOto, "failed file kept");
+        expect(readFile(root / "oto.ini") == ROOT_OTO, "failed root file");
+        expect(readFile(root / "sub" / "oto.ini") ==
+                   "sa.wav=- sa,160,150,400,60,10\n"
+                   "sa.wav=a i,200,150,400,60,10\n"
+                   "sa.wav=sa i,300,150,400,60,10\n",
+               "failed subdirectory file");
+    }
+
+    // A root file referencing a subdirectory that has its own file keeps its entries, also
+    // after the voicebank is restored from the cache
+    {
+        auto refRoot = root / "ref";
+        fs::create_directories(refRoot / "sub");
+        auto rootOto = "a.wav=a,1,2,3,4,5\n" + sub + "x.wav=x,10,20,30,40,50\n" + sub +
+                       "x.wav=- x,11,20,30,40,50\n";
+        std::string subOto = "x.wav=x sub,60,70,80,90,100\n"
+                             "y.wav=y,1,1,1,1,1\n";
+        writeFile(refRoot / "oto.ini", rootOto);
+        writeFile(refRoot / "sub" / "oto.ini", subOto);
+
+        Utau::Voicebank refVb;
+        expect(refVb.load(refRoot), "referencing load");
+        expect(refVb.oto.contents[sub + "x.wav"].size() == 3, "shared file name");
+        auto refExpected = dumpEntries(refVb, false);
+
+        Utau::OtoWriteOptions options;
+        options.keepLineOrder = true;
+        expect(refVb.save(options, 2), "referencing save");
+        expect(readFile(refRoot / "oto.ini") == rootOto, "referencing root file");
+        expect(readFile(refRoot / "sub" / "oto.ini") == subOto, "referenced file");
+
+        auto cachePath = Utau::OtoCache::defaultPath(refRoot);
+        Utau::Voicebank cached;
+        expect(cached.loadCached(refRoot, cachePath) && cached.loadCached(refRoot, cachePath) &&
+                   cached.reports[0].milliseconds == 0,
+               "referencing cache restored");
+        expect(cached.save(options, 2), "restored save");
+        expect(readFile(refRoot / "oto.ini") == rootOto, "restored root file");
+        expect(readFile(refRoot / "sub" / "oto.ini") == subOto, "restored referenced file");
+
+        Utau::Voicebank reloaded;
+        expect(reloaded.load(refRoot) && dumpEntries(reloaded, false) == refExpected,
+               "referencing reloaded");
+    }
+
+    fs::remove_all(root);
+
+    return testResult();
+}